@@ -0,0 +1,225 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error The benchmarks require C++11 support.
+#endif
+
+#include <meta/inttypes.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(META_X86_SIMD)
+#  include <x86intrin.h>
+#endif
+
+namespace bench {
+
+/**
+ * Command line options shared by all benchmarks:
+ *
+ *    --quick     Use smaller buffers and fewer repetitions, e.g. for smoke
+ *                testing the benchmarks themselves.
+ **/
+struct options
+{
+  bool quick;
+
+  inline options(int argc, char ** argv)
+    : quick(false)
+  {
+    for (int i = 1 ; i < argc ; ++i) {
+      if (0 == std::strcmp(argv[i], "--quick")) {
+        quick = true;
+      }
+    }
+  }
+};
+
+
+/**
+ * Time stamp counter, where available. On x86 that counts reference cycles
+ * at a constant rate, which may differ from the core clock under turbo or
+ * power saving. Returns 0 elsewhere.
+ **/
+inline uint64_t
+cycles()
+{
+#if defined(META_X86_SIMD)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+
+/**
+ * xorshift64: a fast pseudo random number generator, so that benchmarks can
+ * generate the same input on every run. The state must not be zero.
+ **/
+inline uint64_t
+next_random(uint64_t & state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+
+/**
+ * A zero-filled buffer of at least size bytes plus some slack, whose data()
+ * is aligned to 64 bytes. Benchmarks add their own offset to that to test
+ * misaligned access.
+ **/
+class buffer
+{
+public:
+  inline explicit buffer(std::size_t size)
+    : m_storage(size + 128, 0)
+  {
+  }
+
+  inline char * data()
+  {
+    char * p = &m_storage[0];
+    return p + (64 - reinterpret_cast<uintptr_t>(p) % 64) % 64;
+  }
+
+private:
+  std::vector<char> m_storage;
+};
+
+
+/**
+ * Measurement of a single benchmark function: the best of several samples,
+ * each of which runs the function often enough to process a fixed amount of
+ * data. Reporting the best sample filters out most interference from other
+ * processes.
+ **/
+struct result
+{
+  double    ns;
+  uint64_t  cycles;
+};
+
+template <typename funcT>
+inline result
+measure(funcT func, std::size_t bytes_per_call, options const & opts)
+{
+  std::size_t const target = opts.quick ? (std::size_t(1) << 22)
+    : (std::size_t(1) << 27);
+  std::size_t const samples = opts.quick ? 2 : 3;
+  std::size_t calls = target / bytes_per_call;
+  if (!calls) {
+    calls = 1;
+  }
+
+  // Warm up caches and branch predictors, and make sure lazily selected
+  // kernels are selected.
+  func();
+
+  result best = { 0, 0 };
+  for (std::size_t s = 0 ; s < samples ; ++s) {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+    uint64_t start_cycles = cycles();
+
+    for (std::size_t c = 0 ; c < calls ; ++c) {
+      func();
+    }
+
+    uint64_t end_cycles = cycles();
+    std::chrono::steady_clock::time_point end
+      = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count()
+      / calls;
+    if (!s || ns < best.ns) {
+      best.ns = ns;
+      best.cycles = (end_cycles - start_cycles) / calls;
+    }
+  }
+  return best;
+}
+
+
+/**
+ * Results are printed as CSV to stdout, one line per measurement, so they
+ * can be compared across runs with standard tools.
+ **/
+inline void
+print_header()
+{
+  std::printf("benchmark,variant,element_size,buffer_bytes,alignment,"
+      "elements,ns_per_element,cycles_per_element,gb_per_s\n");
+}
+
+inline void
+print_result(std::string const & benchmark, std::string const & variant,
+    std::size_t element_size, std::size_t buffer_bytes, std::size_t alignment,
+    std::size_t elements, result const & res)
+{
+  std::printf("%s,%s,%zu,%zu,%zu,%zu,%.4f,%.4f,%.3f\n",
+      benchmark.c_str(), variant.c_str(), element_size, buffer_bytes,
+      alignment, elements,
+      res.ns / elements,
+      static_cast<double>(res.cycles) / elements,
+      (elements * element_size) / res.ns);
+  std::fflush(stdout);
+}
+
+
+/**
+ * Benchmarks that measure something other than throughput over a buffer,
+ * e.g. ns per lookup or false positive rates, print one line per metric
+ * instead.
+ **/
+inline void
+print_metric_header()
+{
+  std::printf("benchmark,variant,metric,value\n");
+}
+
+inline void
+print_metric(std::string const & benchmark, std::string const & variant,
+    std::string const & metric, double value)
+{
+  std::printf("%s,%s,%s,%.6f\n", benchmark.c_str(), variant.c_str(),
+      metric.c_str(), value);
+  std::fflush(stdout);
+}
+
+} // namespace bench
+
+#endif // guard
@@ -0,0 +1,282 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Throughput of the byte order conversions in meta/byteorder.h, for 16, 32
+ * and 64 bit integers, buffers from L1 cache to DRAM size, and aligned as
+ * well as misaligned data.
+ *
+ * Element-wise benchmarks call the conversion function in a loop over the
+ * buffer, just as user code would; bulk benchmarks call the *_n() functions
+ * and each of the vector kernels they dispatch to.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/byteorder.h>
+
+#if defined(META_HAVE_BYTESWAP_H)
+#  include <byteswap.h>
+#endif
+
+namespace b = meta::byte_order;
+
+namespace {
+
+typedef void (*kernel_func)(char *, char const *, std::size_t);
+
+
+/**
+ * Element-wise operations.
+ **/
+struct meta_swap
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::swap(value);
+  }
+};
+
+struct shift_swap
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::detail::shift_swap(value);
+  }
+};
+
+#if defined(__GNUC__)
+struct builtin_swap
+{
+  inline static uint16_t apply(uint16_t value)
+  {
+    return __builtin_bswap16(value);
+  }
+
+  inline static uint32_t apply(uint32_t value)
+  {
+    return __builtin_bswap32(value);
+  }
+
+  inline static uint64_t apply(uint64_t value)
+  {
+    return __builtin_bswap64(value);
+  }
+};
+#endif
+
+#if defined(META_HAVE_BYTESWAP_H)
+struct byteswap_h_swap
+{
+  inline static uint16_t apply(uint16_t value)
+  {
+    return bswap_16(value);
+  }
+
+  inline static uint32_t apply(uint32_t value)
+  {
+    return bswap_32(value);
+  }
+
+  inline static uint64_t apply(uint64_t value)
+  {
+    return bswap_64(value);
+  }
+};
+#endif
+
+struct convert_hton
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::convert<>::hton(value);
+  }
+};
+
+struct convert_ntoh
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::convert<>::ntoh(value);
+  }
+};
+
+struct to_host_runtime
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::to_host(value, b::META_BIG_ENDIAN);
+  }
+};
+
+struct to_host_static
+{
+  template <typename T>
+  inline static T apply(T value)
+  {
+    return b::to_host<b::META_BIG_ENDIAN>(value);
+  }
+};
+
+
+template <typename T, typename opT>
+void
+elementwise(char * dest, char const * src, std::size_t count)
+{
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    T value;
+    std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+    value = opT::apply(value);
+    std::memcpy(dest + i * sizeof(T), &value, sizeof(T));
+  }
+}
+
+template <typename T>
+void
+load_be(char * dest, char const * src, std::size_t count)
+{
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    T value = b::load_be<T>(src + i * sizeof(T));
+    std::memcpy(dest + i * sizeof(T), &value, sizeof(T));
+  }
+}
+
+
+/**
+ * Bulk operations
+ **/
+template <typename T>
+void
+to_host_n(char * dest, char const * src, std::size_t count)
+{
+  b::to_host_n(reinterpret_cast<T *>(dest), reinterpret_cast<T const *>(src),
+      count, b::META_BIG_ENDIAN);
+}
+
+
+
+struct benchmark
+{
+  char const *  name;
+  char const *  variant;
+  kernel_func   func;
+};
+
+template <typename T>
+std::vector<benchmark>
+benchmarks()
+{
+  std::vector<benchmark> result;
+
+  result.push_back(benchmark{ "swap", "meta", &elementwise<T, meta_swap> });
+#if defined(__GNUC__)
+  result.push_back(benchmark{ "swap", "builtin", &elementwise<T, builtin_swap> });
+#endif
+#if defined(META_HAVE_BYTESWAP_H)
+  result.push_back(benchmark{ "swap", "byteswap_h", &elementwise<T, byteswap_h_swap> });
+#endif
+  result.push_back(benchmark{ "swap", "shift", &elementwise<T, shift_swap> });
+
+  result.push_back(benchmark{ "convert", "hton", &elementwise<T, convert_hton> });
+  result.push_back(benchmark{ "convert", "ntoh", &elementwise<T, convert_ntoh> });
+
+  result.push_back(benchmark{ "to_host", "runtime", &elementwise<T, to_host_runtime> });
+  result.push_back(benchmark{ "to_host", "static", &elementwise<T, to_host_static> });
+  result.push_back(benchmark{ "to_host", "load_be", &load_be<T> });
+
+  result.push_back(benchmark{ "swap_n", "dispatch", &b::detail::bulk_swap<sizeof(T)> });
+  result.push_back(benchmark{ "swap_n", "scalar", &b::detail::scalar_bulk_swap<sizeof(T)> });
+#if defined(META_X86_SIMD)
+  if (__builtin_cpu_supports("ssse3")) {
+    result.push_back(benchmark{ "swap_n", "ssse3", &b::detail::ssse3_bulk_swap<sizeof(T)> });
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    result.push_back(benchmark{ "swap_n", "avx2", &b::detail::avx2_bulk_swap<sizeof(T)> });
+  }
+#endif
+  result.push_back(benchmark{ "to_host_n", "dispatch", &to_host_n<T> });
+
+  return result;
+}
+
+
+template <typename T>
+void
+run(bench::options const & opts)
+{
+  std::vector<std::size_t> sizes;
+  if (opts.quick) {
+    sizes.push_back(std::size_t(16) << 10);
+    sizes.push_back(std::size_t(1) << 20);
+  } else {
+    sizes.push_back(std::size_t(16) << 10);   // L1
+    sizes.push_back(std::size_t(256) << 10);  // L2
+    sizes.push_back(std::size_t(8) << 20);    // L3
+    sizes.push_back(std::size_t(64) << 20);   // DRAM
+  }
+
+  // Vector aligned, element aligned, and misaligned data.
+  std::size_t const alignments[] = { 0, sizeof(T), 1 };
+
+  std::vector<benchmark> const benches = benchmarks<T>();
+
+  for (std::size_t size : sizes) {
+    bench::buffer src_buf(size);
+    bench::buffer dest_buf(size);
+    for (std::size_t i = 0 ; i < size ; ++i) {
+      src_buf.data()[i] = static_cast<char>(i * 7);
+    }
+
+    std::size_t const count = size / sizeof(T);
+
+    for (std::size_t alignment : alignments) {
+      char const * src = src_buf.data() + alignment;
+      char * dest = dest_buf.data() + alignment;
+
+      for (benchmark const & bm : benches) {
+        bench::result res = bench::measure(
+            [&]() { bm.func(dest, src, count); },
+            size, opts);
+        bench::print_result(bm.name, bm.variant, sizeof(T), size, alignment,
+            count, res);
+      }
+    }
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_header();
+  run<uint16_t>(opts);
+  run<uint32_t>(opts);
+  run<uint64_t>(opts);
+}
@@ -0,0 +1,93 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Throughput of the CRC32C kernels in meta/crc32c.h, in GB/s, for buffers
+ * from a single cache line to beyond the caches. The "bytewise" variant is
+ * the classic one-table-lookup-per-byte implementation, for comparison.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/crc32c.h>
+
+namespace d = meta::crc32c::detail;
+
+namespace {
+
+uint32_t
+bytewise_extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  d::tables const & t = d::get_tables();
+  for ( ; size ; --size) {
+    crc = (crc >> 8) ^ t.slice[0][(crc ^ *p++) & 0xff];
+  }
+  return crc;
+}
+
+
+void
+run(char const * variant, d::extend_func func, bench::options const & opts)
+{
+  std::size_t const max_size = opts.quick ? (std::size_t(1) << 20)
+    : (std::size_t(1) << 26);
+  bench::buffer buf(max_size);
+  for (std::size_t i = 0 ; i < max_size ; ++i) {
+    buf.data()[i] = static_cast<char>(i * 131);
+  }
+  unsigned char const * data
+    = reinterpret_cast<unsigned char const *>(buf.data());
+
+  uint32_t sink = 0;
+  for (std::size_t size = 64 ; size <= max_size ; size *= 16) {
+    bench::result res = bench::measure([&]() {
+        sink += func(sink, data, size);
+      }, size, opts);
+    bench::print_metric("crc32c", variant,
+        "gb_per_s_" + std::to_string(size), size / res.ns);
+  }
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+  run("bytewise", &bytewise_extend, opts);
+  run("slicing_by_8", &d::scalar_extend, opts);
+#if defined(META_CRC32C_HW)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    run("sse42", &d::sse42_extend, opts);
+    if (__builtin_cpu_supports("pclmul")) {
+      run("sse42_pclmul", &d::pclmul_extend, opts);
+    }
+  }
+#endif
+}
@@ -0,0 +1,144 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Columns of prices as meta::math::fixed values, compared against doubles.
+ * All numbers are ns per value:
+ *
+ * - sum, minimum: aggregating a column, in a loop over the values, and with
+ *   the bulk functions.
+ * - dot: the sum of the products of two columns, row by row, each rounded
+ *   to their scale.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/fixed.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace m = meta::math;
+
+namespace {
+
+template <typename intT>
+void
+fixed_columns(char const * variant, std::vector<double> const & doubles,
+    bench::options const & opts)
+{
+  typedef m::fixed<intT, m::ratio<intT, 1, 10000> > price;
+
+  std::size_t const count = doubles.size();
+  std::vector<price> prices(count);
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    prices[i] = price::from_raw(intT(doubles[i] * 10000));
+  }
+  intT sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      price total;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        total += prices[i];
+      }
+      sink += total.raw();
+    }, count * sizeof(intT), opts);
+  bench::print_metric("sum", variant, "ns_loop", res.ns / count);
+
+  res = bench::measure([&]() {
+      sink += m::sum(&prices[0], count).raw();
+    }, count * sizeof(intT), opts);
+  bench::print_metric("sum", variant, "ns_bulk", res.ns / count);
+
+  res = bench::measure([&]() {
+      sink += m::minimum(&prices[0], count).raw();
+    }, count * sizeof(intT), opts);
+  bench::print_metric("minimum", variant, "ns_bulk", res.ns / count);
+
+  res = bench::measure([&]() {
+      price total;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        total += prices[i] * prices[count - 1 - i];
+      }
+      sink += total.raw();
+    }, count * sizeof(intT), opts);
+  bench::print_metric("dot", variant, "ns_loop", res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+run(bench::options const & opts)
+{
+  // Values up to 100.0000, so that products fit 32 bit fixed point values.
+  std::size_t const count = 16384;
+  std::vector<double> doubles(count);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    doubles[i] = double(bench::next_random(state) % 1000000) / 10000;
+  }
+  double sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      double total = 0;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        total += doubles[i];
+      }
+      sink += total;
+    }, count * sizeof(double), opts);
+  bench::print_metric("sum", "double", "ns_loop", res.ns / count);
+
+  res = bench::measure([&]() {
+      sink += *std::min_element(doubles.begin(), doubles.end());
+    }, count * sizeof(double), opts);
+  bench::print_metric("minimum", "double", "ns_loop", res.ns / count);
+
+  res = bench::measure([&]() {
+      double total = 0;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        total += doubles[i] * doubles[count - 1 - i];
+      }
+      sink += total;
+    }, count * sizeof(double), opts);
+  bench::print_metric("dot", "double", "ns_loop", res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+
+  fixed_columns<int32_t>("fixed32", doubles, opts);
+  fixed_columns<int64_t>("fixed64", doubles, opts);
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+  run(opts);
+}
@@ -0,0 +1,166 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * meta::hash::flat_map compared against std::unordered_map, for integer and
+ * string keys, and for tables that fit into the caches as well as tables that
+ * do not. All numbers are ns per key:
+ *
+ * - insert: inserting all keys into an empty map.
+ * - insert_reserved: the same, after reserving room for all keys.
+ * - hit/miss: looking up keys that are present, or absent.
+ * - erase_reinsert: erasing each key and inserting it again right away,
+ *   which keeps the map at its size.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/flat_map.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace h = meta::hash;
+
+namespace {
+
+inline void
+make_key(uint64_t value, uint64_t & key)
+{
+  key = value;
+}
+
+inline void
+make_key(uint64_t value, std::string & key)
+{
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "key-%016llx",
+      static_cast<unsigned long long>(value));
+  key = buf;
+}
+
+
+template <typename mapT, typename keyT>
+void
+map_operations(char const * benchmark, char const * variant,
+    std::vector<keyT> const & keys, std::vector<keyT> const & missing,
+    bench::options const & opts)
+{
+  std::size_t const count = keys.size();
+  std::size_t const bytes = count * sizeof(keyT);
+  uint64_t sink = 0;
+
+  char metric[64];
+
+  bench::result res = bench::measure([&]() {
+      mapT map;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        map[keys[i]] = i;
+      }
+      sink += map.size();
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_insert_%zu", count);
+  bench::print_metric(benchmark, variant, metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      mapT map;
+      map.reserve(count);
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        map[keys[i]] = i;
+      }
+      sink += map.size();
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_insert_reserved_%zu", count);
+  bench::print_metric(benchmark, variant, metric, res.ns / count);
+
+  mapT map;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    map[keys[i]] = i;
+  }
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += map.find(keys[i])->second;
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_hit_%zu", count);
+  bench::print_metric(benchmark, variant, metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += map.count(missing[i]);
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_miss_%zu", count);
+  bench::print_metric(benchmark, variant, metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += map.erase(keys[i]);
+        map[keys[i]] = i;
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_erase_reinsert_%zu", count);
+  bench::print_metric(benchmark, variant, metric, res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+template <typename keyT>
+void
+run(char const * benchmark, bench::options const & opts)
+{
+  std::size_t const sizes[] = { std::size_t(1) << 10, std::size_t(1) << 14,
+    std::size_t(1) << (opts.quick ? 16 : 20) };
+
+  for (std::size_t count : sizes) {
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    std::vector<keyT> keys(count);
+    std::vector<keyT> missing(count);
+    for (std::size_t i = 0 ; i < count ; ++i) {
+      // Present keys are even, missing keys odd.
+      make_key(bench::next_random(state) & ~uint64_t(1), keys[i]);
+      make_key(bench::next_random(state) | 1, missing[i]);
+    }
+
+    map_operations<std::unordered_map<keyT, std::size_t> >(benchmark,
+        "unordered_map", keys, missing, opts);
+    map_operations<h::flat_map<keyT, std::size_t> >(benchmark,
+        "flat_map", keys, missing, opts);
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+  run<uint64_t>("uint64_keys", opts);
+  run<std::string>("string_keys", opts);
+}
@@ -0,0 +1,651 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Quality and throughput of the hash functions in meta/hash.h.
+ *
+ * multi_hash() is compared against its previous, boost::hash_combine based
+ * implementation ("legacy"). Quality metrics are:
+ *
+ * - avalanche_max_bias/avalanche_mean_bias: flipping a single input bit
+ *   should flip each output bit with probability 0.5; this is the worst and
+ *   the average deviation from that over all input and output bits.
+ * - upper_bits_fill/lower_bits_fill: the fraction of 2^16 buckets used when
+ *   hashing 2^16 grid keys by the upper or lower 16 bits of the hash. Random
+ *   placement fills about 0.632 of the buckets.
+ * - upper_bits_max_load: the largest number of keys in one bucket.
+ *
+ * hash_bytes() is compared against the wyhash() and fnv1a() string hashes,
+ * reporting ns per call for short keys and GB/s for larger buffers.
+ *
+ * hash_batch() and hash_bytes_batch() are compared against hashing the same
+ * keys one at a time, in ns per key.
+ *
+ * tree_hash() is measured in GB/s for one thread up to the number of hardware
+ * threads.
+ *
+ * perfect_map lookups are compared against std::unordered_map, in ns per
+ * lookup of a mix of present and missing keys.
+ *
+ * hashed<std::string> keys are compared against plain std::string keys, in ns
+ * per key for looking each key up in five tables in turn.
+ *
+ * Shard routing with jump_consistent_hash() and rendezvous_hash is compared
+ * against a consistent hash ring with 100 virtual nodes per node, looked up
+ * by binary search, in ns per key.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/hash.h>
+#include <meta/perfect_hash.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace h = meta::hash;
+
+namespace {
+
+/**
+ * The previous implementation, for comparison.
+ **/
+namespace legacy {
+
+inline void
+hash_combine(std::size_t & seed, std::size_t const & value)
+{
+  seed ^= value + 0x9e3779b9
+    + (seed << 6) + (seed >> 2);
+}
+
+template <typename T>
+inline std::size_t multi_hash(T const & t)
+{
+  return std::hash<T>()(t);
+}
+
+template <typename T0, typename... Ts>
+inline std::size_t multi_hash(T0 const & t0, Ts && ... ts)
+{
+  std::size_t seed = multi_hash(t0);
+  if (0 == sizeof...(ts)) {
+    return seed;
+  }
+
+  std::size_t remainder = multi_hash(std::forward<Ts>(ts)...);
+
+  hash_combine(seed, remainder);
+  return seed;
+}
+
+} // namespace legacy
+
+
+struct legacy_hash
+{
+  template <typename... Ts>
+  inline static std::size_t apply(Ts const & ... ts)
+  {
+    return legacy::multi_hash(ts...);
+  }
+};
+
+struct meta_hash
+{
+  template <typename... Ts>
+  inline static std::size_t apply(Ts const & ... ts)
+  {
+    return h::multi_hash(ts...);
+  }
+};
+
+
+template <typename hashT>
+void
+avalanche(char const * variant, bench::options const & opts)
+{
+  std::size_t const samples = opts.quick ? 1000 : 20000;
+  std::size_t const out_bits = sizeof(std::size_t) * 8;
+
+  // flips[input bit][output bit]
+  std::vector<std::size_t> flips(128 * out_bits, 0);
+
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (std::size_t s = 0 ; s < samples ; ++s) {
+    uint64_t a = bench::next_random(state);
+    uint64_t b = bench::next_random(state);
+    std::size_t base = hashT::apply(a, b);
+
+    for (std::size_t bit = 0 ; bit < 128 ; ++bit) {
+      std::size_t flipped = bit < 64
+        ? hashT::apply(a ^ (uint64_t(1) << bit), b)
+        : hashT::apply(a, b ^ (uint64_t(1) << (bit - 64)));
+      std::size_t diff = base ^ flipped;
+      for (std::size_t out = 0 ; out < out_bits ; ++out) {
+        flips[bit * out_bits + out] += (diff >> out) & 1;
+      }
+    }
+  }
+
+  double max_bias = 0;
+  double sum_bias = 0;
+  for (std::size_t i = 0 ; i < flips.size() ; ++i) {
+    double bias = static_cast<double>(flips[i]) / samples - 0.5;
+    bias = bias < 0 ? -bias : bias;
+    max_bias = std::max(max_bias, bias);
+    sum_bias += bias;
+  }
+
+  bench::print_metric("multi_hash", variant, "avalanche_max_bias", max_bias);
+  bench::print_metric("multi_hash", variant, "avalanche_mean_bias",
+      sum_bias / flips.size());
+}
+
+
+template <typename hashT>
+void
+distribution(char const * variant)
+{
+  std::size_t const bits = 16;
+  std::size_t const buckets = std::size_t(1) << bits;
+  std::vector<std::size_t> upper(buckets, 0);
+  std::vector<std::size_t> lower(buckets, 0);
+
+  // Typical composite keys: small, dense integers.
+  for (int i = 0 ; i < 256 ; ++i) {
+    for (int j = 0 ; j < 256 ; ++j) {
+      std::size_t hash = hashT::apply(i, j);
+      ++upper[hash >> (sizeof(std::size_t) * 8 - bits)];
+      ++lower[hash & (buckets - 1)];
+    }
+  }
+
+  std::size_t upper_used = buckets - std::count(upper.begin(), upper.end(), 0);
+  std::size_t lower_used = buckets - std::count(lower.begin(), lower.end(), 0);
+
+  bench::print_metric("multi_hash", variant, "upper_bits_fill",
+      static_cast<double>(upper_used) / buckets);
+  bench::print_metric("multi_hash", variant, "lower_bits_fill",
+      static_cast<double>(lower_used) / buckets);
+  bench::print_metric("multi_hash", variant, "upper_bits_max_load",
+      static_cast<double>(*std::max_element(upper.begin(), upper.end())));
+}
+
+
+template <typename hashT>
+void
+throughput(char const * variant, bench::options const & opts)
+{
+  std::size_t const count = 4096;
+
+  std::vector<uint64_t> ints(count);
+  std::vector<std::string> strings(count);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    ints[i] = bench::next_random(state);
+    strings[i] = "key-" + std::to_string(ints[i] % 100000);
+  }
+
+  std::size_t sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += hashT::apply(ints[i]);
+      }
+    }, count * 8, opts);
+  bench::print_metric("multi_hash", variant, "ns_1_int", res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i + 2 < count ; ++i) {
+        sink += hashT::apply(ints[i], ints[i + 1], ints[i + 2]);
+      }
+    }, count * 24, opts);
+  bench::print_metric("multi_hash", variant, "ns_3_ints", res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += hashT::apply(ints[i], strings[i]);
+      }
+    }, count * 24, opts);
+  bench::print_metric("multi_hash", variant, "ns_int_string", res.ns / count);
+
+  // Keep the compiler from discarding the hashes.
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+template <typename hashT>
+void
+run(char const * variant, bench::options const & opts)
+{
+  avalanche<hashT>(variant, opts);
+  distribution<hashT>(variant);
+  throughput<hashT>(variant, opts);
+}
+
+
+/**
+ * Byte hashing, for key sizes typical of hash tables up to buffers larger
+ * than the last level cache.
+ **/
+template <typename funcT>
+void
+bytes_throughput(char const * variant, funcT func, std::size_t max_size,
+    bench::options const & opts)
+{
+  std::size_t const sizes[] = { 8, 16, 32, 64, 256, 4096, 65536, 8 << 20 };
+
+  bench::buffer buf(8 << 20);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < (8 << 20) ; ++i) {
+    buf.data()[i] = static_cast<char>(bench::next_random(state));
+  }
+
+  for (std::size_t size : sizes) {
+    if (size > max_size) {
+      break;
+    }
+
+    uint64_t sink = 0;
+    char buffer_name[64];
+    if (size <= 64) {
+      // Hash many different keys per call, as in a table lookup loop.
+      std::size_t const keys = 1024;
+      bench::result res = bench::measure([&]() {
+          for (std::size_t k = 0 ; k < keys ; ++k) {
+            sink += func(buf.data() + k * 64, size);
+          }
+        }, keys * size, opts);
+      std::snprintf(buffer_name, sizeof(buffer_name), "ns_%zu_bytes", size);
+      bench::print_metric("hash_bytes", variant, buffer_name, res.ns / keys);
+    } else {
+      bench::result res = bench::measure([&]() {
+          sink += func(buf.data(), size);
+        }, size, opts);
+      std::snprintf(buffer_name, sizeof(buffer_name), "gb_per_s_%zu_bytes",
+          size);
+      bench::print_metric("hash_bytes", variant, buffer_name, size / res.ns);
+    }
+
+    if (sink == 42) {
+      std::printf("#\n");
+    }
+  }
+}
+
+
+/**
+ * Batch hashing, as used by join and group-by operators: many keys hashed
+ * back to back, optionally prefetching buckets of a table larger than the
+ * caches.
+ **/
+void
+batch_throughput(bench::options const & opts)
+{
+  std::size_t const count = 4096;
+  std::vector<uint64_t> ints(count);
+  std::vector<unsigned char> bytes(count * 32);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    ints[i] = bench::next_random(state);
+  }
+  for (std::size_t i = 0 ; i < bytes.size() ; ++i) {
+    bytes[i] = static_cast<unsigned char>(bench::next_random(state));
+  }
+
+  std::vector<std::size_t> out(count);
+  std::vector<uint64_t> out64(count);
+  std::vector<char> table(std::size_t(64) << 20);
+  std::size_t const buckets = table.size() / 64;
+  std::size_t sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        out[i] = h::multi_hash(ints[i]);
+      }
+    }, count * 8, opts);
+  bench::print_metric("hash_batch", "single", "ns_int", res.ns / count);
+
+  res = bench::measure([&]() {
+      h::hash_batch(&ints[0], count, &out[0]);
+    }, count * 8, opts);
+  bench::print_metric("hash_batch", "batch", "ns_int", res.ns / count);
+
+  // Hash, then read the bucket each key maps to. Each read depends on the
+  // previous one, as it would when the bucket contents decide how a probe
+  // continues, so the misses cannot overlap without prefetching.
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += table[((h::multi_hash(ints[i]) & (buckets - 1)) * 64) | (sink & 1)];
+      }
+    }, count * 8, opts);
+  bench::print_metric("hash_batch", "single", "ns_int_probe", res.ns / count);
+
+  // Probe in batches small enough that prefetched buckets are still cached.
+  std::size_t const batch = 64;
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; i += batch) {
+        h::hash_batch(&ints[i], batch, &out[i],
+            h::bucket_prefetch(&table[0], 64, buckets));
+        for (std::size_t k = i ; k < i + batch ; ++k) {
+          sink += table[((out[k] & (buckets - 1)) * 64) | (sink & 1)];
+        }
+      }
+    }, count * 8, opts);
+  bench::print_metric("hash_batch", "batch_prefetch", "ns_int_probe",
+      res.ns / count);
+
+  for (std::size_t size = 8 ; size <= 32 ; size *= 2) {
+    char metric[64];
+    std::snprintf(metric, sizeof(metric), "ns_%zu_bytes", size);
+
+    res = bench::measure([&]() {
+        for (std::size_t i = 0 ; i < count ; ++i) {
+          out64[i] = h::hash_bytes(&bytes[i * size], size);
+        }
+      }, count * size, opts);
+    bench::print_metric("hash_bytes_batch", "single", metric, res.ns / count);
+
+    res = bench::measure([&]() {
+        h::hash_bytes_batch(&bytes[0], size, count, &out64[0]);
+      }, count * size, opts);
+    bench::print_metric("hash_bytes_batch", "batch", metric, res.ns / count);
+  }
+
+  if (sink == 42 || out[0] == 42 || out64[0] == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+tree_throughput(bench::options const & opts)
+{
+  std::size_t const size = opts.quick ? (std::size_t(32) << 20)
+    : (std::size_t(512) << 20);
+  bench::buffer buf(size);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < size ; i += 8) {
+    uint64_t value = bench::next_random(state);
+    std::memcpy(buf.data() + i, &value, 8);
+  }
+
+  unsigned int const max_threads = std::max(
+      std::thread::hardware_concurrency(), 1U);
+  uint64_t sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      sink += h::hash_bytes(buf.data(), size);
+    }, size, opts);
+  bench::print_metric("tree_hash", "hash_bytes", "gb_per_s", size / res.ns);
+
+  for (unsigned int threads = 1 ; threads <= max_threads ; threads *= 2) {
+    res = bench::measure([&]() {
+        sink += h::tree_hash(buf.data(), size, threads);
+      }, size, opts);
+    char variant[64];
+    std::snprintf(variant, sizeof(variant), "threads_%u", threads);
+    bench::print_metric("tree_hash", variant, "gb_per_s", size / res.ns);
+  }
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+
+constexpr h::perfect_entry<int> keyword_entries[] = {
+  { "alignas", 1 }, { "alignof", 2 }, { "auto", 3 }, { "bool", 4 },
+  { "break", 5 }, { "case", 6 }, { "catch", 7 }, { "char", 8 },
+  { "class", 9 }, { "const", 10 }, { "constexpr", 11 }, { "continue", 12 },
+  { "decltype", 13 }, { "default", 14 }, { "delete", 15 }, { "do", 16 },
+  { "double", 17 }, { "else", 18 }, { "enum", 19 }, { "explicit", 20 },
+  { "extern", 21 }, { "false", 22 }, { "float", 23 }, { "for", 24 },
+  { "friend", 25 }, { "goto", 26 }, { "if", 27 }, { "inline", 28 },
+  { "int", 29 }, { "long", 30 }, { "mutable", 31 }, { "namespace", 32 },
+  { "new", 33 }, { "noexcept", 34 }, { "nullptr", 35 }, { "operator", 36 },
+  { "private", 37 }, { "protected", 38 }, { "public", 39 }, { "return", 40 },
+  { "short", 41 }, { "signed", 42 }, { "sizeof", 43 }, { "static", 44 },
+  { "struct", 45 }, { "switch", 46 }, { "template", 47 }, { "this", 48 },
+  { "throw", 49 }, { "true", 50 }, { "try", 51 }, { "typedef", 52 },
+  { "typename", 53 }, { "union", 54 }, { "unsigned", 55 }, { "using", 56 },
+  { "virtual", 57 }, { "void", 58 }, { "volatile", 59 }, { "while", 60 },
+};
+
+constexpr auto keywords = h::make_perfect_map(keyword_entries);
+
+
+void
+perfect_lookup(bench::options const & opts)
+{
+  std::unordered_map<std::string, int> map;
+  std::vector<std::string> queries;
+  for (auto const & entry : keyword_entries) {
+    map[entry.key] = entry.value;
+    queries.push_back(entry.key);
+    queries.push_back(std::string(entry.key) + "_");
+  }
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = queries.size() - 1 ; i > 0 ; --i) {
+    std::swap(queries[i], queries[bench::next_random(state) % (i + 1)]);
+  }
+
+  std::size_t const count = queries.size();
+  int sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        std::unordered_map<std::string, int>::const_iterator iter
+          = map.find(queries[i]);
+        sink += iter == map.end() ? 0 : iter->second;
+      }
+    }, count * 8, opts);
+  bench::print_metric("perfect_map", "unordered_map", "ns_lookup",
+      res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        int const * value = keywords.find(queries[i]);
+        sink += value ? *value : 0;
+      }
+    }, count * 8, opts);
+  bench::print_metric("perfect_map", "perfect_map", "ns_lookup",
+      res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+
+void
+hashed_pipeline(bench::options const & opts)
+{
+  std::size_t const count = 4096;
+  std::size_t const stages = 5;
+
+  std::vector<std::string> keys(count);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "customer/%016llx/orders",
+        static_cast<unsigned long long>(bench::next_random(state)));
+    keys[i] = buf;
+  }
+
+  std::vector<std::unordered_map<std::string, std::size_t> > plain(stages);
+  std::vector<std::unordered_map<h::hashed<std::string>, std::size_t> >
+    hashed(stages);
+  for (std::size_t s = 0 ; s < stages ; ++s) {
+    for (std::size_t i = s ; i < count ; i += s + 1) {
+      plain[s][keys[i]] = i;
+      hashed[s][h::hashed<std::string>(keys[i])] = i;
+    }
+  }
+
+  std::size_t sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        for (std::size_t s = 0 ; s < stages ; ++s) {
+          sink += plain[s].count(keys[i]);
+        }
+      }
+    }, count * 32, opts);
+  bench::print_metric("hashed", "string", "ns_5_lookups", res.ns / count);
+
+  // Includes hashing each key once.
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        h::hashed<std::string> key(keys[i]);
+        for (std::size_t s = 0 ; s < stages ; ++s) {
+          sink += hashed[s].count(key);
+        }
+      }
+    }, count * 32, opts);
+  bench::print_metric("hashed", "hashed", "ns_5_lookups", res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+rendezvous_kernel(char const * variant, h::detail::rendezvous_func func,
+    std::size_t nodes, std::vector<uint64_t> const & keys,
+    bench::options const & opts)
+{
+  std::vector<uint32_t> seeds(nodes);
+  std::vector<float> inverse_weights(nodes, 1.0f);
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (std::size_t i = 0 ; i < nodes ; ++i) {
+    seeds[i] = static_cast<uint32_t>(bench::next_random(state));
+  }
+
+  std::size_t sink = 0;
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < keys.size() ; ++i) {
+        sink += func(&seeds[0], &inverse_weights[0], nodes, keys[i]);
+      }
+    }, keys.size() * nodes, opts);
+
+  char metric[64];
+  std::snprintf(metric, sizeof(metric), "ns_%zu_nodes", nodes);
+  bench::print_metric("shard_routing", variant, metric, res.ns / keys.size());
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+shard_routing(bench::options const & opts)
+{
+  std::vector<uint64_t> keys(1024);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < keys.size() ; ++i) {
+    keys[i] = bench::next_random(state);
+  }
+
+  std::size_t const node_counts[] = { 16, 256, 4096 };
+  for (std::size_t nodes : node_counts) {
+    char metric[64];
+    std::snprintf(metric, sizeof(metric), "ns_%zu_nodes", nodes);
+    std::size_t sink = 0;
+
+    std::vector<std::pair<uint64_t, std::size_t> > ring;
+    for (std::size_t n = 0 ; n < nodes ; ++n) {
+      for (std::size_t v = 0 ; v < 100 ; ++v) {
+        ring.push_back(std::make_pair(h::multi_hash(n, v), n));
+      }
+    }
+    std::sort(ring.begin(), ring.end());
+
+    bench::result res = bench::measure([&]() {
+        for (std::size_t i = 0 ; i < keys.size() ; ++i) {
+          auto iter = std::lower_bound(ring.begin(), ring.end(),
+              std::make_pair(keys[i], std::size_t(0)));
+          sink += (iter == ring.end() ? ring.begin() : iter)->second;
+        }
+      }, keys.size() * 8, opts);
+    bench::print_metric("shard_routing", "ring", metric, res.ns / keys.size());
+
+    res = bench::measure([&]() {
+        for (std::size_t i = 0 ; i < keys.size() ; ++i) {
+          sink += h::jump_consistent_hash(keys[i],
+              static_cast<uint32_t>(nodes));
+        }
+      }, keys.size() * 8, opts);
+    bench::print_metric("shard_routing", "jump", metric, res.ns / keys.size());
+
+    rendezvous_kernel("rendezvous_scalar", &h::detail::scalar_rendezvous,
+        nodes, keys, opts);
+#if defined(META_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      rendezvous_kernel("rendezvous_avx2", &h::detail::avx2_rendezvous,
+          nodes, keys, opts);
+    }
+#endif
+
+    if (sink == 42) {
+      std::printf("#\n");
+    }
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+  run<legacy_hash>("legacy", opts);
+  run<meta_hash>("meta", opts);
+
+  bytes_throughput("meta", [](char const * data, std::size_t size) {
+      return h::hash_bytes(data, size);
+    }, ~std::size_t(0), opts);
+  bytes_throughput("wyhash", [](char const * data, std::size_t size) {
+      return h::wyhash(data, size);
+    }, ~std::size_t(0), opts);
+  bytes_throughput("fnv1a", [](char const * data, std::size_t size) {
+      return h::fnv1a(data, size);
+    }, 65536, opts);
+
+  batch_throughput(opts);
+  tree_throughput(opts);
+  perfect_lookup(opts);
+  hashed_pipeline(opts);
+  shard_routing(opts);
+}
@@ -0,0 +1,154 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * meta::hash::interner compared against symbol tables built from
+ * std::unordered_map and flat_map, for a few thousand symbols. All numbers
+ * are ns per symbol:
+ *
+ * - intern_new: interning all symbols into an empty table.
+ * - find: looking up symbols that are interned.
+ * - equal: comparing symbols for equality, as strings or as IDs.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/interner.h>
+#include <meta/flat_map.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace h = meta::hash;
+
+namespace {
+
+template <typename mapT>
+void
+map_symbols(char const * variant, std::vector<std::string> const & symbols,
+    bench::options const & opts)
+{
+  std::size_t const count = symbols.size();
+  std::size_t const bytes = count * 16;
+  std::size_t sink = 0;
+
+  bench::result res = bench::measure([&]() {
+      mapT map;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += map.insert(std::make_pair(symbols[i],
+              uint32_t(map.size()))).first->second;
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", variant, "ns_intern_new", res.ns / count);
+
+  mapT map;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    map.insert(std::make_pair(symbols[i], uint32_t(i)));
+  }
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += map.find(symbols[i])->second;
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", variant, "ns_find", res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+run(bench::options const & opts)
+{
+  std::size_t const count = 4096;
+  std::vector<std::string> symbols(count);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "ns::symbol_%llx",
+        static_cast<unsigned long long>(
+          bench::next_random(state) & 0xffffffff));
+    symbols[i] = buf;
+  }
+  std::size_t const bytes = count * 16;
+  std::size_t sink = 0;
+
+  map_symbols<std::unordered_map<std::string, uint32_t> >("unordered_map",
+      symbols, opts);
+  map_symbols<h::flat_map<std::string, uint32_t> >("flat_map", symbols,
+      opts);
+
+  bench::result res = bench::measure([&]() {
+      h::interner table;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += table.intern(symbols[i]);
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", "interner", "ns_intern_new", res.ns / count);
+
+  h::interner table;
+  std::vector<uint32_t> ids(count);
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    ids[i] = table.intern(symbols[i]);
+  }
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += table.find(symbols[i]);
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", "interner", "ns_find", res.ns / count);
+
+  // Each symbol against a copy of itself, and against its neighbour, which
+  // shares a long prefix.
+  std::vector<std::string> copies(symbols);
+  res = bench::measure([&]() {
+      for (std::size_t i = 1 ; i < count ; ++i) {
+        sink += (symbols[i] == copies[i]) + (symbols[i] == copies[i - 1]);
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", "string", "ns_equal", res.ns / (2 * count));
+
+  std::vector<uint32_t> id_copies(ids);
+  res = bench::measure([&]() {
+      for (std::size_t i = 1 ; i < count ; ++i) {
+        sink += (ids[i] == id_copies[i]) + (ids[i] == id_copies[i - 1]);
+      }
+    }, bytes, opts);
+  bench::print_metric("interner", "id", "ns_equal", res.ns / (2 * count));
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+  run(opts);
+}
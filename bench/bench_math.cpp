@@ -0,0 +1,169 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Unit conversion with meta::math::convert(), compared against multiplying
+ * and dividing by the factor's terms at runtime, as code does that reads the
+ * clock frequency from configuration. Conversions are of 24 MHz ticks into
+ * nanoseconds, a fractional factor, and of microseconds into nanoseconds,
+ * an integral one, in ns per value.
+ *
+ * Division by a runtime divisor with meta::math::fast_divider, compared
+ * against the hardware division, for taking hashes modulo a bucket count as
+ * partitioning does; dividing values one by one, with either kind of
+ * divider, and dividing arrays, in ns per value.
+ *
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/math.h>
+
+#include <vector>
+
+namespace m = meta::math;
+
+namespace {
+
+template <typename fromT, typename toT>
+void
+convert(char const * metric, std::vector<uint64_t> const & values,
+    bench::options const & opts)
+{
+  typedef m::detail::conversion_factor<fromT, toT> factor;
+  std::size_t const count = values.size();
+  std::vector<uint64_t> out(count);
+
+  // Runtime terms, as if read from configuration.
+  uint64_t volatile dividend_source = factor::DIVIDEND;
+  uint64_t volatile divisor_source = factor::DIVISOR;
+  uint64_t dividend = dividend_source;
+  uint64_t divisor = divisor_source;
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        out[i] = values[i] * dividend / divisor;
+      }
+    }, count * sizeof(uint64_t), opts);
+  bench::print_metric("convert", "runtime_divide", metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      m::convert<fromT, toT>(&values[0], &out[0], count);
+    }, count * sizeof(uint64_t), opts);
+  bench::print_metric("convert", "convert", metric, res.ns / count);
+}
+
+
+
+template <typename intT, bool BRANCH_FREE>
+void
+modulo_divider(char const * variant, char const * metric,
+    std::vector<intT> const & values, intT divisor, intT & sink,
+    bench::options const & opts)
+{
+  std::size_t const count = values.size();
+  m::fast_divider<intT, BRANCH_FREE> divider(divisor);
+  intT salt = 0;
+  bench::result res = bench::measure([&]() {
+      intT sum = 0;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sum += intT(values[i] ^ salt) % divider;
+      }
+      sink += sum;
+      ++salt;
+    }, count * sizeof(intT), opts);
+  bench::print_metric("divide", variant, metric, res.ns / count);
+}
+
+
+template <typename intT>
+void
+modulo(char const * metric, intT divisor, bench::options const & opts)
+{
+  std::size_t const count = 4096;
+  std::vector<intT> values(count);
+  std::vector<intT> out(count);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    values[i] = static_cast<intT>(bench::next_random(state));
+  }
+
+  intT volatile divisor_source = divisor;
+  intT runtime_divisor = divisor_source;
+  // Varying the values keeps compilers from hoisting the loop out of the
+  // measurement.
+  intT sink = 0;
+  intT salt = 0;
+  bench::result res = bench::measure([&]() {
+      intT sum = 0;
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sum += intT(values[i] ^ salt) % runtime_divisor;
+      }
+      sink += sum;
+      ++salt;
+    }, count * sizeof(intT), opts);
+  bench::print_metric("divide", "hardware", metric, res.ns / count);
+
+  modulo_divider<intT, false>("fast_divider", metric, values, divisor, sink,
+      opts);
+  modulo_divider<intT, true>("branch_free", metric, values, divisor, sink,
+      opts);
+
+  m::fast_divider<intT> divider(divisor);
+  res = bench::measure([&]() {
+      divider.modulo(&values[0], &out[0], count);
+    }, count * sizeof(intT), opts);
+  bench::print_metric("divide", "bulk", metric, res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+
+  // Timestamps of up to about a day, so that runtime_divide does not
+  // overflow.
+  std::vector<uint64_t> values(4096);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < values.size() ; ++i) {
+    values[i] = bench::next_random(state) % (uint64_t(24000000) * 86400);
+  }
+
+  convert<m::ratio<uint64_t, 1, 24000000>,
+    m::ratio<uint64_t, 1, 1000000000> >("ns_ticks_to_ns", values, opts);
+  convert<m::ratio<uint64_t, 1, 1000000>,
+    m::ratio<uint64_t, 1, 1000000000> >("ns_us_to_ns", values, opts);
+
+  // Bucket counts that need the multiply-add algorithm, and one that doesn't.
+  modulo<uint32_t>("ns_u32_mod_1000", 1000, opts);
+  modulo<uint32_t>("ns_u32_mod_7", 7, opts);
+  modulo<int32_t>("ns_i32_mod_7", 7, opts);
+  modulo<uint64_t>("ns_u64_mod_7", 7, opts);
+  modulo<int64_t>("ns_i64_mod_1000", 1000, opts);
+}
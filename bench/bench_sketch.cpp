@@ -0,0 +1,248 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * The sketches in meta/sketch.h, for filters that fit into the caches as well
+ * as filters that do not.
+ *
+ * - bloom_filter: meta::hash::bloom_filter, compared against a classic Bloom
+ *   filter of the same size, whose probes are spread over the whole filter.
+ *   Reports ns per insert and per query of present and absent values, and the
+ *   false positive rate in percent.
+ * - bloom_kernels: the membership test kernels alone, in ns per query, for
+ *   a mix of hits and misses, and for hits only.
+ * - count_min: ns per add and per estimate.
+ *
+ * Values are hashed up front, so that only the data structures are measured.
+ * Pass --quick for a fast smoke test.
+ **/
+
+#include <bench/bench.h>
+
+#include <meta/sketch.h>
+
+#include <vector>
+
+namespace h = meta::hash;
+namespace d = meta::hash::detail;
+
+namespace {
+
+/**
+ * A classic Bloom filter with 10 bits per value and 7 probes, using the same
+ * double hashing over the whole bit array.
+ **/
+class classic_bloom
+{
+public:
+  explicit classic_bloom(std::size_t values)
+    : m_bits(values * 10)
+    , m_words((m_bits + 63) / 64)
+  {
+  }
+
+  inline void insert_hash(uint64_t hash)
+  {
+    uint64_t pos = hash;
+    uint64_t step = (hash >> 32) | 1;
+    for (std::size_t i = 0 ; i < 7 ; ++i, pos += step) {
+      uint64_t bit = pos % m_bits;
+      m_words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+  }
+
+  inline bool contains_hash(uint64_t hash) const
+  {
+    uint64_t pos = hash;
+    uint64_t step = (hash >> 32) | 1;
+    for (std::size_t i = 0 ; i < 7 ; ++i, pos += step) {
+      uint64_t bit = pos % m_bits;
+      if (!((m_words[bit / 64] >> (bit % 64)) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::size_t           m_bits;
+  std::vector<uint64_t> m_words;
+};
+
+
+template <typename filterT>
+void
+filter_operations(char const * variant, filterT & filter,
+    std::vector<uint64_t> const & present,
+    std::vector<uint64_t> const & absent, bench::options const & opts)
+{
+  std::size_t const count = present.size();
+  std::size_t const bytes = count * sizeof(uint64_t);
+  std::size_t sink = 0;
+  char metric[64];
+
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        filter.insert_hash(present[i]);
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_insert_%zu", count);
+  bench::print_metric("bloom_filter", variant, metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += filter.contains_hash(present[i]);
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_hit_%zu", count);
+  bench::print_metric("bloom_filter", variant, metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += filter.contains_hash(absent[i]);
+      }
+    }, bytes, opts);
+  std::snprintf(metric, sizeof(metric), "ns_miss_%zu", count);
+  bench::print_metric("bloom_filter", variant, metric, res.ns / count);
+
+  std::size_t false_positives = 0;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    false_positives += filter.contains_hash(absent[i]);
+  }
+  std::snprintf(metric, sizeof(metric), "fpr_percent_%zu", count);
+  bench::print_metric("bloom_filter", variant, metric,
+      100.0 * false_positives / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+kernel(char const * variant, d::bloom_test_func func,
+    std::vector<uint64_t> const & hashes, bool full,
+    bench::options const & opts)
+{
+  // Few blocks, so that the kernel dominates, not cache misses. Full blocks
+  // make every query a hit; otherwise, blocks are three quarters full, and
+  // most queries are misses.
+  std::size_t const blocks = 64;
+  std::vector<uint32_t> storage(blocks * d::BLOOM_BLOCK_WORDS);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  for (std::size_t i = 0 ; i < storage.size() ; ++i) {
+    storage[i] = full ? ~uint32_t(0) : static_cast<uint32_t>(
+        bench::next_random(state) | bench::next_random(state));
+  }
+
+  std::size_t sink = 0;
+  char metric[64];
+  std::size_t const probes[] = { 4, 7, 12 };
+  for (std::size_t k : probes) {
+    bench::result res = bench::measure([&]() {
+        for (std::size_t i = 0 ; i < hashes.size() ; ++i) {
+          sink += func(&storage[(hashes[i] % blocks) * d::BLOOM_BLOCK_WORDS],
+              hashes[i], k);
+        }
+      }, hashes.size() * sizeof(uint64_t), opts);
+    std::snprintf(metric, sizeof(metric), "ns_%s_k%zu",
+        full ? "hit" : "query", k);
+    bench::print_metric("bloom_kernels", variant, metric,
+        res.ns / hashes.size());
+  }
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+
+void
+count_min(std::vector<uint64_t> const & hashes, bench::options const & opts)
+{
+  std::size_t const count = hashes.size();
+  std::size_t sink = 0;
+  char metric[64];
+
+  h::count_min_sketch<> sketch(count / 4, 4);
+  bench::result res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += sketch.add_hash(hashes[i]);
+      }
+    }, count * sizeof(uint64_t), opts);
+  std::snprintf(metric, sizeof(metric), "ns_add_%zu", count);
+  bench::print_metric("count_min", "depth_4", metric, res.ns / count);
+
+  res = bench::measure([&]() {
+      for (std::size_t i = 0 ; i < count ; ++i) {
+        sink += sketch.estimate_hash(hashes[i]);
+      }
+    }, count * sizeof(uint64_t), opts);
+  std::snprintf(metric, sizeof(metric), "ns_estimate_%zu", count);
+  bench::print_metric("count_min", "depth_4", metric, res.ns / count);
+
+  if (sink == 42) {
+    std::printf("#\n");
+  }
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  bench::options opts(argc, argv);
+
+  bench::print_metric_header();
+
+  std::size_t const sizes[] = { std::size_t(1) << 14,
+    std::size_t(1) << (opts.quick ? 18 : 23) };
+  for (std::size_t count : sizes) {
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    std::vector<uint64_t> present(count);
+    std::vector<uint64_t> absent(count);
+    for (std::size_t i = 0 ; i < count ; ++i) {
+      present[i] = bench::next_random(state);
+      absent[i] = bench::next_random(state);
+    }
+
+    classic_bloom classic(count);
+    filter_operations("classic", classic, present, absent, opts);
+    h::bloom_filter blocked(count);
+    filter_operations("blocked", blocked, present, absent, opts);
+
+    count_min(present, opts);
+  }
+
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  std::vector<uint64_t> hashes(std::size_t(1) << 12);
+  for (std::size_t i = 0 ; i < hashes.size() ; ++i) {
+    hashes[i] = bench::next_random(state);
+  }
+  for (bool full : { false, true }) {
+    kernel("scalar", &d::scalar_bloom_test, hashes, full, opts);
+#if defined(META_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      kernel("avx2", &d::avx2_bloom_test, hashes, full, opts);
+    }
+#endif
+  }
+}
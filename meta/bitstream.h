@@ -0,0 +1,415 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_BITSTREAM_H
+#define META_BITSTREAM_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#include <cstddef>
+
+#include <meta/byteorder.h>
+#include <meta/cursor.h>
+
+namespace meta {
+namespace byte_order {
+
+/**
+ * The largest field bit_reader and bit_writer can process in one call.
+ **/
+static unsigned int const MAX_BIT_FIELD = 56;
+
+namespace detail {
+
+/**
+ * The smallest unsigned type that holds N bits. It is deliberately undefined
+ * for field widths the bit streams can't handle.
+ **/
+template <unsigned int N, bool VALID = (N >= 1 && N <= MAX_BIT_FIELD)>
+struct bits_type;
+
+template <unsigned int N>
+struct bits_type<N, true>
+{
+  typedef typename uint_of_size<
+    (N <= 8 ? 1 : (N <= 16 ? 2 : (N <= 32 ? 4 : 8)))
+  >::type type;
+};
+
+
+/**
+ * Bit order within the 64 bit accumulator. Big endian streams are MSB first,
+ * i.e. the next bit is the accumulator's most significant bit; little endian
+ * streams are LSB first. Values are "aligned" to the front of the accumulator
+ * before they are appended.
+ **/
+template <int ENDIAN>
+struct bit_order;
+
+template <>
+struct bit_order<META_BIG_ENDIAN>
+{
+  inline static uint64_t align(uint64_t value, unsigned int n)
+  {
+    return value << (64 - n);
+  }
+
+  inline static uint64_t append(uint64_t bits, uint64_t aligned,
+      unsigned int count)
+  {
+    return bits | (aligned >> count);
+  }
+
+  inline static uint64_t front(uint64_t bits, unsigned int n)
+  {
+    return bits >> (64 - n);
+  }
+
+  inline static uint64_t drop(uint64_t bits, unsigned int n)
+  {
+    return bits << n;
+  }
+};
+
+template <>
+struct bit_order<META_LITTLE_ENDIAN>
+{
+  inline static uint64_t align(uint64_t value, unsigned int)
+  {
+    return value;
+  }
+
+  inline static uint64_t append(uint64_t bits, uint64_t aligned,
+      unsigned int count)
+  {
+    return bits | (aligned << count);
+  }
+
+  inline static uint64_t front(uint64_t bits, unsigned int n)
+  {
+    return bits & ((uint64_t(1) << n) - 1);
+  }
+
+  inline static uint64_t drop(uint64_t bits, unsigned int n)
+  {
+    return bits >> n;
+  }
+};
+
+
+inline META_CONSTEXPR uint64_t
+low_bits(unsigned int n)
+{
+  return (uint64_t(1) << n) - 1;
+}
+
+} // namespace detail
+
+
+
+/**
+ * The bit_reader class reads bit fields of up to MAX_BIT_FIELD bits from a
+ * buffer. Big endian streams are read MSB first, little endian streams LSB
+ * first, which in either case means that a field spanning bytes reads like
+ * an integer of the stream's byte order.
+ *
+ * The reader keeps up to 64 bits in an accumulator, which is refilled with a
+ * single unaligned load (and byte swap, if necessary) whenever it runs low.
+ * Prefer read<N>() over read(n) where the field width is known at compile
+ * time; all shifts and masks then fold to constants.
+ *
+ *    bit_reader<> r(buffer, size);
+ *    uint8_t version = r.read<4>();
+ *    uint16_t length = r.read<12>();
+ *    uint32_t offset = r.read<20>();
+ *
+ * Reads past the end of the buffer throw out_of_range_error.
+ **/
+template <int ENDIAN = META_BIG_ENDIAN>
+class bit_reader
+{
+public:
+  inline bit_reader(void const * buffer, std::size_t size)
+    : m_start(static_cast<unsigned char const *>(buffer))
+    , m_current(m_start)
+    , m_end(m_start + size)
+    , m_bits(0)
+    , m_count(0)
+  {
+  }
+
+  /**
+   * Bits consumed so far, and bits left to read.
+   **/
+  inline std::size_t bit_position() const
+  {
+    return static_cast<std::size_t>(m_current - m_start) * 8 - m_count;
+  }
+
+  inline std::size_t bits_remaining() const
+  {
+    return static_cast<std::size_t>(m_end - m_start) * 8 - bit_position();
+  }
+
+  /**
+   * Read an N bit field.
+   **/
+  template <unsigned int N>
+  inline typename detail::bits_type<N>::type read()
+  {
+    typedef typename detail::bits_type<N>::type result_t;
+    typedef detail::bit_order<ENDIAN> order;
+
+    require(N);
+    result_t value = static_cast<result_t>(order::front(m_bits, N));
+    m_bits = order::drop(m_bits, N);
+    m_count -= N;
+    return value;
+  }
+
+  /**
+   * Return the next N bits without consuming them.
+   **/
+  template <unsigned int N>
+  inline typename detail::bits_type<N>::type peek()
+  {
+    typedef typename detail::bits_type<N>::type result_t;
+
+    require(N);
+    return static_cast<result_t>(detail::bit_order<ENDIAN>::front(m_bits, N));
+  }
+
+  /**
+   * Read a field of n bits, where n is at most MAX_BIT_FIELD.
+   **/
+  inline uint64_t read(unsigned int n)
+  {
+    typedef detail::bit_order<ENDIAN> order;
+
+    if (!n) {
+      return 0;
+    }
+    require(n);
+    uint64_t value = order::front(m_bits, n);
+    m_bits = order::drop(m_bits, n);
+    m_count -= n;
+    return value;
+  }
+
+  /**
+   * Skip n bits, or up to the next byte boundary.
+   **/
+  inline void skip(std::size_t n)
+  {
+    while (n > MAX_BIT_FIELD) {
+      read(MAX_BIT_FIELD);
+      n -= MAX_BIT_FIELD;
+    }
+    read(static_cast<unsigned int>(n));
+  }
+
+  inline void align()
+  {
+    read(static_cast<unsigned int>((8 - bit_position() % 8) % 8));
+  }
+
+private:
+  /**
+   * Make sure at least n bits are in the accumulator, or throw.
+   **/
+  inline void require(unsigned int n)
+  {
+    if (m_count < n) {
+      refill();
+      if (m_count < n) {
+        throw out_of_range_error("Read past the end of the bit stream.");
+      }
+    }
+  }
+
+  /**
+   * While at least 8 bytes remain, load them all and advance by as many
+   * whole bytes as fit into the accumulator. The bytes that don't fit are
+   * loaded again next time, so the accumulator always holds 56 to 63 bits
+   * afterwards. Near the end of the buffer, refill byte by byte instead.
+   **/
+  inline void refill()
+  {
+    typedef detail::bit_order<ENDIAN> order;
+
+    if (m_end - m_current >= 8) {
+      m_bits = order::append(m_bits, load<ENDIAN, uint64_t>(m_current),
+          m_count);
+      m_current += (63 - m_count) >> 3;
+      m_count |= 56;
+      return;
+    }
+
+    while (m_count <= 56 && m_current < m_end) {
+      m_bits = order::append(m_bits, order::align(*m_current++, 8), m_count);
+      m_count += 8;
+    }
+  }
+
+  unsigned char const * m_start;
+  unsigned char const * m_current;
+  unsigned char const * m_end;
+  uint64_t              m_bits;
+  unsigned int          m_count;
+};
+
+
+
+/**
+ * The bit_writer class is the counterpart to bit_reader. Bits are collected
+ * in an accumulator and stored eight bytes at a time.
+ *
+ * Call flush() when done; it writes out any buffered bits, padding the last
+ * byte with zero bits if necessary.
+ *
+ * Writes past the end of the buffer throw out_of_range_error.
+ **/
+template <int ENDIAN = META_BIG_ENDIAN>
+class bit_writer
+{
+public:
+  inline bit_writer(void * buffer, std::size_t size)
+    : m_start(static_cast<unsigned char *>(buffer))
+    , m_current(m_start)
+    , m_end(m_start + size)
+    , m_bits(0)
+    , m_count(0)
+  {
+  }
+
+  /**
+   * Bits written so far, and bits left in the buffer.
+   **/
+  inline std::size_t bit_position() const
+  {
+    return static_cast<std::size_t>(m_current - m_start) * 8 + m_count;
+  }
+
+  inline std::size_t bits_remaining() const
+  {
+    return static_cast<std::size_t>(m_end - m_start) * 8 - bit_position();
+  }
+
+  /**
+   * Write the low N bits of value; any other bits are ignored.
+   **/
+  template <unsigned int N, typename intT>
+  inline void write(intT value)
+  {
+    // Fails to compile for unsupported field widths.
+    typedef typename detail::bits_type<N>::type check_t;
+    (void) sizeof(check_t);
+
+    put(static_cast<uint64_t>(value) & detail::low_bits(N), N);
+  }
+
+  /**
+   * Write the low n bits of value, where n is at most MAX_BIT_FIELD.
+   **/
+  inline void write(uint64_t value, unsigned int n)
+  {
+    if (!n) {
+      return;
+    }
+    put(value & detail::low_bits(n), n);
+  }
+
+  /**
+   * Write zero bits up to the next byte boundary.
+   **/
+  inline void align()
+  {
+    write(0, static_cast<unsigned int>((8 - bit_position() % 8) % 8));
+  }
+
+  /**
+   * Write all buffered bits to the buffer, including a zero padded partial
+   * byte. Returns the number of bytes written in total.
+   **/
+  inline std::size_t flush()
+  {
+    typedef detail::bit_order<ENDIAN> order;
+
+    drain();
+    if (m_count) {
+      *m_current++ = static_cast<unsigned char>(order::front(m_bits, 8));
+      m_bits = 0;
+      m_count = 0;
+    }
+    return static_cast<std::size_t>(m_current - m_start);
+  }
+
+private:
+  inline void put(uint64_t value, unsigned int n)
+  {
+    typedef detail::bit_order<ENDIAN> order;
+
+    if (n > bits_remaining()) {
+      throw out_of_range_error("Write past the end of the bit stream.");
+    }
+    if (m_count + n > 63) {
+      drain();
+    }
+    m_bits = order::append(m_bits, order::align(value, n), m_count);
+    m_count += n;
+  }
+
+  /**
+   * Store all complete bytes in the accumulator; with at least 8 bytes of
+   * buffer left, that's a single store of the whole accumulator.
+   **/
+  inline void drain()
+  {
+    typedef detail::bit_order<ENDIAN> order;
+
+    unsigned int bytes = m_count >> 3;
+    if (m_end - m_current >= 8) {
+      store<ENDIAN>(m_current, m_bits);
+    } else {
+      uint64_t tmp = m_bits;
+      for (unsigned int i = 0 ; i < bytes ; ++i) {
+        m_current[i] = static_cast<unsigned char>(order::front(tmp, 8));
+        tmp = order::drop(tmp, 8);
+      }
+    }
+    m_current += bytes;
+    m_bits = order::drop(m_bits, bytes * 8);
+    m_count &= 7;
+  }
+
+  unsigned char * m_start;
+  unsigned char * m_current;
+  unsigned char * m_end;
+  uint64_t        m_bits;
+  unsigned int    m_count;
+};
+
+}} // namespace meta::byte_order
+
+#endif // guard
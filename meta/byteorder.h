@@ -38,15 +38,18 @@
 #  include <byteswap.h>
 #endif
 
+#include <cstddef>
+#include <cstring>
+
 
 /**
  * If we can grab the byte order from CMake, do that.
  **/
 #if defined(META_BIGENDIAN)
 #  if 0 == META_BIGENDIAN
-#    define META_BYTE_ORDER_TMP 4321
-#  else // META_BIGENDIAN
 #    define META_BYTE_ORDER_TMP 1234
+#  else // META_BIGENDIAN
+#    define META_BYTE_ORDER_TMP 4321
 #  endif // META_BIGENDIAN
 #elif defined(META_HAVE_ENDIAN_H)
 #  define META_BYTE_ORDER_TMP __BYTE_ORDER
@@ -56,6 +59,22 @@
 #endif // __GNUC__
 
 
+/**
+ * GCC and clang provide byte swapping builtins that can be evaluated at
+ * compile-time. Only if neither those nor byteswap.h are available do we
+ * fall back to shifting bytes around manually (which is also constexpr).
+ **/
+#if defined(__GNUC__)
+#  define META_BYTE_ORDER_SWAP_BUILTIN
+#endif
+
+#if defined(META_BYTE_ORDER_SWAP_BUILTIN) || !defined(META_HAVE_BYTESWAP_H)
+#  define META_BYTE_ORDER_SWAP_CONSTEXPR META_CONSTEXPR
+#else
+#  define META_BYTE_ORDER_SWAP_CONSTEXPR
+#endif
+
+
 namespace meta {
 namespace byte_order {
 
@@ -98,8 +117,9 @@ struct host_helper<1234>
 
 /**
  * In the end, host_byte_order does not add anything to META_BYTE_ORDER_TMP -
- * except that it's either -1, 0 or 1, i.e. values that are more easily used
- * as array indices (see decision matrix in to_host() below).
+ * except that it's either -1, 0 or 1, i.e. the same values as the endian
+ * enum above, which makes it usable as a template argument (see to_host()
+ * below).
  *
  * If you want to avoid warnings and manual casts, compare against the
  * return value of host_byte_order() below instead of META_BYTE_ORDER
@@ -117,7 +137,7 @@ enum { META_BYTE_ORDER = detail::host_helper<META_BYTE_ORDER_TMP>::value };
  * to be able to compare it against endian values without warnings (or
  * manually casting yourself).
  **/
-inline endian host_byte_order()
+inline META_CONSTEXPR endian host_byte_order()
 {
   return static_cast<endian>(META_BYTE_ORDER);
 }
@@ -159,91 +179,211 @@ inline endian opposite(int arg)
 
 
 /**
- * Swap byte order of various integer sizes.
+ * Maps a size in bytes to the unsigned integer type of that size. Values of
+ * other types (floating point, mostly) are swapped via their integer
+ * representation.
  **/
-inline uint16_t swap(uint16_t const & orig)
+namespace detail {
+
+template <std::size_t SIZE>
+struct uint_of_size;
+
+template <>
+struct uint_of_size<1>
 {
-#if defined(META_HAVE_BYTESWAP_H)
-#  pragma GCC diagnostic push
-#  pragma GCC diagnostic ignored "-Wold-style-cast"
-  return bswap_16(orig);
-#  pragma GCC diagnostic pop
-#else
-  return ((orig & 0xff00) >> 8) |
-         ((orig & 0x00ff) << 8);
-#endif
-}
+  typedef uint8_t type;
+};
 
-inline int16_t swap(int16_t const & orig)
+template <>
+struct uint_of_size<2>
 {
-#if defined(META_HAVE_BYTESWAP_H)
-#  pragma GCC diagnostic push
-#  pragma GCC diagnostic ignored "-Wold-style-cast"
-  return bswap_16(orig);
-#  pragma GCC diagnostic pop
-#else
-  return swap(static_cast<uint16_t>(orig));
+  typedef uint16_t type;
+};
+
+template <>
+struct uint_of_size<4>
+{
+  typedef uint32_t type;
+};
+
+template <>
+struct uint_of_size<8>
+{
+  typedef uint64_t type;
+};
+
+#if defined(META_HAVE_INT128)
+template <>
+struct uint_of_size<16>
+{
+  typedef ::meta::uint128_t type;
+};
 #endif
+
+} // namespace detail
+
+
+/**
+ * Swap byte order by shifting bytes around manually. swap() below uses these
+ * only if no faster alternative is available, but they're kept around for
+ * comparison.
+ **/
+namespace detail {
+
+inline META_CONSTEXPR uint16_t shift_swap(uint16_t const & orig)
+{
+  return static_cast<uint16_t>(((orig & 0xff00) >> 8) |
+                               ((orig & 0x00ff) << 8));
 }
 
-inline uint32_t swap(uint32_t const & orig)
+inline META_CONSTEXPR uint32_t shift_swap(uint32_t const & orig)
 {
-#if defined(META_HAVE_BYTESWAP_H)
-#  pragma GCC diagnostic push
-#  pragma GCC diagnostic ignored "-Wold-style-cast"
-  return bswap_32(orig);
-#  pragma GCC diagnostic pop
-#else
   return ((orig & 0xff000000UL) >> 24) |
          ((orig & 0x00ff0000UL) >> 8)  |
          ((orig & 0x0000ff00UL) << 8)  |
          ((orig & 0x000000ffUL) << 24);
-#endif
 }
 
-inline int32_t swap(int32_t const & orig)
+inline META_CONSTEXPR uint64_t shift_swap(uint64_t const & orig)
 {
-#if defined(META_HAVE_BYTESWAP_H)
+  return ((orig & (static_cast<uint64_t>(0xff) << 56)) >> 56) |
+         ((orig & (static_cast<uint64_t>(0xff) << 48)) >> 40) |
+         ((orig & (static_cast<uint64_t>(0xff) << 40)) >> 24) |
+         ((orig & (static_cast<uint64_t>(0xff) << 32)) >> 8)  |
+         ((orig & (static_cast<uint64_t>(0xff) << 24)) << 8)  |
+         ((orig & (static_cast<uint64_t>(0xff) << 16)) << 24) |
+         ((orig & (static_cast<uint64_t>(0xff) <<  8)) << 40) |
+         ((orig &  static_cast<uint64_t>(0xff)       ) << 56);
+}
+
+} // namespace detail
+
+
+/**
+ * Swap byte order of various integer sizes. In C++11 mode, these are
+ * constexpr wherever the platform allows it, so constants can be converted
+ * at compile-time. Single bytes are passed through unchanged, which keeps
+ * generic code simple.
+ **/
+inline META_CONSTEXPR uint8_t swap(uint8_t const & orig)
+{
+  return orig;
+}
+
+inline META_CONSTEXPR int8_t swap(int8_t const & orig)
+{
+  return orig;
+}
+
+inline META_BYTE_ORDER_SWAP_CONSTEXPR uint16_t swap(uint16_t const & orig)
+{
+#if defined(META_BYTE_ORDER_SWAP_BUILTIN)
+  return __builtin_bswap16(orig);
+#elif defined(META_HAVE_BYTESWAP_H)
 #  pragma GCC diagnostic push
 #  pragma GCC diagnostic ignored "-Wold-style-cast"
-  return bswap_32(orig);
+  return bswap_16(orig);
 #  pragma GCC diagnostic pop
 #else
-  return swap(static_cast<uint32_t>(orig));
+  return detail::shift_swap(orig);
 #endif
 }
 
-inline uint64_t swap(uint64_t const & orig)
+inline META_BYTE_ORDER_SWAP_CONSTEXPR int16_t swap(int16_t const & orig)
 {
-#if defined(META_HAVE_BYTESWAP_H)
+  return static_cast<int16_t>(swap(static_cast<uint16_t>(orig)));
+}
+
+inline META_BYTE_ORDER_SWAP_CONSTEXPR uint32_t swap(uint32_t const & orig)
+{
+#if defined(META_BYTE_ORDER_SWAP_BUILTIN)
+  return __builtin_bswap32(orig);
+#elif defined(META_HAVE_BYTESWAP_H)
 #  pragma GCC diagnostic push
 #  pragma GCC diagnostic ignored "-Wold-style-cast"
-  return bswap_64(orig);
+  return bswap_32(orig);
 #  pragma GCC diagnostic pop
 #else
-  return ((orig & (static_cast<uint64_t>(0xff) << 56)) >> 56) |
-         ((orig & (static_cast<uint64_t>(0xff) << 48)) >> 40) |
-         ((orig & (static_cast<uint64_t>(0xff) << 40)) >> 24) |
-         ((orig & (static_cast<uint64_t>(0xff) << 32)) >> 8)  |
-         ((orig & (static_cast<uint64_t>(0xff) << 24)) << 8)  |
-         ((orig & (static_cast<uint64_t>(0xff) << 16)) << 24) |
-         ((orig & (static_cast<uint64_t>(0xff) <<  8)) << 40) |
-         ((orig &  static_cast<uint64_t>(0xff)       ) << 56);
+  return detail::shift_swap(orig);
 #endif
 }
 
-inline int64_t swap(int64_t const & orig)
+inline META_BYTE_ORDER_SWAP_CONSTEXPR int32_t swap(int32_t const & orig)
 {
-#if defined(META_HAVE_BYTESWAP_H)
+  return static_cast<int32_t>(swap(static_cast<uint32_t>(orig)));
+}
+
+inline META_BYTE_ORDER_SWAP_CONSTEXPR uint64_t swap(uint64_t const & orig)
+{
+#if defined(META_BYTE_ORDER_SWAP_BUILTIN)
+  return __builtin_bswap64(orig);
+#elif defined(META_HAVE_BYTESWAP_H)
 #  pragma GCC diagnostic push
 #  pragma GCC diagnostic ignored "-Wold-style-cast"
   return bswap_64(orig);
 #  pragma GCC diagnostic pop
 #else
-  return swap(static_cast<uint64_t>(orig));
+  return detail::shift_swap(orig);
 #endif
 }
 
+inline META_BYTE_ORDER_SWAP_CONSTEXPR int64_t swap(int64_t const & orig)
+{
+  return static_cast<int64_t>(swap(static_cast<uint64_t>(orig)));
+}
+
+#if defined(META_HAVE_INT128)
+inline META_BYTE_ORDER_SWAP_CONSTEXPR ::meta::uint128_t
+swap(::meta::uint128_t const & orig)
+{
+  return (static_cast< ::meta::uint128_t>(
+        swap(static_cast<uint64_t>(orig))) << 64)
+    | swap(static_cast<uint64_t>(orig >> 64));
+}
+
+inline META_BYTE_ORDER_SWAP_CONSTEXPR ::meta::int128_t
+swap(::meta::int128_t const & orig)
+{
+  return static_cast< ::meta::int128_t>(
+      swap(static_cast< ::meta::uint128_t>(orig)));
+}
+#endif
+
+
+/**
+ * Floating point values are swapped via their integer representation. Note
+ * that a swapped value is only good for storing or transmitting; it may well
+ * be a signalling NaN, so do not compute with it.
+ **/
+namespace detail {
+
+template <typename valueT>
+inline valueT
+bit_cast_swap(valueT const & orig)
+{
+  typedef typename uint_of_size<sizeof(valueT)>::type uint_t;
+
+  uint_t tmp;
+  std::memcpy(&tmp, &orig, sizeof(valueT));
+  tmp = swap(tmp);
+
+  valueT result;
+  std::memcpy(&result, &tmp, sizeof(valueT));
+  return result;
+}
+
+} // namespace detail
+
+inline float swap(float const & orig)
+{
+  return detail::bit_cast_swap(orig);
+}
+
+inline double swap(double const & orig)
+{
+  return detail::bit_cast_swap(orig);
+}
+
 
 /**
  * Unspecialized declaration of convert. Specialized versions of convert contain
@@ -267,7 +407,7 @@ template <>
 struct convert<META_LITTLE_ENDIAN>
 {
   template <typename intT>
-  inline static intT hton(intT const & orig)
+  inline static META_BYTE_ORDER_SWAP_CONSTEXPR intT hton(intT const & orig)
   {
     // because network byte order is big endian, we need to swap the
     // endianness of the input integer.
@@ -275,7 +415,7 @@ struct convert<META_LITTLE_ENDIAN>
   }
 
   template <typename intT>
-  inline static intT ntoh(intT const & orig)
+  inline static META_BYTE_ORDER_SWAP_CONSTEXPR intT ntoh(intT const & orig)
   {
     // because network byte order is big endian, we need to swap the
     // endianness of the input integer.
@@ -292,14 +432,14 @@ template <>
 struct convert<META_BIG_ENDIAN>
 {
   template <typename intT>
-  inline static intT hton(intT const & orig)
+  inline static META_BYTE_ORDER_SWAP_CONSTEXPR intT hton(intT const & orig)
   {
     // network byte order is already big endian, so no changes required.
     return orig;
   }
 
   template <typename intT>
-  inline static intT ntoh(intT const & orig)
+  inline static META_BYTE_ORDER_SWAP_CONSTEXPR intT ntoh(intT const & orig)
   {
     // network byte order is already big endian, so no changes required.
     return orig;
@@ -307,25 +447,55 @@ struct convert<META_BIG_ENDIAN>
 };
 
 
+/**
+ * Swap or don't swap, depending on a compile-time decision.
+ **/
+namespace detail {
+
+template <bool SWAP>
+struct conditional_swap
+{
+  template <typename intT>
+  inline static META_BYTE_ORDER_SWAP_CONSTEXPR intT apply(intT const & orig)
+  {
+    return swap(orig);
+  }
+};
+
+template <>
+struct conditional_swap<false>
+{
+  template <typename intT>
+  inline static META_CONSTEXPR intT apply(intT const & orig)
+  {
+    return orig;
+  }
+};
+
+} // namespace detail
+
+
 /**
  * Use the to_host() function to convert an integer value from a given endianess
  * to the endianess of the host. The function detects whether endianess swapping
  * needs to be performed or not.
+ *
+ * If the endianess of the integer is known at compile-time, pass it as a
+ * template parameter instead, e.g. to_host<META_BIG_ENDIAN>(value). That
+ * version resolves to either swap() or nothing at all.
  **/
 template <typename intT>
-inline intT
+inline META_BYTE_ORDER_SWAP_CONSTEXPR intT
 to_host(intT const & int_value, endian int_endian)
 {
-  static bool const decision[2][2] = {
-    // int is BE   int is LE
-    { false,      true,  }, // host BE
-    { true,       false, }, // host LE
-  };
+  return (int_endian == host_byte_order() ? int_value : swap(int_value));
+}
 
-  if (decision[META_BYTE_ORDER][int_endian]) {
-    return swap(int_value);
-  }
-  return int_value;
+template <int ENDIAN, typename intT>
+inline META_BYTE_ORDER_SWAP_CONSTEXPR intT
+to_host(intT const & int_value)
+{
+  return detail::conditional_swap<ENDIAN != META_BYTE_ORDER>::apply(int_value);
 }
 
 
@@ -335,19 +505,265 @@ to_host(intT const & int_value, endian int_endian)
  * specified byte order.
  **/
 template <typename intT>
-inline intT
+inline META_BYTE_ORDER_SWAP_CONSTEXPR intT
 from_host(intT const & int_value, endian int_endian)
 {
-  static bool const decision[2][2] = {
-    // int is BE   int is LE
-    { false,      true,  }, // host BE
-    { true,       false, }, // host LE
-  };
+  return (int_endian == host_byte_order() ? int_value : swap(int_value));
+}
+
+template <int ENDIAN, typename intT>
+inline META_BYTE_ORDER_SWAP_CONSTEXPR intT
+from_host(intT const & int_value)
+{
+  return detail::conditional_swap<ENDIAN != META_BYTE_ORDER>::apply(int_value);
+}
+
+
+/**
+ * Load an integer in the given byte order from arbitrary, possibly unaligned
+ * memory, or store one there. These go through memcpy() to avoid undefined
+ * behaviour, which compilers turn into a plain load or store followed by a
+ * bswap (or a single movbe where the target supports it).
+ **/
+template <int ENDIAN, typename intT>
+inline intT
+load(void const * src)
+{
+  // Swap the integer representation, so that floating point values never
+  // exist in swapped form outside of memory.
+  typedef typename detail::uint_of_size<sizeof(intT)>::type uint_t;
+
+  uint_t tmp;
+  std::memcpy(&tmp, src, sizeof(intT));
+  tmp = to_host<ENDIAN>(tmp);
+
+  intT result;
+  std::memcpy(&result, &tmp, sizeof(intT));
+  return result;
+}
+
+template <int ENDIAN, typename intT>
+inline void
+store(void * dest, intT const & value)
+{
+  typedef typename detail::uint_of_size<sizeof(intT)>::type uint_t;
+
+  uint_t tmp;
+  std::memcpy(&tmp, &value, sizeof(intT));
+  tmp = from_host<ENDIAN>(tmp);
+  std::memcpy(dest, &tmp, sizeof(intT));
+}
+
+
+template <typename intT>
+inline intT
+load_be(void const * src)
+{
+  return load<META_BIG_ENDIAN, intT>(src);
+}
+
+template <typename intT>
+inline intT
+load_le(void const * src)
+{
+  return load<META_LITTLE_ENDIAN, intT>(src);
+}
+
+template <typename intT>
+inline void
+store_be(void * dest, intT const & value)
+{
+  store<META_BIG_ENDIAN>(dest, value);
+}
+
+template <typename intT>
+inline void
+store_le(void * dest, intT const & value)
+{
+  store<META_LITTLE_ENDIAN>(dest, value);
+}
+
+
+/**
+ * An integer stored in a fixed byte order. The value is converted from and to
+ * host byte order whenever it is read or written, but the storage itself is
+ * always in ENDIAN byte order.
+ *
+ * endian_value has the same size as intT, but an alignment of 1, and in C++11
+ * mode is trivially copyable. That means you can use it for fields of structs
+ * describing binary file or network formats, and lay those structs directly
+ * over a buffer instead of copying each field out first:
+ *
+ *    struct header
+ *    {
+ *      big_endian<uint16_t> type;
+ *      big_endian<uint32_t> length;
+ *    };
+ *
+ *    header const * hdr = reinterpret_cast<header const *>(buffer);
+ *    uint32_t length = hdr->length;
+ *
+ * The big_endian and little_endian aliases are only available in C++11 mode;
+ * in C++98 mode, use endian_value directly.
+ **/
+template <typename intT, int ENDIAN>
+class endian_value
+{
+public:
+  typedef intT value_type;
+
+#if META_CXX_MODE == META_CXX_MODE_CXX0X
+  endian_value() = default;
+#else
+  inline endian_value()
+  {
+  }
+#endif
+
+  inline endian_value(intT const & value)
+  {
+    set(value);
+  }
+
+  inline endian_value & operator=(intT const & value)
+  {
+    set(value);
+    return *this;
+  }
+
+  inline operator intT() const
+  {
+    return get();
+  }
+
+  inline intT get() const
+  {
+    return load<ENDIAN, intT>(m_bytes);
+  }
+
+  inline void set(intT const & value)
+  {
+    store<ENDIAN>(m_bytes, value);
+  }
+
+private:
+  unsigned char m_bytes[sizeof(intT)];
+};
+
+
+#if META_CXX_MODE == META_CXX_MODE_CXX0X
+template <typename intT>
+using big_endian = endian_value<intT, META_BIG_ENDIAN>;
+
+template <typename intT>
+using little_endian = endian_value<intT, META_LITTLE_ENDIAN>;
+#endif
+
+}} // namespace meta::byte_order
+
+
+#include <meta/detail/bulk_swap.h>
+
+namespace meta {
+namespace byte_order {
+
+/**
+ * Swap the byte order of count integers at once. The first version works in
+ * place, the second reads from src and writes to dest; dest and src must
+ * either be identical or not overlap at all.
+ *
+ * Depending on the CPU the code runs on, the bulk of the buffer is processed
+ * with SSSE3 or AVX2 shuffles, falling back to swap() on other platforms.
+ * Buffers need not be aligned to the vector size.
+ **/
+template <typename intT>
+inline void
+swap_n(intT * values, std::size_t count)
+{
+  detail::bulk_swap<sizeof(intT)>(reinterpret_cast<char *>(values),
+      reinterpret_cast<char const *>(values), count);
+}
 
-  if (decision[META_BYTE_ORDER][int_endian]) {
-    return swap(int_value);
+template <typename intT>
+inline void
+swap_n(intT * dest, intT const * src, std::size_t count)
+{
+  detail::bulk_swap<sizeof(intT)>(reinterpret_cast<char *>(dest),
+      reinterpret_cast<char const *>(src), count);
+}
+
+
+/**
+ * Bulk versions of to_host() and from_host(), with the same in place and out
+ * of place variants as swap_n() above, and again with the endianess passed
+ * either at runtime or as a template parameter.
+ **/
+template <typename intT>
+inline void
+to_host_n(intT * values, std::size_t count, endian int_endian)
+{
+  if (int_endian != host_byte_order()) {
+    swap_n(values, count);
+  }
+}
+
+template <typename intT>
+inline void
+to_host_n(intT * dest, intT const * src, std::size_t count, endian int_endian)
+{
+  if (int_endian != host_byte_order()) {
+    swap_n(dest, src, count);
+  } else if (dest != src) {
+    std::memcpy(dest, src, count * sizeof(intT));
   }
-  return int_value;
+}
+
+template <int ENDIAN, typename intT>
+inline void
+to_host_n(intT * values, std::size_t count)
+{
+  if (ENDIAN != META_BYTE_ORDER) {
+    swap_n(values, count);
+  }
+}
+
+template <int ENDIAN, typename intT>
+inline void
+to_host_n(intT * dest, intT const * src, std::size_t count)
+{
+  if (ENDIAN != META_BYTE_ORDER) {
+    swap_n(dest, src, count);
+  } else if (dest != src) {
+    std::memcpy(dest, src, count * sizeof(intT));
+  }
+}
+
+template <typename intT>
+inline void
+from_host_n(intT * values, std::size_t count, endian int_endian)
+{
+  to_host_n(values, count, int_endian);
+}
+
+template <typename intT>
+inline void
+from_host_n(intT * dest, intT const * src, std::size_t count, endian int_endian)
+{
+  to_host_n(dest, src, count, int_endian);
+}
+
+template <int ENDIAN, typename intT>
+inline void
+from_host_n(intT * values, std::size_t count)
+{
+  to_host_n<ENDIAN>(values, count);
+}
+
+template <int ENDIAN, typename intT>
+inline void
+from_host_n(intT * dest, intT const * src, std::size_t count)
+{
+  to_host_n<ENDIAN>(dest, src, count);
 }
 
 }} // namespace meta::byte_order
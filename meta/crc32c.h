@@ -0,0 +1,88 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_CRC32C_H
+#define META_CRC32C_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/crc32c.h because there's no C++11 support.
+#endif
+
+#include <cstddef>
+
+#include <meta/inttypes.h>
+#include <meta/detail/crc32c.h>
+
+namespace meta {
+namespace crc32c {
+
+/**
+ * CRC32C (Castagnoli) checksums, as used by iSCSI, SCTP, ext4 and many
+ * storage formats.
+ *
+ * On x86-64 CPUs with SSE4.2, the crc32 instruction is used, on three
+ * interleaved streams for longer buffers; with PCLMUL, the streams are merged
+ * with carry-less multiplies instead of table lookups. Elsewhere, a
+ * slicing-by-8 table implementation is used. The choice is made at runtime,
+ * on the first call.
+ *
+ *    uint32_t crc = checksum(data, size);
+ *
+ * extend() continues a checksum with more data, so that
+ *
+ *    extend(checksum(a, size_a), b, size_b)
+ *
+ * is the checksum of a followed by b.
+ **/
+inline uint32_t
+extend(uint32_t crc, void const * data, std::size_t size)
+{
+  return ~detail::extend(~crc, static_cast<unsigned char const *>(data), size);
+}
+
+inline uint32_t
+checksum(void const * data, std::size_t size)
+{
+  return extend(0, data, size);
+}
+
+
+/**
+ * The checksum of a followed by b, from the checksums of a and b and the size
+ * of b. This allows checksumming chunks of a buffer independently, e.g. on
+ * multiple threads, and combining the results. The cost grows with the
+ * logarithm of size_b.
+ **/
+inline uint32_t
+combine(uint32_t crc_a, uint32_t crc_b, std::size_t size_b)
+{
+  return detail::multmodp(
+      detail::get_tables().xnmodp(uint64_t(size_b) * 8), crc_a) ^ crc_b;
+}
+
+}} // namespace meta::crc32c
+
+#endif // guard
@@ -0,0 +1,239 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_CURSOR_H
+#define META_CURSOR_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#include <stdexcept>
+#include <cstddef>
+#include <cstring>
+
+#include <meta/byteorder.h>
+
+namespace meta {
+namespace byte_order {
+
+/**
+ * The reader and writer classes below throw out_of_range_error when an
+ * operation would exceed the buffer they were constructed with.
+ **/
+typedef std::out_of_range out_of_range_error;
+
+
+/**
+ * The reader class reads integers in ENDIAN byte order (network byte order by
+ * default) from a buffer, advancing its position with each read.
+ *
+ * Every read is bounds checked by default. When decoding fixed-size records,
+ * it's cheaper to check the bounds once per record and then read the fields
+ * without further checks:
+ *
+ *    reader<> r(buffer, size);
+ *    r.require(6);
+ *    uint16_t type = r.read_unchecked<uint16_t>();
+ *    uint32_t length = r.read_unchecked<uint32_t>();
+ **/
+template <int ENDIAN = META_BIG_ENDIAN>
+class reader
+{
+public:
+  inline reader(void const * buffer, std::size_t size)
+    : m_start(static_cast<char const *>(buffer))
+    , m_current(m_start)
+    , m_end(m_start + size)
+  {
+  }
+
+  /**
+   * Bytes consumed so far, and bytes left to read.
+   **/
+  inline std::size_t position() const
+  {
+    return static_cast<std::size_t>(m_current - m_start);
+  }
+
+  inline std::size_t remaining() const
+  {
+    return static_cast<std::size_t>(m_end - m_current);
+  }
+
+  /**
+   * Pointer to the next byte to be read.
+   **/
+  inline char const * current() const
+  {
+    return m_current;
+  }
+
+  /**
+   * Returns true if at least size bytes remain; require() throws instead.
+   **/
+  inline bool has(std::size_t size) const
+  {
+    return size <= remaining();
+  }
+
+  inline void require(std::size_t size) const
+  {
+    if (!has(size)) {
+      throw out_of_range_error("Read past the end of the buffer.");
+    }
+  }
+
+  /**
+   * Read an integer, converting it to host byte order.
+   **/
+  template <typename intT>
+  inline intT read()
+  {
+    require(sizeof(intT));
+    return read_unchecked<intT>();
+  }
+
+  template <typename intT>
+  inline intT read_unchecked()
+  {
+    intT value = load<ENDIAN, intT>(m_current);
+    m_current += sizeof(intT);
+    return value;
+  }
+
+  template <typename intT>
+  inline reader & operator>>(intT & value)
+  {
+    value = read<intT>();
+    return *this;
+  }
+
+  /**
+   * Copy size raw bytes to dest, or skip them entirely.
+   **/
+  inline void read(void * dest, std::size_t size)
+  {
+    require(size);
+    std::memcpy(dest, m_current, size);
+    m_current += size;
+  }
+
+  inline void skip(std::size_t size)
+  {
+    require(size);
+    m_current += size;
+  }
+
+private:
+  char const *  m_start;
+  char const *  m_current;
+  char const *  m_end;
+};
+
+
+
+/**
+ * The writer class is the counterpart to reader, converting integers to
+ * ENDIAN byte order as it writes them to a buffer.
+ **/
+template <int ENDIAN = META_BIG_ENDIAN>
+class writer
+{
+public:
+  inline writer(void * buffer, std::size_t size)
+    : m_start(static_cast<char *>(buffer))
+    , m_current(m_start)
+    , m_end(m_start + size)
+  {
+  }
+
+  inline std::size_t position() const
+  {
+    return static_cast<std::size_t>(m_current - m_start);
+  }
+
+  inline std::size_t remaining() const
+  {
+    return static_cast<std::size_t>(m_end - m_current);
+  }
+
+  inline char * current() const
+  {
+    return m_current;
+  }
+
+  inline bool has(std::size_t size) const
+  {
+    return size <= remaining();
+  }
+
+  inline void require(std::size_t size) const
+  {
+    if (!has(size)) {
+      throw out_of_range_error("Write past the end of the buffer.");
+    }
+  }
+
+  template <typename intT>
+  inline void write(intT const & value)
+  {
+    require(sizeof(intT));
+    write_unchecked(value);
+  }
+
+  template <typename intT>
+  inline void write_unchecked(intT const & value)
+  {
+    store<ENDIAN>(m_current, value);
+    m_current += sizeof(intT);
+  }
+
+  template <typename intT>
+  inline writer & operator<<(intT const & value)
+  {
+    write(value);
+    return *this;
+  }
+
+  inline void write(void const * src, std::size_t size)
+  {
+    require(size);
+    std::memcpy(m_current, src, size);
+    m_current += size;
+  }
+
+  inline void skip(std::size_t size)
+  {
+    require(size);
+    m_current += size;
+  }
+
+private:
+  char *  m_start;
+  char *  m_current;
+  char *  m_end;
+};
+
+}} // namespace meta::byte_order
+
+#endif // guard
@@ -0,0 +1,210 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_BULK_SWAP_H
+#define META_DETAIL_BULK_SWAP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+namespace meta {
+namespace byte_order {
+namespace detail {
+
+/**
+ * Portable kernel; the vector kernels below also use it for the parts of a
+ * buffer that do not fill an entire vector register.
+ **/
+template <std::size_t SIZE>
+inline void
+scalar_bulk_swap(char * dest, char const * src, std::size_t count)
+{
+  typedef typename uint_of_size<SIZE>::type uint_t;
+
+  for (std::size_t i = 0 ; i < count ; ++i, dest += SIZE, src += SIZE) {
+    uint_t tmp;
+    std::memcpy(&tmp, src, SIZE);
+    tmp = swap(tmp);
+    std::memcpy(dest, &tmp, SIZE);
+  }
+}
+
+
+/**
+ * Returns the number of elements to process before dest is aligned to ALIGN
+ * bytes. If dest is not aligned to SIZE, ALIGN can never be reached with
+ * whole elements, and the vector kernels just use unaligned stores throughout.
+ **/
+template <std::size_t SIZE, std::size_t ALIGN>
+inline std::size_t
+alignment_head(char const * dest, std::size_t count)
+{
+  std::size_t misalign = reinterpret_cast<uintptr_t>(dest) % ALIGN;
+  if (!misalign || misalign % SIZE) {
+    return 0;
+  }
+  std::size_t head = (ALIGN - misalign) / SIZE;
+  return head < count ? head : count;
+}
+
+
+/**
+ * The shuffle mask reverses the bytes within each SIZE byte lane of a
+ * vector of VECTOR bytes.
+ **/
+template <std::size_t SIZE, std::size_t VECTOR>
+inline void
+make_shuffle_mask(char (& mask)[VECTOR])
+{
+  for (std::size_t i = 0 ; i < VECTOR ; ++i) {
+    mask[i] = static_cast<char>((i / SIZE) * SIZE + (SIZE - 1 - i % SIZE));
+  }
+}
+
+
+#if defined(META_X86_SIMD)
+
+template <std::size_t SIZE>
+__attribute__((target("ssse3")))
+inline void
+ssse3_bulk_swap(char * dest, char const * src, std::size_t count)
+{
+  std::size_t head = alignment_head<SIZE, 16>(dest, count);
+  scalar_bulk_swap<SIZE>(dest, src, head);
+  dest += head * SIZE;
+  src += head * SIZE;
+  count -= head;
+
+  char mask_bytes[16];
+  make_shuffle_mask<SIZE>(mask_bytes);
+  __m128i const mask = _mm_loadu_si128(
+      reinterpret_cast<__m128i const *>(mask_bytes));
+
+  std::size_t const per_vector = 16 / SIZE;
+  for ( ; count >= per_vector ; count -= per_vector, dest += 16, src += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest),
+        _mm_shuffle_epi8(v, mask));
+  }
+
+  scalar_bulk_swap<SIZE>(dest, src, count);
+}
+
+
+
+template <std::size_t SIZE>
+__attribute__((target("avx2")))
+inline void
+avx2_bulk_swap(char * dest, char const * src, std::size_t count)
+{
+  std::size_t head = alignment_head<SIZE, 32>(dest, count);
+  scalar_bulk_swap<SIZE>(dest, src, head);
+  dest += head * SIZE;
+  src += head * SIZE;
+  count -= head;
+
+  char mask_bytes[32];
+  make_shuffle_mask<SIZE>(mask_bytes);
+  __m256i const mask = _mm256_loadu_si256(
+      reinterpret_cast<__m256i const *>(mask_bytes));
+
+  // Four vectors per iteration keep enough loads in flight to saturate
+  // memory bandwidth on large buffers.
+  std::size_t const per_vector = 32 / SIZE;
+  for ( ; count >= 4 * per_vector ; count -= 4 * per_vector,
+      dest += 128, src += 128)
+  {
+    __m256i const * s = reinterpret_cast<__m256i const *>(src);
+    __m256i * d = reinterpret_cast<__m256i *>(dest);
+    __m256i v0 = _mm256_loadu_si256(s);
+    __m256i v1 = _mm256_loadu_si256(s + 1);
+    __m256i v2 = _mm256_loadu_si256(s + 2);
+    __m256i v3 = _mm256_loadu_si256(s + 3);
+    _mm256_storeu_si256(d,     _mm256_shuffle_epi8(v0, mask));
+    _mm256_storeu_si256(d + 1, _mm256_shuffle_epi8(v1, mask));
+    _mm256_storeu_si256(d + 2, _mm256_shuffle_epi8(v2, mask));
+    _mm256_storeu_si256(d + 3, _mm256_shuffle_epi8(v3, mask));
+  }
+
+  for ( ; count >= per_vector ; count -= per_vector, dest += 32, src += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest),
+        _mm256_shuffle_epi8(v, mask));
+  }
+
+  scalar_bulk_swap<SIZE>(dest, src, count);
+}
+
+#endif // META_X86_SIMD
+
+
+/**
+ * Select the best kernel the CPU we're running on supports.
+ **/
+typedef void (*bulk_swap_func)(char *, char const *, std::size_t);
+
+template <std::size_t SIZE>
+inline bulk_swap_func
+select_bulk_swap()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_bulk_swap<SIZE>;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return &ssse3_bulk_swap<SIZE>;
+  }
+#endif
+  return &scalar_bulk_swap<SIZE>;
+}
+
+
+/**
+ * Entry point for the public swap_n() and friends. Buffers too small to fill
+ * a single vector are not worth the indirect call.
+ **/
+template <std::size_t SIZE>
+inline void
+bulk_swap(char * dest, char const * src, std::size_t count)
+{
+  if (count < 16 / SIZE) {
+    scalar_bulk_swap<SIZE>(dest, src, count);
+    return;
+  }
+
+  static bulk_swap_func const func = select_bulk_swap<SIZE>();
+  func(dest, src, count);
+}
+
+}}} // namespace meta::byte_order::detail
+
+#endif // guard
@@ -0,0 +1,332 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_CRC32C_H
+#define META_DETAIL_CRC32C_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+#include <meta/byteorder.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD) && defined(__x86_64__)
+#  include <immintrin.h>
+#  define META_CRC32C_HW
+#endif
+
+namespace meta {
+namespace crc32c {
+namespace detail {
+
+/**
+ * The kernels below operate on the raw CRC register, i.e. without the
+ * inversion before and after that the CRC32C definition requires.
+ *
+ * Polynomials are in bit reflected order, as the CRC itself: the most
+ * significant bit is the coefficient of x^0.
+ **/
+static uint32_t const POLY = 0x82f63b78UL;
+static uint32_t const X0 = 0x80000000UL;
+
+// a(x) * b(x) modulo POLY
+inline uint32_t
+multmodp(uint32_t a, uint32_t b)
+{
+  uint32_t m = X0;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if (!(a & (m - 1))) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ POLY : b >> 1;
+  }
+  return p;
+}
+
+
+/**
+ * With the hardware crc32 instruction, the latency of each step is three
+ * times its throughput. Long buffers are therefore split into three streams,
+ * each of LONG_BLOCK or SHORT_BLOCK bytes, whose CRCs are computed together.
+ * The three results are merged by shifting the first two by the length of
+ * the streams after them, which is a multiplication by x^(8 * length).
+ **/
+static std::size_t const LONG_BLOCK = 8192;
+static std::size_t const SHORT_BLOCK = 256;
+
+struct tables
+{
+  // x^(2^n) modulo POLY
+  uint32_t  x2n[32];
+
+  // Slicing-by-8
+  uint32_t  slice[8][256];
+
+  // Shifting a CRC by a stream length, one byte of it at a time.
+  uint32_t  long_shift[4][256];
+  uint32_t  short_shift[4][256];
+
+  // For shifting with PCLMUL; see pclmul_shift().
+  uint64_t  long_clmul;
+  uint64_t  short_clmul;
+
+  inline tables()
+  {
+    uint32_t p = X0 >> 1;
+    for (std::size_t n = 0 ; n < 32 ; ++n) {
+      x2n[n] = p;
+      p = multmodp(p, p);
+    }
+
+    for (uint32_t n = 0 ; n < 256 ; ++n) {
+      uint32_t crc = n;
+      for (std::size_t k = 0 ; k < 8 ; ++k) {
+        crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+      }
+      slice[0][n] = crc;
+    }
+    for (uint32_t n = 0 ; n < 256 ; ++n) {
+      for (std::size_t k = 1 ; k < 8 ; ++k) {
+        slice[k][n] = (slice[k - 1][n] >> 8)
+          ^ slice[0][slice[k - 1][n] & 0xff];
+      }
+    }
+
+    fill_shift(long_shift, xnmodp(8 * LONG_BLOCK));
+    fill_shift(short_shift, xnmodp(8 * SHORT_BLOCK));
+
+    // The crc32 instruction multiplies by another x^33.
+    long_clmul = xnmodp(8 * LONG_BLOCK - 33);
+    short_clmul = xnmodp(8 * SHORT_BLOCK - 33);
+  }
+
+  // x^n modulo POLY
+  inline uint32_t xnmodp(uint64_t n) const
+  {
+    uint32_t p = X0;
+    for (std::size_t k = 0 ; n ; n >>= 1, ++k) {
+      if (n & 1) {
+        p = multmodp(x2n[k & 31], p);
+      }
+    }
+    return p;
+  }
+
+  inline static void fill_shift(uint32_t (& table)[4][256], uint32_t op)
+  {
+    for (std::size_t k = 0 ; k < 4 ; ++k) {
+      for (uint32_t n = 0 ; n < 256 ; ++n) {
+        table[k][n] = multmodp(op, n << (8 * k));
+      }
+    }
+  }
+};
+
+inline tables const &
+get_tables()
+{
+  static tables const t;
+  return t;
+}
+
+
+typedef uint32_t (*extend_func)(uint32_t, unsigned char const *, std::size_t);
+
+inline uint32_t
+scalar_extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  tables const & t = get_tables();
+
+  for ( ; size && (reinterpret_cast<std::size_t>(p) & 7) ; --size) {
+    crc = (crc >> 8) ^ t.slice[0][(crc ^ *p++) & 0xff];
+  }
+  for ( ; size >= 8 ; size -= 8, p += 8) {
+    crc ^= byte_order::load_le<uint32_t>(p);
+    crc = t.slice[7][crc & 0xff] ^ t.slice[6][(crc >> 8) & 0xff]
+      ^ t.slice[5][(crc >> 16) & 0xff] ^ t.slice[4][crc >> 24]
+      ^ t.slice[3][p[4]] ^ t.slice[2][p[5]]
+      ^ t.slice[1][p[6]] ^ t.slice[0][p[7]];
+  }
+  for ( ; size ; --size) {
+    crc = (crc >> 8) ^ t.slice[0][(crc ^ *p++) & 0xff];
+  }
+  return crc;
+}
+
+
+#if defined(META_CRC32C_HW)
+
+inline uint32_t
+table_shift(uint32_t const (& table)[4][256], uint32_t crc)
+{
+  return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff]
+    ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+struct table_shifts
+{
+  inline static uint32_t long_shift(uint32_t crc)
+  {
+    return table_shift(get_tables().long_shift, crc);
+  }
+
+  inline static uint32_t short_shift(uint32_t crc)
+  {
+    return table_shift(get_tables().short_shift, crc);
+  }
+};
+
+/**
+ * The carry-less product of a CRC and x^(n - 33) has 64 bits; running it
+ * through the crc32 instruction reduces it modulo POLY, and multiplies it by
+ * x^33 on the way. The result is the CRC multiplied by x^n.
+ **/
+__attribute__((target("sse4.2,pclmul")))
+inline uint32_t
+pclmul_shift(uint64_t op, uint32_t crc)
+{
+  __m128i product = _mm_clmulepi64_si128(
+      _mm_cvtsi32_si128(static_cast<int>(crc)),
+      _mm_cvtsi64_si128(static_cast<long long>(op)), 0);
+  return static_cast<uint32_t>(_mm_crc32_u64(0,
+        static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+}
+
+struct pclmul_shifts
+{
+  inline static uint32_t long_shift(uint32_t crc)
+  {
+    return pclmul_shift(get_tables().long_clmul, crc);
+  }
+
+  inline static uint32_t short_shift(uint32_t crc)
+  {
+    return pclmul_shift(get_tables().short_clmul, crc);
+  }
+};
+
+
+template <std::size_t BLOCK>
+__attribute__((target("sse4.2")))
+inline void
+crc_streams(uint64_t & crc0, uint64_t & crc1, uint64_t & crc2,
+    unsigned char const * p)
+{
+  for (std::size_t i = 0 ; i < BLOCK ; i += 8) {
+    crc0 = _mm_crc32_u64(crc0, byte_order::load_le<uint64_t>(p + i));
+    crc1 = _mm_crc32_u64(crc1, byte_order::load_le<uint64_t>(p + BLOCK + i));
+    crc2 = _mm_crc32_u64(crc2,
+        byte_order::load_le<uint64_t>(p + 2 * BLOCK + i));
+  }
+}
+
+template <typename shiftsT>
+__attribute__((target("sse4.2")))
+inline uint32_t
+hw_extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  for ( ; size && (reinterpret_cast<std::size_t>(p) & 7) ; --size) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+
+  while (size >= 3 * LONG_BLOCK) {
+    uint64_t crc0 = crc;
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    crc_streams<LONG_BLOCK>(crc0, crc1, crc2, p);
+    crc = shiftsT::long_shift(shiftsT::long_shift(
+          static_cast<uint32_t>(crc0)) ^ static_cast<uint32_t>(crc1))
+      ^ static_cast<uint32_t>(crc2);
+    p += 3 * LONG_BLOCK;
+    size -= 3 * LONG_BLOCK;
+  }
+
+  while (size >= 3 * SHORT_BLOCK) {
+    uint64_t crc0 = crc;
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    crc_streams<SHORT_BLOCK>(crc0, crc1, crc2, p);
+    crc = shiftsT::short_shift(shiftsT::short_shift(
+          static_cast<uint32_t>(crc0)) ^ static_cast<uint32_t>(crc1))
+      ^ static_cast<uint32_t>(crc2);
+    p += 3 * SHORT_BLOCK;
+    size -= 3 * SHORT_BLOCK;
+  }
+
+  uint64_t crc64 = crc;
+  for ( ; size >= 8 ; size -= 8, p += 8) {
+    crc64 = _mm_crc32_u64(crc64, byte_order::load_le<uint64_t>(p));
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for ( ; size ; --size) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+
+inline uint32_t
+sse42_extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  return hw_extend<table_shifts>(crc, p, size);
+}
+
+inline uint32_t
+pclmul_extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  return hw_extend<pclmul_shifts>(crc, p, size);
+}
+
+#endif // META_CRC32C_HW
+
+
+inline extend_func
+select_extend()
+{
+#if defined(META_CRC32C_HW)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    if (__builtin_cpu_supports("pclmul")) {
+      return &pclmul_extend;
+    }
+    return &sse42_extend;
+  }
+#endif
+  return &scalar_extend;
+}
+
+inline uint32_t
+extend(uint32_t crc, unsigned char const * p, std::size_t size)
+{
+  static extend_func const func = select_extend();
+  return func(crc, p, size);
+}
+
+}}} // namespace meta::crc32c::detail
+
+#endif // guard
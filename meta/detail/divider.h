@@ -0,0 +1,494 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_DIVIDER_H
+#define META_DETAIL_DIVIDER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+// Included from meta/math.h
+
+namespace meta {
+namespace math {
+namespace detail {
+
+/**
+ * Division of N bit values by an invariant divisor d, replaced with a
+ * multiplication by a fixed point reciprocal of d (the "magic" number) and
+ * shifts, after Granlund and Montgomery, "Division by Invariant Integers
+ * using Multiplication". Depending on d, one of three algorithms is used:
+ *
+ * - DIVIDE_SHIFT: n >> s2, for powers of two.
+ * - DIVIDE_MULTIPLY: mulhi(m, n) >> s2, where an N bit reciprocal is precise
+ *   enough.
+ * - DIVIDE_MULTIPLY_ADD: t = mulhi(m, n), then (t + ((n - t) >> s1)) >> s2,
+ *   for a reciprocal of N + 1 bits whose top bit is implied. This works for
+ *   every divisor, including one and powers of two.
+ *
+ * Signed values are divided by dividing their magnitudes; the quotient is
+ * negated if the signs differ, which truncates towards zero.
+ **/
+enum divide_algorithm
+{
+  DIVIDE_SHIFT,
+  DIVIDE_MULTIPLY,
+  DIVIDE_MULTIPLY_ADD
+};
+
+template <typename uintT>
+struct divider_params
+{
+  uintT             magic;
+  unsigned          shift1;
+  unsigned          shift2;
+  divide_algorithm  algorithm;
+};
+
+
+template <typename uintT>
+struct divide_word;
+
+template <>
+struct divide_word<uint32_t>
+{
+  inline static uint32_t mulhi(uint32_t a, uint32_t b)
+  {
+    return uint32_t((uint64_t(a) * b) >> 32);
+  }
+
+  // (hi * 2^32) / d and its remainder, for hi < d.
+  inline static uint32_t div_shifted(uint32_t hi, uint32_t d,
+      uint32_t & remainder)
+  {
+    uint64_t dividend = uint64_t(hi) << 32;
+    remainder = uint32_t(dividend % d);
+    return uint32_t(dividend / d);
+  }
+
+  inline static unsigned floor_log2(uint32_t value)
+  {
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(value);
+#else
+    unsigned result = 0;
+    while (value >>= 1) {
+      ++result;
+    }
+    return result;
+#endif
+  }
+};
+
+template <>
+struct divide_word<uint64_t>
+{
+  inline static uint64_t mulhi(uint64_t a, uint64_t b)
+  {
+    uint64_t hi, lo;
+    wide_mul(a, b, hi, lo);
+    return hi;
+  }
+
+  // (hi * 2^64) / d and its remainder, for hi < d.
+  inline static uint64_t div_shifted(uint64_t hi, uint64_t d,
+      uint64_t & remainder)
+  {
+    return wide_div(hi, 0, d, remainder);
+  }
+
+  inline static unsigned floor_log2(uint64_t value)
+  {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    unsigned result = 0;
+    while (value >>= 1) {
+      ++result;
+    }
+    return result;
+#endif
+  }
+};
+
+
+/**
+ * The parameters for dividing by d, which must not be zero. Branch free
+ * dividers always use DIVIDE_MULTIPLY_ADD.
+ **/
+template <typename uintT>
+inline divider_params<uintT>
+make_divider_params(uintT d, bool branch_free)
+{
+  typedef divide_word<uintT> word;
+
+  divider_params<uintT> params;
+  unsigned floor_log2 = word::floor_log2(d);
+  bool power_of_two = !(d & (d - 1));
+
+  if (!branch_free) {
+    if (power_of_two) {
+      params.magic = 0;
+      params.shift1 = 0;
+      params.shift2 = floor_log2;
+      params.algorithm = DIVIDE_SHIFT;
+      return params;
+    }
+
+    // m = ceil(2^(N + s) / d) with s = floor(log2(d)) is exact for all N bit
+    // values if its error m * d - 2^(N + s) is below 2^s.
+    uintT remainder;
+    uintT magic = word::div_shifted(uintT(uintT(1) << floor_log2), d,
+        remainder);
+    if (d - remainder < uintT(uintT(1) << floor_log2)) {
+      params.magic = magic + 1;
+      params.shift1 = 0;
+      params.shift2 = floor_log2;
+      params.algorithm = DIVIDE_MULTIPLY;
+      return params;
+    }
+  }
+
+  // m = floor(2^N * (2^l - d) / d) + 1 with l = ceil(log2(d)). 2^l - d is
+  // computed modulo 2^N, as l may be N.
+  unsigned ceil_log2 = power_of_two ? floor_log2 : floor_log2 + 1;
+  uintT excess = ceil_log2 ? uintT(uintT(uintT(2) << (ceil_log2 - 1)) - d) : 0;
+  uintT remainder;
+  params.magic = word::div_shifted(excess, d, remainder) + 1;
+  params.shift1 = ceil_log2 ? 1 : 0;
+  params.shift2 = ceil_log2 ? ceil_log2 - 1 : 0;
+  params.algorithm = DIVIDE_MULTIPLY_ADD;
+  return params;
+}
+
+
+template <divide_algorithm ALGORITHM>
+struct divide_step;
+
+template <>
+struct divide_step<DIVIDE_SHIFT>
+{
+  template <typename uintT>
+  inline static uintT apply(divider_params<uintT> const & params, uintT n)
+  {
+    return n >> params.shift2;
+  }
+};
+
+template <>
+struct divide_step<DIVIDE_MULTIPLY>
+{
+  template <typename uintT>
+  inline static uintT apply(divider_params<uintT> const & params, uintT n)
+  {
+    return divide_word<uintT>::mulhi(params.magic, n) >> params.shift2;
+  }
+};
+
+template <>
+struct divide_step<DIVIDE_MULTIPLY_ADD>
+{
+  template <typename uintT>
+  inline static uintT apply(divider_params<uintT> const & params, uintT n)
+  {
+    uintT t = divide_word<uintT>::mulhi(params.magic, n);
+    return uintT(t + uintT(uintT(n - t) >> params.shift1)) >> params.shift2;
+  }
+};
+
+
+// All bits set for negative values, none otherwise.
+template <typename intT>
+inline typename unsigned_type<intT>::type
+sign_mask(intT value)
+{
+  typedef typename unsigned_type<intT>::type unsigned_t;
+  return unsigned_t(unsigned_t(0) - unsigned_t(sign<intT>::negative(value)));
+}
+
+/**
+ * n / divisor, or n % divisor if REMAINDER is set. Like the built-in
+ * operators, the remainder has the sign of n.
+ **/
+template <divide_algorithm ALGORITHM, bool REMAINDER, typename intT>
+inline intT
+divide_value(divider_params<typename unsigned_type<intT>::type> const & params,
+    intT divisor, intT n)
+{
+  typedef typename unsigned_type<intT>::type unsigned_t;
+
+  unsigned_t n_sign = sign_mask(n);
+  unsigned_t magnitude = unsigned_t((unsigned_t(n) ^ n_sign) - n_sign);
+  unsigned_t sign = n_sign ^ sign_mask(divisor);
+  unsigned_t result = divide_step<ALGORITHM>::apply(params, magnitude);
+  result = unsigned_t((result ^ sign) - sign);
+  if (REMAINDER) {
+    result = unsigned_t(unsigned_t(n) - result * unsigned_t(divisor));
+  }
+  return static_cast<intT>(result);
+}
+
+
+template <typename intT>
+struct divide_func
+{
+  typedef void (*type)(
+      divider_params<typename unsigned_type<intT>::type> const &, intT,
+      intT const *, intT *, std::size_t, bool);
+};
+
+
+template <divide_algorithm ALGORITHM, typename intT>
+inline void
+scalar_divide_loop(
+    divider_params<typename unsigned_type<intT>::type> const & params,
+    intT divisor, intT const * in, intT * out, std::size_t count,
+    bool remainder)
+{
+  if (remainder) {
+    for (std::size_t i = 0 ; i < count ; ++i) {
+      out[i] = divide_value<ALGORITHM, true>(params, divisor, in[i]);
+    }
+  }
+  else {
+    for (std::size_t i = 0 ; i < count ; ++i) {
+      out[i] = divide_value<ALGORITHM, false>(params, divisor, in[i]);
+    }
+  }
+}
+
+template <typename intT>
+inline void
+scalar_divide(divider_params<typename unsigned_type<intT>::type> const & params,
+    intT divisor, intT const * in, intT * out, std::size_t count,
+    bool remainder)
+{
+  switch (params.algorithm) {
+    case DIVIDE_SHIFT:
+      scalar_divide_loop<DIVIDE_SHIFT>(params, divisor, in, out, count,
+          remainder);
+      break;
+
+    case DIVIDE_MULTIPLY:
+      scalar_divide_loop<DIVIDE_MULTIPLY>(params, divisor, in, out, count,
+          remainder);
+      break;
+
+    default:
+      scalar_divide_loop<DIVIDE_MULTIPLY_ADD>(params, divisor, in, out, count,
+          remainder);
+      break;
+  }
+}
+
+
+#if defined(META_X86_SIMD)
+
+/**
+ * AVX2 has no 32 bit multiplication that keeps the high halves, so even and
+ * odd lanes are multiplied into 64 bit products separately. 64 bit values
+ * would need four such multiplications per product, which is not faster than
+ * the scalar mul instruction, so they are only divided by the scalar kernel.
+ **/
+__attribute__((target("avx2")))
+inline __m256i
+avx2_mulhi_epu32(__m256i a, __m256i b)
+{
+  __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+  __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+      _mm256_srli_epi64(b, 32));
+  return _mm256_blend_epi32(even, odd, 0xaa);
+}
+
+
+template <divide_algorithm ALGORITHM>
+struct avx2_divide_step;
+
+template <>
+struct avx2_divide_step<DIVIDE_SHIFT>
+{
+  __attribute__((target("avx2")))
+  inline static __m256i apply(__m256i n, __m256i, __m128i, __m128i shift2)
+  {
+    return _mm256_srl_epi32(n, shift2);
+  }
+};
+
+template <>
+struct avx2_divide_step<DIVIDE_MULTIPLY>
+{
+  __attribute__((target("avx2")))
+  inline static __m256i apply(__m256i n, __m256i magic, __m128i,
+      __m128i shift2)
+  {
+    return _mm256_srl_epi32(avx2_mulhi_epu32(n, magic), shift2);
+  }
+};
+
+template <>
+struct avx2_divide_step<DIVIDE_MULTIPLY_ADD>
+{
+  __attribute__((target("avx2")))
+  inline static __m256i apply(__m256i n, __m256i magic, __m128i shift1,
+      __m128i shift2)
+  {
+    __m256i t = avx2_mulhi_epu32(n, magic);
+    return _mm256_srl_epi32(_mm256_add_epi32(t,
+          _mm256_srl_epi32(_mm256_sub_epi32(n, t), shift1)), shift2);
+  }
+};
+
+
+template <divide_algorithm ALGORITHM, bool REMAINDER, typename intT>
+__attribute__((target("avx2")))
+inline void
+avx2_divide_loop(divider_params<uint32_t> const & params, intT divisor,
+    intT const * in, intT * out, std::size_t count)
+{
+  bool const SIGNED = unsigned_type<intT>::SIGNED;
+
+  __m256i const magic = _mm256_set1_epi32(static_cast<int>(params.magic));
+  __m128i const shift1 = _mm_cvtsi32_si128(static_cast<int>(params.shift1));
+  __m128i const shift2 = _mm_cvtsi32_si128(static_cast<int>(params.shift2));
+  __m256i const divisor_sign = _mm256_set1_epi32(
+      static_cast<int>(sign_mask(divisor)));
+  __m256i const divisor_value = _mm256_set1_epi32(static_cast<int>(divisor));
+
+  std::size_t i = 0;
+  for ( ; i + 8 <= count ; i += 8) {
+    __m256i n = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(in + i));
+    __m256i result;
+    if (SIGNED) {
+      __m256i sign = _mm256_xor_si256(_mm256_srai_epi32(n, 31), divisor_sign);
+      result = avx2_divide_step<ALGORITHM>::apply(_mm256_abs_epi32(n), magic,
+          shift1, shift2);
+      result = _mm256_sub_epi32(_mm256_xor_si256(result, sign), sign);
+    }
+    else {
+      result = avx2_divide_step<ALGORITHM>::apply(n, magic, shift1, shift2);
+    }
+    if (REMAINDER) {
+      result = _mm256_sub_epi32(n, _mm256_mullo_epi32(result, divisor_value));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), result);
+  }
+
+  for ( ; i < count ; ++i) {
+    out[i] = divide_value<ALGORITHM, REMAINDER>(params, divisor, in[i]);
+  }
+}
+
+template <divide_algorithm ALGORITHM, typename intT>
+__attribute__((target("avx2")))
+inline void
+avx2_divide_loop(divider_params<uint32_t> const & params, intT divisor,
+    intT const * in, intT * out, std::size_t count, bool remainder)
+{
+  if (remainder) {
+    avx2_divide_loop<ALGORITHM, true>(params, divisor, in, out, count);
+  }
+  else {
+    avx2_divide_loop<ALGORITHM, false>(params, divisor, in, out, count);
+  }
+}
+
+template <typename intT>
+__attribute__((target("avx2")))
+inline void
+avx2_divide(divider_params<uint32_t> const & params, intT divisor,
+    intT const * in, intT * out, std::size_t count, bool remainder)
+{
+  switch (params.algorithm) {
+    case DIVIDE_SHIFT:
+      avx2_divide_loop<DIVIDE_SHIFT>(params, divisor, in, out, count,
+          remainder);
+      break;
+
+    case DIVIDE_MULTIPLY:
+      avx2_divide_loop<DIVIDE_MULTIPLY>(params, divisor, in, out, count,
+          remainder);
+      break;
+
+    default:
+      avx2_divide_loop<DIVIDE_MULTIPLY_ADD>(params, divisor, in, out, count,
+          remainder);
+      break;
+  }
+}
+
+#endif // META_X86_SIMD
+
+
+template <typename intT>
+struct select_divide
+{
+  inline static typename divide_func<intT>::type select()
+  {
+    return &scalar_divide<intT>;
+  }
+};
+
+#if defined(META_X86_SIMD)
+
+#define META_MATH_SELECT_DIVIDE(int_t)                \
+  template <>                                         \
+  struct select_divide<int_t>                         \
+  {                                                   \
+    inline static divide_func<int_t>::type select()   \
+    {                                                 \
+      __builtin_cpu_init();                           \
+      if (__builtin_cpu_supports("avx2")) {           \
+        return &avx2_divide<int_t>;                   \
+      }                                               \
+      return &scalar_divide<int_t>;                   \
+    }                                                 \
+  };
+
+META_MATH_SELECT_DIVIDE(int32_t);
+META_MATH_SELECT_DIVIDE(uint32_t);
+
+#undef META_MATH_SELECT_DIVIDE
+
+#endif // META_X86_SIMD
+
+template <typename intT>
+inline void
+divide(divider_params<typename unsigned_type<intT>::type> const & params,
+    intT divisor, intT const * in, intT * out, std::size_t count,
+    bool remainder)
+{
+  static typename divide_func<intT>::type const func
+    = select_divide<intT>::select();
+  func(params, divisor, in, out, count, remainder);
+}
+
+}}} // namespace meta::math::detail
+
+#endif // guard
@@ -0,0 +1,324 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_FIXED_H
+#define META_DETAIL_FIXED_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+#include <meta/math.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+// Included from meta/fixed.h
+
+namespace meta {
+namespace math {
+namespace detail {
+
+/**
+ * Kernels aggregating columns of raw fixed point values. Values narrower than
+ * 64 bits are summed in 64 bits, so that only the total can overflow. AVX2
+ * kernels exist for int32_t and int64_t, the usual raw types; the others
+ * are left to the scalar kernels, which compilers vectorize as well as they
+ * can.
+ **/
+template <typename intT, bool SIGNED = unsigned_type<intT>::SIGNED>
+struct sum_type
+{
+  typedef int64_t type;
+};
+
+template <typename intT>
+struct sum_type<intT, false>
+{
+  typedef uint64_t type;
+};
+
+
+struct minimum_op
+{
+  template <typename intT>
+  inline static intT apply(intT a, intT b)
+  {
+    return b < a ? b : a;
+  }
+
+#if defined(META_X86_SIMD)
+  __attribute__((target("avx2")))
+  inline static __m256i epi32(__m256i a, __m256i b)
+  {
+    return _mm256_min_epi32(a, b);
+  }
+
+  __attribute__((target("avx2")))
+  inline static __m256i epi64(__m256i a, __m256i b)
+  {
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+  }
+#endif
+};
+
+struct maximum_op
+{
+  template <typename intT>
+  inline static intT apply(intT a, intT b)
+  {
+    return a < b ? b : a;
+  }
+
+#if defined(META_X86_SIMD)
+  __attribute__((target("avx2")))
+  inline static __m256i epi32(__m256i a, __m256i b)
+  {
+    return _mm256_max_epi32(a, b);
+  }
+
+  __attribute__((target("avx2")))
+  inline static __m256i epi64(__m256i a, __m256i b)
+  {
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a));
+  }
+#endif
+};
+
+
+template <typename intT>
+inline typename sum_type<intT>::type
+scalar_sum(intT const * values, std::size_t count)
+{
+  typename sum_type<intT>::type result = 0;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    result += values[i];
+  }
+  return result;
+}
+
+// For count > 0
+template <typename opT, typename intT>
+inline intT
+scalar_extreme(intT const * values, std::size_t count)
+{
+  intT result = values[0];
+  for (std::size_t i = 1 ; i < count ; ++i) {
+    result = opT::apply(result, values[i]);
+  }
+  return result;
+}
+
+
+#if defined(META_X86_SIMD)
+
+template <typename intT>
+struct avx2_lanes;
+
+template <>
+struct avx2_lanes<int32_t>
+{
+  static std::size_t const COUNT = 8;
+
+  template <typename opT>
+  __attribute__((target("avx2")))
+  inline static __m256i apply(__m256i a, __m256i b)
+  {
+    return opT::epi32(a, b);
+  }
+};
+
+template <>
+struct avx2_lanes<int64_t>
+{
+  static std::size_t const COUNT = 4;
+
+  template <typename opT>
+  __attribute__((target("avx2")))
+  inline static __m256i apply(__m256i a, __m256i b)
+  {
+    return opT::epi64(a, b);
+  }
+};
+
+
+__attribute__((target("avx2")))
+inline int64_t
+avx2_horizontal_sum(__m256i sum)
+{
+  int64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sum);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+
+__attribute__((target("avx2")))
+inline int64_t
+avx2_sum_int32(int32_t const * values, std::size_t count)
+{
+  // Sign extended into 64 bit lanes.
+  __m256i sum0 = _mm256_setzero_si256();
+  __m256i sum1 = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for ( ; i + 8 <= count ; i += 8) {
+    __m256i v = _mm256_loadu_si256(
+        reinterpret_cast<__m256i const *>(values + i));
+    sum0 = _mm256_add_epi64(sum0,
+        _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+    sum1 = _mm256_add_epi64(sum1,
+        _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+  }
+  return avx2_horizontal_sum(_mm256_add_epi64(sum0, sum1))
+    + scalar_sum(values + i, count - i);
+}
+
+__attribute__((target("avx2")))
+inline int64_t
+avx2_sum_int64(int64_t const * values, std::size_t count)
+{
+  // Two accumulators hide the latency of the additions.
+  __m256i sum0 = _mm256_setzero_si256();
+  __m256i sum1 = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for ( ; i + 8 <= count ; i += 8) {
+    sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256(
+          reinterpret_cast<__m256i const *>(values + i)));
+    sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256(
+          reinterpret_cast<__m256i const *>(values + i + 4)));
+  }
+  return avx2_horizontal_sum(_mm256_add_epi64(sum0, sum1))
+    + scalar_sum(values + i, count - i);
+}
+
+
+// For count > 0
+template <typename opT, typename intT>
+__attribute__((target("avx2")))
+inline intT
+avx2_extreme(intT const * values, std::size_t count)
+{
+  std::size_t const LANES = avx2_lanes<intT>::COUNT;
+  if (count < LANES) {
+    return scalar_extreme<opT>(values, count);
+  }
+
+  __m256i result = _mm256_loadu_si256(
+      reinterpret_cast<__m256i const *>(values));
+  std::size_t i = LANES;
+  for ( ; i + LANES <= count ; i += LANES) {
+    result = avx2_lanes<intT>::template apply<opT>(result, _mm256_loadu_si256(
+          reinterpret_cast<__m256i const *>(values + i)));
+  }
+
+  intT lanes[avx2_lanes<intT>::COUNT];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), result);
+  intT extreme = scalar_extreme<opT>(lanes, LANES);
+  for ( ; i < count ; ++i) {
+    extreme = opT::apply(extreme, values[i]);
+  }
+  return extreme;
+}
+
+#endif // META_X86_SIMD
+
+
+template <typename intT>
+struct column_kernels
+{
+  typedef typename sum_type<intT>::type (*sum_func)(intT const *,
+      std::size_t);
+  typedef intT (*extreme_func)(intT const *, std::size_t);
+
+  inline static sum_func select_sum()
+  {
+    return &scalar_sum<intT>;
+  }
+
+  template <typename opT>
+  inline static extreme_func select_extreme()
+  {
+    return &scalar_extreme<opT, intT>;
+  }
+};
+
+#if defined(META_X86_SIMD)
+
+#define META_MATH_COLUMN_KERNELS(int_t, avx2_sum)               \
+  template <>                                                   \
+  struct column_kernels<int_t>                                  \
+  {                                                             \
+    typedef int64_t (*sum_func)(int_t const *, std::size_t);    \
+    typedef int_t (*extreme_func)(int_t const *, std::size_t);  \
+                                                                \
+    inline static sum_func select_sum()                         \
+    {                                                           \
+      __builtin_cpu_init();                                     \
+      if (__builtin_cpu_supports("avx2")) {                     \
+        return &avx2_sum;                                       \
+      }                                                         \
+      return &scalar_sum<int_t>;                                \
+    }                                                           \
+                                                                \
+    template <typename opT>                                     \
+    inline static extreme_func select_extreme()                 \
+    {                                                           \
+      __builtin_cpu_init();                                     \
+      if (__builtin_cpu_supports("avx2")) {                     \
+        return &avx2_extreme<opT, int_t>;                       \
+      }                                                         \
+      return &scalar_extreme<opT, int_t>;                       \
+    }                                                           \
+  };
+
+META_MATH_COLUMN_KERNELS(int32_t, avx2_sum_int32);
+META_MATH_COLUMN_KERNELS(int64_t, avx2_sum_int64);
+
+#undef META_MATH_COLUMN_KERNELS
+
+#endif // META_X86_SIMD
+
+
+template <typename intT>
+inline typename sum_type<intT>::type
+column_sum(intT const * values, std::size_t count)
+{
+  static typename column_kernels<intT>::sum_func const func
+    = column_kernels<intT>::select_sum();
+  return func(values, count);
+}
+
+// For count > 0
+template <typename opT, typename intT>
+inline intT
+column_extreme(intT const * values, std::size_t count)
+{
+  static typename column_kernels<intT>::extreme_func const func
+    = column_kernels<intT>::template select_extreme<opT>();
+  return func(values, count);
+}
+
+}}} // namespace meta::math::detail
+
+#endif // guard
@@ -0,0 +1,145 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_FLAT_MAP_GROUP_H
+#define META_DETAIL_FLAT_MAP_GROUP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD) && defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+namespace meta {
+namespace hash {
+namespace detail {
+
+/**
+ * Each slot of a flat_map has a control byte. Full slots store the lower
+ * seven bits of their key's hash, so the byte is never negative. Empty and
+ * deleted slots have the high bit set.
+ **/
+typedef signed char ctrl_t;
+
+static ctrl_t const CTRL_EMPTY = -128;
+static ctrl_t const CTRL_DELETED = -2;
+
+static std::size_t const GROUP_WIDTH = 16;
+
+inline unsigned int
+lowest_bit(uint32_t mask)
+{
+#if defined(__GNUC__)
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+#else
+  unsigned int bit = 0;
+  for ( ; !(mask & 1) ; mask >>= 1) {
+    ++bit;
+  }
+  return bit;
+#endif
+}
+
+
+/**
+ * A group of GROUP_WIDTH control bytes, which are matched against a value
+ * all at once. Each match returns a bit mask with one bit per slot. SSE2 is
+ * part of every x86-64 CPU, so there is no runtime dispatch here.
+ **/
+#if defined(META_X86_SIMD) && defined(__SSE2__)
+
+class group
+{
+public:
+  explicit inline group(ctrl_t const * ctrl)
+    : m_ctrl(_mm_loadu_si128(reinterpret_cast<__m128i const *>(ctrl)))
+  {
+  }
+
+  inline uint32_t match(ctrl_t value) const
+  {
+    return static_cast<uint32_t>(_mm_movemask_epi8(
+          _mm_cmpeq_epi8(_mm_set1_epi8(value), m_ctrl)));
+  }
+
+  inline uint32_t match_empty() const
+  {
+    return match(CTRL_EMPTY);
+  }
+
+  // Empty and deleted slots are the ones with the high bit set.
+  inline uint32_t match_free() const
+  {
+    return static_cast<uint32_t>(_mm_movemask_epi8(m_ctrl));
+  }
+
+private:
+  __m128i m_ctrl;
+};
+
+#else // META_X86_SIMD && __SSE2__
+
+class group
+{
+public:
+  explicit inline group(ctrl_t const * ctrl)
+    : m_ctrl(ctrl)
+  {
+  }
+
+  inline uint32_t match(ctrl_t value) const
+  {
+    uint32_t result = 0;
+    for (std::size_t i = 0 ; i < GROUP_WIDTH ; ++i) {
+      result |= uint32_t(m_ctrl[i] == value) << i;
+    }
+    return result;
+  }
+
+  inline uint32_t match_empty() const
+  {
+    return match(CTRL_EMPTY);
+  }
+
+  inline uint32_t match_free() const
+  {
+    uint32_t result = 0;
+    for (std::size_t i = 0 ; i < GROUP_WIDTH ; ++i) {
+      result |= uint32_t(m_ctrl[i] < 0) << i;
+    }
+    return result;
+  }
+
+private:
+  ctrl_t const *  m_ctrl;
+};
+
+#endif // META_X86_SIMD && __SSE2__
+
+}}} // namespace meta::hash::detail
+
+#endif // guard
@@ -0,0 +1,205 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_HASH_BATCH_H
+#define META_DETAIL_HASH_BATCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+// Included from meta/hash.h, after multi_hash() and hash_bytes().
+
+namespace meta {
+namespace hash {
+namespace detail {
+
+/**
+ * Keys are hashed in chunks: first, each key is reduced to a single word,
+ * then the words of the entire chunk run through multi_hash()'s fold and
+ * finalizer. The second step has no dependencies between keys, so the
+ * multiplies of several keys are in flight at once, or run in vector lanes.
+ **/
+static std::size_t const BATCH_CHUNK = 32;
+static std::size_t const BATCH_LANES = 4;
+
+typedef void (*finalize_batch_func)(std::size_t *, std::size_t);
+
+inline META_CONSTEXPR std::size_t
+finalize_one(std::size_t value)
+{
+  return size_mixer::mix((size_mixer::golden ^ value) * size_mixer::golden);
+}
+
+inline void
+scalar_finalize_batch(std::size_t * values, std::size_t count)
+{
+  std::size_t i = 0;
+  for ( ; i + BATCH_LANES <= count ; i += BATCH_LANES) {
+    std::size_t lane[BATCH_LANES];
+    for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+      lane[l] = (size_mixer::golden ^ values[i + l]) * size_mixer::golden;
+    }
+    for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+      values[i + l] = size_mixer::mix(lane[l]);
+    }
+  }
+  for ( ; i < count ; ++i) {
+    values[i] = finalize_one(values[i]);
+  }
+}
+
+
+#if defined(META_X86_SIMD)
+
+/**
+ * AVX2 has no 64 bit multiply; it's assembled from three 32x32->64 bit
+ * multiplies. Together with the shifts, four keys still finish in fewer
+ * instructions than with scalar code.
+ **/
+__attribute__((target("avx2")))
+inline __m256i
+avx2_mul64(__m256i value, uint64_t factor)
+{
+  __m256i const lo = _mm256_set1_epi64x(static_cast<long long>(
+        factor & 0xffffffffULL));
+  __m256i const hi = _mm256_set1_epi64x(static_cast<long long>(factor >> 32));
+  __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(value, 32), lo),
+      _mm256_mul_epu32(value, hi));
+  return _mm256_add_epi64(_mm256_mul_epu32(value, lo),
+      _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+inline __m256i
+avx2_xorshift(__m256i value, int shift)
+{
+  return _mm256_xor_si256(value, _mm256_srli_epi64(value, shift));
+}
+
+__attribute__((target("avx2")))
+inline void
+avx2_finalize_batch(std::size_t * values, std::size_t count)
+{
+  __m256i const golden = _mm256_set1_epi64x(static_cast<long long>(
+        mixer<8>::golden));
+
+  std::size_t i = 0;
+  for ( ; i + 4 <= count ; i += 4) {
+    __m256i * p = reinterpret_cast<__m256i *>(values + i);
+    __m256i v = _mm256_xor_si256(_mm256_loadu_si256(p), golden);
+    v = avx2_mul64(v, mixer<8>::golden);
+    v = avx2_mul64(avx2_xorshift(v, 30), 0xbf58476d1ce4e5b9ULL);
+    v = avx2_mul64(avx2_xorshift(v, 27), 0x94d049bb133111ebULL);
+    _mm256_storeu_si256(p, avx2_xorshift(v, 31));
+  }
+  for ( ; i < count ; ++i) {
+    values[i] = finalize_one(values[i]);
+  }
+}
+
+#endif // META_X86_SIMD
+
+
+inline finalize_batch_func
+select_finalize_batch()
+{
+#if defined(META_X86_SIMD)
+  if (sizeof(std::size_t) == 8) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return &avx2_finalize_batch;
+    }
+  }
+#endif
+  return &scalar_finalize_batch;
+}
+
+inline void
+finalize_batch(std::size_t * values, std::size_t count)
+{
+  static finalize_batch_func const func = select_finalize_batch();
+  func(values, count);
+}
+
+
+/**
+ * hash_bytes() for BATCH_LANES consecutive keys of the same size, up to
+ * SHORT_INPUT bytes. Since the sizes are identical, all lanes take the same
+ * path, and the multiplies of all lanes are interleaved.
+ **/
+inline void
+hash_short_lanes(unsigned char const * keys, std::size_t size,
+    uint64_t seed, uint64_t * out)
+{
+  seed ^= wymix(seed ^ WY_SECRET0, WY_SECRET1);
+
+  uint64_t a[BATCH_LANES];
+  uint64_t b[BATCH_LANES];
+  uint64_t s[BATCH_LANES];
+  for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+    s[l] = seed;
+  }
+
+  if (size <= 16) {
+    std::size_t offset = (size >> 3) << 2;
+    for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+      unsigned char const * p = keys + l * size;
+      if (size >= 4) {
+        a[l] = (load32(p) << 32) | load32(p + offset);
+        b[l] = (load32(p + size - 4) << 32) | load32(p + size - 4 - offset);
+      } else {
+        a[l] = size ? read_small(reinterpret_cast<char const *>(p), size) : 0;
+        b[l] = 0;
+      }
+    }
+  } else {
+    std::size_t pos = 0;
+    for ( ; size - pos > 16 ; pos += 16) {
+      for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+        unsigned char const * p = keys + l * size + pos;
+        s[l] = wymix(load64(p) ^ WY_SECRET1, load64(p + 8) ^ s[l]);
+      }
+    }
+    for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+      unsigned char const * p = keys + l * size + size;
+      a[l] = load64(p - 16);
+      b[l] = load64(p - 8);
+    }
+  }
+
+  for (std::size_t l = 0 ; l < BATCH_LANES ; ++l) {
+    out[l] = wy_finish(a[l], b[l], s[l], size);
+  }
+}
+
+}}} // namespace meta::hash::detail
+
+#endif // guard
@@ -0,0 +1,306 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_HASH_BYTES_H
+#define META_DETAIL_HASH_BYTES_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+#include <meta/byteorder.h>
+
+#include <cstddef>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+// Included from meta/hash.h, after the wyhash helpers this file builds on.
+
+namespace meta {
+namespace hash {
+namespace detail {
+
+/**
+ * hash_bytes() uses wyhash for inputs of up to SHORT_INPUT bytes, where
+ * latency matters most. Longer inputs are processed in an xxh3 style: 64 byte
+ * stripes are accumulated into eight 64 bit lanes, with a 32x32->64 bit
+ * multiply per lane, which maps directly onto vector instructions. After
+ * every STRIPES_PER_BLOCK stripes, the lanes are scrambled.
+ *
+ * The final stripe is the last STRIPE bytes of the input, which may overlap
+ * with the previous stripe; that way, no input needs padding.
+ **/
+static std::size_t const SHORT_INPUT = 128;
+static std::size_t const STRIPE = 64;
+static std::size_t const LANES = STRIPE / 8;
+static std::size_t const STRIPES_PER_BLOCK = 16;
+
+/**
+ * Key material, generated by splitmix64 seeded with the first digits of pi.
+ * Stripe n of each block uses words n to n + 7; the other offsets are for
+ * scrambling, the final stripe and merging the lanes.
+ **/
+static std::size_t const SECRET_WORDS = 32;
+static std::size_t const SCRAMBLE_OFFSET = 24;
+static std::size_t const LAST_STRIPE_OFFSET = 21;
+static std::size_t const MERGE_OFFSET = 11;
+
+static uint64_t const BASE_SECRET[SECRET_WORDS] = {
+  0x2cb0f69f4abea221ULL, 0x9417034723148989ULL,
+  0xdd555950609dfe03ULL, 0xdbafb150deb12800ULL,
+  0x7e789b2e6c442cb6ULL, 0xf41e5636c7e4f8c4ULL,
+  0x0959d150f8fba7e4ULL, 0xa97316f13cdb9eeaULL,
+  0x74cd8258f9520068ULL, 0x55c74a62e116868bULL,
+  0xd2f4c799a2023cbdULL, 0xdf98cb79a37b51b9ULL,
+  0x396f5885524f3905ULL, 0xaf1d56386ca3b276ULL,
+  0xa9ffbe6b5104e85aULL, 0x6bd0c51b9fd533b3ULL,
+  0x980ce91c50ab4b56ULL, 0x28ac395780fe62c5ULL,
+  0x768912e3a6bcedc7ULL, 0x50b3e8c9332c7c88ULL,
+  0xce3bbfe520bd47daULL, 0xcba6c8e8e0bb7c4fULL,
+  0xbf194db8434a346dULL, 0x7d8f2a7b60416d7fULL,
+  0x0849d1f6e0e10a5eULL, 0x7654b590d064e22fULL,
+  0x16d1da9507df3af2ULL, 0xf63aef1089ea30e4ULL,
+  0x9ade6673cc6c522bULL, 0x4c75bc274e37087cULL,
+  0xd35e12b49f51f27bULL, 0x22ddf2ffcee481eaULL,
+};
+
+static uint64_t const PRIME32_1 = 0x9e3779b1ULL;
+static uint64_t const PRIME64_1 = 0x9e3779b185ebca87ULL;
+
+inline void
+make_secret(uint64_t (& secret)[SECRET_WORDS], uint64_t seed)
+{
+  for (std::size_t i = 0 ; i < SECRET_WORDS ; i += 2) {
+    secret[i] = BASE_SECRET[i] + seed;
+    secret[i + 1] = BASE_SECRET[i + 1] - seed;
+  }
+}
+
+inline void
+init_lanes(uint64_t (& acc)[LANES])
+{
+  acc[0] = 0xc2b2ae3dULL;
+  acc[1] = 0x9e3779b185ebca87ULL;
+  acc[2] = 0xc2b2ae3d27d4eb4fULL;
+  acc[3] = 0x165667b19e3779f9ULL;
+  acc[4] = 0x85ebca77c2b2ae63ULL;
+  acc[5] = 0x85ebca77ULL;
+  acc[6] = 0x27d4eb2f165667c5ULL;
+  acc[7] = 0x9e3779b1ULL;
+}
+
+
+/**
+ * Short inputs; these produce the same results as the constexpr wyhash().
+ **/
+inline uint64_t
+load64(unsigned char const * p)
+{
+  return byte_order::load_le<uint64_t>(p);
+}
+
+inline uint64_t
+load32(unsigned char const * p)
+{
+  return byte_order::load_le<uint32_t>(p);
+}
+
+inline uint64_t
+hash_short(unsigned char const * p, std::size_t size, uint64_t seed)
+{
+  seed ^= wymix(seed ^ WY_SECRET0, WY_SECRET1);
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (size <= 16) {
+    if (size >= 4) {
+      std::size_t offset = (size >> 3) << 2;
+      a = (load32(p) << 32) | load32(p + offset);
+      b = (load32(p + size - 4) << 32) | load32(p + size - 4 - offset);
+    } else if (size > 0) {
+      a = read_small(reinterpret_cast<char const *>(p), size);
+    }
+  } else {
+    std::size_t remaining = size;
+    while (remaining > 16) {
+      seed = wymix(load64(p) ^ WY_SECRET1, load64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    a = load64(p + remaining - 16);
+    b = load64(p + remaining - 8);
+  }
+
+  return wy_finish(a, b, seed, size);
+}
+
+
+/**
+ * Portable versions of the long input kernels.
+ **/
+inline void
+accumulate_stripe(uint64_t * acc, unsigned char const * p,
+    uint64_t const * key)
+{
+  for (std::size_t i = 0 ; i < LANES ; ++i) {
+    uint64_t value = load64(p + 8 * i);
+    uint64_t keyed = value ^ key[i];
+    acc[i ^ 1] += value;
+    acc[i] += (keyed & 0xffffffffULL) * (keyed >> 32);
+  }
+}
+
+inline void
+scramble(uint64_t * acc, uint64_t const * key)
+{
+  for (std::size_t i = 0 ; i < LANES ; ++i) {
+    acc[i] = (acc[i] ^ (acc[i] >> 47) ^ key[i]) * PRIME32_1;
+  }
+}
+
+
+/**
+ * Accumulate count stripes, the first of which is stripe number first of the
+ * input. Kernels have to produce identical results.
+ **/
+typedef void (*accumulate_func)(uint64_t *, unsigned char const *,
+    std::size_t, std::size_t, uint64_t const *);
+
+inline void
+scalar_accumulate(uint64_t * acc, unsigned char const * p, std::size_t count,
+    std::size_t first, uint64_t const * secret)
+{
+  for (std::size_t i = 0 ; i < count ; ++i, p += STRIPE) {
+    std::size_t n = (first + i) % STRIPES_PER_BLOCK;
+    accumulate_stripe(acc, p, secret + n);
+    if (n == STRIPES_PER_BLOCK - 1) {
+      scramble(acc, secret + SCRAMBLE_OFFSET);
+    }
+  }
+}
+
+
+#if defined(META_X86_SIMD)
+
+/**
+ * The AVX2 kernel keeps all lanes in two registers. Swapping adjacent lanes
+ * and splitting 64 bit values into 32 bit halves are both done with shuffles.
+ * The kernel relies on little endian loads, which is a given on x86.
+ **/
+__attribute__((target("avx2")))
+inline void
+avx2_accumulate(uint64_t * acc, unsigned char const * p, std::size_t count,
+    std::size_t first, uint64_t const * secret)
+{
+  __m256i * acc_vec = reinterpret_cast<__m256i *>(acc);
+  __m256i acc0 = _mm256_loadu_si256(acc_vec);
+  __m256i acc1 = _mm256_loadu_si256(acc_vec + 1);
+  __m256i const prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+
+  for (std::size_t i = 0 ; i < count ; ++i, p += STRIPE) {
+    std::size_t n = (first + i) % STRIPES_PER_BLOCK;
+    __m256i const * data = reinterpret_cast<__m256i const *>(p);
+    __m256i const * key = reinterpret_cast<__m256i const *>(secret + n);
+
+    __m256i d0 = _mm256_loadu_si256(data);
+    __m256i d1 = _mm256_loadu_si256(data + 1);
+    __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(key));
+    __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(key + 1));
+
+    // (keyed & 0xffffffff) * (keyed >> 32)
+    __m256i p0 = _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, 0x31));
+    __m256i p1 = _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, 0x31));
+
+    // acc[i ^ 1] += value
+    acc0 = _mm256_add_epi64(acc0, _mm256_shuffle_epi32(d0, 0x4e));
+    acc1 = _mm256_add_epi64(acc1, _mm256_shuffle_epi32(d1, 0x4e));
+    acc0 = _mm256_add_epi64(acc0, p0);
+    acc1 = _mm256_add_epi64(acc1, p1);
+
+    if (n == STRIPES_PER_BLOCK - 1) {
+      __m256i const * skey = reinterpret_cast<__m256i const *>(
+          secret + SCRAMBLE_OFFSET);
+      __m256i s0 = _mm256_xor_si256(acc0, _mm256_srli_epi64(acc0, 47));
+      __m256i s1 = _mm256_xor_si256(acc1, _mm256_srli_epi64(acc1, 47));
+      s0 = _mm256_xor_si256(s0, _mm256_loadu_si256(skey));
+      s1 = _mm256_xor_si256(s1, _mm256_loadu_si256(skey + 1));
+
+      // 64 bit multiply by a 32 bit constant, from two 32x32->64 multiplies.
+      __m256i lo0 = _mm256_mul_epu32(s0, prime);
+      __m256i lo1 = _mm256_mul_epu32(s1, prime);
+      __m256i hi0 = _mm256_mul_epu32(_mm256_srli_epi64(s0, 32), prime);
+      __m256i hi1 = _mm256_mul_epu32(_mm256_srli_epi64(s1, 32), prime);
+      acc0 = _mm256_add_epi64(lo0, _mm256_slli_epi64(hi0, 32));
+      acc1 = _mm256_add_epi64(lo1, _mm256_slli_epi64(hi1, 32));
+    }
+  }
+
+  _mm256_storeu_si256(acc_vec, acc0);
+  _mm256_storeu_si256(acc_vec + 1, acc1);
+}
+
+#endif // META_X86_SIMD
+
+
+inline accumulate_func
+select_accumulate()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_accumulate;
+  }
+#endif
+  return &scalar_accumulate;
+}
+
+inline void
+accumulate(uint64_t * acc, unsigned char const * p, std::size_t count,
+    std::size_t first, uint64_t const * secret)
+{
+  static accumulate_func const func = select_accumulate();
+  func(acc, p, count, first, secret);
+}
+
+
+/**
+ * Fold the lanes into the result, after accumulating the final stripe.
+ **/
+inline uint64_t
+finish_long(uint64_t * acc, unsigned char const * last_stripe,
+    uint64_t const * secret, uint64_t size)
+{
+  accumulate_stripe(acc, last_stripe, secret + LAST_STRIPE_OFFSET);
+
+  uint64_t result = size * PRIME64_1;
+  for (std::size_t i = 0 ; i < LANES ; i += 2) {
+    result += wymix(acc[i] ^ secret[MERGE_OFFSET + i],
+        acc[i + 1] ^ secret[MERGE_OFFSET + i + 1]);
+  }
+  return mixer<8>::mix(result);
+}
+
+}}} // namespace meta::hash::detail
+
+#endif // guard
@@ -0,0 +1,223 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_DETAIL_RENDEZVOUS_H
+#define META_DETAIL_RENDEZVOUS_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+// Included from meta/hash.h
+
+namespace meta {
+namespace hash {
+namespace detail {
+
+/**
+ * Weighted rendezvous hashing picks the node with the lowest score
+ * -log(u) / weight, where u is uniform in (0, 1) and derived from the key and
+ * the node. All hosts must pick the same node for a key, whichever kernel
+ * they run, so the score is computed from integers up to a single float
+ * multiply, which rounds the same everywhere.
+ *
+ * Nodes are processed in groups of RENDEZVOUS_LANES; the node arrays are
+ * padded to a multiple of that with an inverse weight of infinity, so that
+ * padding never wins.
+ **/
+static std::size_t const RENDEZVOUS_LANES = 8;
+
+static uint32_t const RENDEZVOUS_GOLDEN = 0x9e3779b1UL;
+static uint32_t const RENDEZVOUS_MIX1 = 0x85ebca6bUL;
+static uint32_t const RENDEZVOUS_MIX2 = 0xc2b2ae35UL;
+
+// log2(1 + f) ~ f * (C1 - f * (C2 - f * C3)) for f in [0, 1), in Q15; the
+// absolute error is below 0.001.
+static uint32_t const RENDEZVOUS_C1 = 46624;
+static uint32_t const RENDEZVOUS_C2 = 19072;
+static uint32_t const RENDEZVOUS_C3 = 5216;
+
+inline uint32_t
+rendezvous_mix(uint32_t seed, uint32_t key_low, uint32_t key_high)
+{
+  uint32_t h = ((seed ^ key_low) * RENDEZVOUS_GOLDEN) ^ key_high;
+  h ^= h >> 16;
+  h *= RENDEZVOUS_MIX1;
+  h ^= h >> 13;
+  h *= RENDEZVOUS_MIX2;
+  h ^= h >> 16;
+  return h;
+}
+
+/**
+ * -log2(x / 2^31) in Q16, at least 1, for x in [1, 2^31). The exponent and
+ * mantissa of x are taken from its float representation.
+ **/
+inline uint32_t
+rendezvous_neg_log2(uint32_t x)
+{
+  float value = static_cast<float>(static_cast<int32_t>(x));
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t exponent = (bits >> 23) - 127;
+  uint32_t f = (bits >> 8) & 0x7fff;
+  uint32_t p = RENDEZVOUS_C2 - ((RENDEZVOUS_C3 * f) >> 15);
+  p = RENDEZVOUS_C1 - ((p * f) >> 15);
+  p = (p * f) >> 14;
+
+  uint32_t result = ((31 - exponent) << 16) - p;
+  return result ? result : 1;
+}
+
+inline float
+rendezvous_score(uint32_t seed, float inverse_weight, uint64_t key)
+{
+  uint32_t h = rendezvous_mix(seed, static_cast<uint32_t>(key),
+      static_cast<uint32_t>(key >> 32));
+  return static_cast<float>(rendezvous_neg_log2((h >> 1) | 1))
+    * inverse_weight;
+}
+
+
+typedef std::size_t (*rendezvous_func)(uint32_t const *, float const *,
+    std::size_t, uint64_t);
+
+inline std::size_t
+scalar_rendezvous(uint32_t const * seeds, float const * inverse_weights,
+    std::size_t count, uint64_t key)
+{
+  std::size_t best = 0;
+  float best_score = std::numeric_limits<float>::infinity();
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    float score = rendezvous_score(seeds[i], inverse_weights[i], key);
+    if (score < best_score) {
+      best_score = score;
+      best = i;
+    }
+  }
+  return best;
+}
+
+
+#if defined(META_X86_SIMD)
+
+__attribute__((target("avx2")))
+inline std::size_t
+avx2_rendezvous(uint32_t const * seeds, float const * inverse_weights,
+    std::size_t count, uint64_t key)
+{
+  __m256i const key_low = _mm256_set1_epi32(static_cast<int>(key));
+  __m256i const key_high = _mm256_set1_epi32(static_cast<int>(key >> 32));
+  __m256i const one = _mm256_set1_epi32(1);
+  __m256i const mantissa = _mm256_set1_epi32(0x7fff);
+
+  __m256 best_score = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+  __m256i best = _mm256_setzero_si256();
+  __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  for (std::size_t i = 0 ; i < count ; i += RENDEZVOUS_LANES) {
+    __m256i h = _mm256_xor_si256(_mm256_loadu_si256(
+          reinterpret_cast<__m256i const *>(seeds + i)), key_low);
+    h = _mm256_xor_si256(_mm256_mullo_epi32(h,
+          _mm256_set1_epi32(static_cast<int>(RENDEZVOUS_GOLDEN))), key_high);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h,
+        _mm256_set1_epi32(static_cast<int>(RENDEZVOUS_MIX1)));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h,
+        _mm256_set1_epi32(static_cast<int>(RENDEZVOUS_MIX2)));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+    __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(
+          _mm256_or_si256(_mm256_srli_epi32(h, 1), one)));
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+        _mm256_set1_epi32(127));
+    __m256i f = _mm256_and_si256(_mm256_srli_epi32(bits, 8), mantissa);
+    __m256i p = _mm256_sub_epi32(_mm256_set1_epi32(RENDEZVOUS_C2),
+        _mm256_srli_epi32(_mm256_mullo_epi32(
+            _mm256_set1_epi32(RENDEZVOUS_C3), f), 15));
+    p = _mm256_sub_epi32(_mm256_set1_epi32(RENDEZVOUS_C1),
+        _mm256_srli_epi32(_mm256_mullo_epi32(p, f), 15));
+    p = _mm256_srli_epi32(_mm256_mullo_epi32(p, f), 14);
+    __m256i log = _mm256_max_epi32(_mm256_sub_epi32(_mm256_slli_epi32(
+            _mm256_sub_epi32(_mm256_set1_epi32(31), exponent), 16), p), one);
+
+    __m256 score = _mm256_mul_ps(_mm256_cvtepi32_ps(log),
+        _mm256_loadu_ps(inverse_weights + i));
+    __m256 less = _mm256_cmp_ps(score, best_score, _CMP_LT_OQ);
+    best_score = _mm256_blendv_ps(best_score, score, less);
+    best = _mm256_blendv_epi8(best, index, _mm256_castps_si256(less));
+    index = _mm256_add_epi32(index, _mm256_set1_epi32(RENDEZVOUS_LANES));
+  }
+
+  // Each lane holds its first lowest score; of those, pick the first.
+  float scores[RENDEZVOUS_LANES];
+  uint32_t indices[RENDEZVOUS_LANES];
+  _mm256_storeu_ps(scores, best_score);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(indices), best);
+  std::size_t lane = 0;
+  for (std::size_t l = 1 ; l < RENDEZVOUS_LANES ; ++l) {
+    if (scores[l] < scores[lane]
+        || (scores[l] == scores[lane] && indices[l] < indices[lane]))
+    {
+      lane = l;
+    }
+  }
+  return indices[lane];
+}
+
+#endif // META_X86_SIMD
+
+
+inline rendezvous_func
+select_rendezvous()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_rendezvous;
+  }
+#endif
+  return &scalar_rendezvous;
+}
+
+inline std::size_t
+rendezvous(uint32_t const * seeds, float const * inverse_weights,
+    std::size_t count, uint64_t key)
+{
+  static rendezvous_func const func = select_rendezvous();
+  return func(seeds, inverse_weights, count, key);
+}
+
+}}} // namespace meta::hash::detail
+
+#endif // guard
@@ -0,0 +1,280 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_ENDIAN_ARRAY_H
+#define META_ENDIAN_ARRAY_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#include <stdexcept>
+#include <iterator>
+#include <cstddef>
+#include <cstring>
+
+#include <meta/byteorder.h>
+
+namespace meta {
+namespace byte_order {
+
+/**
+ * A read-only view of count integers of type intT stored in ENDIAN byte order,
+ * e.g. in a file or network buffer. The data is not converted up front;
+ * instead, each element is converted to host byte order as it is accessed,
+ * and copy() converts whole ranges with the bulk functions.
+ *
+ * The data needs no particular alignment.
+ *
+ *    endian_array<uint32_t, META_BIG_ENDIAN> ids(buffer, count);
+ *    uint32_t first = ids[0];
+ *
+ *    std::vector<uint32_t> chunk(1024);
+ *    ids.copy(&chunk[0], 4096, chunk.size());
+ **/
+template <typename intT, int ENDIAN>
+class endian_array
+{
+public:
+  typedef intT        value_type;
+  typedef std::size_t size_type;
+
+  /**
+   * Random access iterator; dereferencing yields a converted copy of the
+   * element, so there is no way to modify the underlying data.
+   **/
+  class const_iterator
+  {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef intT                            value_type;
+    typedef std::ptrdiff_t                  difference_type;
+    typedef intT const *                    pointer;
+    typedef intT                            reference;
+
+    inline const_iterator()
+      : m_data(0)
+    {
+    }
+
+    inline explicit const_iterator(char const * data)
+      : m_data(data)
+    {
+    }
+
+    inline intT operator*() const
+    {
+      return load<ENDIAN, intT>(m_data);
+    }
+
+    inline intT operator[](difference_type n) const
+    {
+      return *(*this + n);
+    }
+
+    inline const_iterator & operator++()
+    {
+      m_data += sizeof(intT);
+      return *this;
+    }
+
+    inline const_iterator operator++(int)
+    {
+      const_iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    inline const_iterator & operator--()
+    {
+      m_data -= sizeof(intT);
+      return *this;
+    }
+
+    inline const_iterator operator--(int)
+    {
+      const_iterator tmp = *this;
+      --*this;
+      return tmp;
+    }
+
+    inline const_iterator & operator+=(difference_type n)
+    {
+      m_data += n * static_cast<difference_type>(sizeof(intT));
+      return *this;
+    }
+
+    inline const_iterator & operator-=(difference_type n)
+    {
+      m_data -= n * static_cast<difference_type>(sizeof(intT));
+      return *this;
+    }
+
+    inline const_iterator operator+(difference_type n) const
+    {
+      const_iterator tmp = *this;
+      return tmp += n;
+    }
+
+    inline const_iterator operator-(difference_type n) const
+    {
+      const_iterator tmp = *this;
+      return tmp -= n;
+    }
+
+    inline difference_type operator-(const_iterator const & other) const
+    {
+      return (m_data - other.m_data) / static_cast<difference_type>(sizeof(intT));
+    }
+
+    inline bool operator==(const_iterator const & other) const
+    {
+      return m_data == other.m_data;
+    }
+
+    inline bool operator!=(const_iterator const & other) const
+    {
+      return m_data != other.m_data;
+    }
+
+    inline bool operator<(const_iterator const & other) const
+    {
+      return m_data < other.m_data;
+    }
+
+    inline bool operator>(const_iterator const & other) const
+    {
+      return m_data > other.m_data;
+    }
+
+    inline bool operator<=(const_iterator const & other) const
+    {
+      return m_data <= other.m_data;
+    }
+
+    inline bool operator>=(const_iterator const & other) const
+    {
+      return m_data >= other.m_data;
+    }
+
+  private:
+    char const *  m_data;
+  };
+
+  typedef const_iterator iterator;
+
+
+  inline endian_array()
+    : m_data(0)
+    , m_size(0)
+  {
+  }
+
+  inline endian_array(void const * data, size_type count)
+    : m_data(static_cast<char const *>(data))
+    , m_size(count)
+  {
+  }
+
+  inline size_type size() const
+  {
+    return m_size;
+  }
+
+  inline bool empty() const
+  {
+    return !m_size;
+  }
+
+  /**
+   * Raw, unconverted data.
+   **/
+  inline void const * data() const
+  {
+    return m_data;
+  }
+
+  /**
+   * Element access converts to host byte order; at() also checks bounds.
+   **/
+  inline intT operator[](size_type index) const
+  {
+    return load<ENDIAN, intT>(m_data + index * sizeof(intT));
+  }
+
+  inline intT at(size_type index) const
+  {
+    if (index >= m_size) {
+      throw std::out_of_range("Index exceeds the size of the endian_array.");
+    }
+    return (*this)[index];
+  }
+
+  inline const_iterator begin() const
+  {
+    return const_iterator(m_data);
+  }
+
+  inline const_iterator end() const
+  {
+    return const_iterator(m_data + m_size * sizeof(intT));
+  }
+
+  /**
+   * Copy count elements starting at first to dest, converting them to host
+   * byte order. This uses the same kernels as to_host_n(), so it's much
+   * faster than converting element by element for all but the smallest
+   * ranges.
+   **/
+  inline void copy(intT * dest, size_type first, size_type count) const
+  {
+    if (first > m_size || count > m_size - first) {
+      throw std::out_of_range("Range exceeds the size of the endian_array.");
+    }
+    char const * src = m_data + first * sizeof(intT);
+    if (ENDIAN != META_BYTE_ORDER) {
+      detail::bulk_swap<sizeof(intT)>(reinterpret_cast<char *>(dest), src,
+          count);
+    } else {
+      std::memcpy(dest, src, count * sizeof(intT));
+    }
+  }
+
+  /**
+   * A view of count elements starting at first.
+   **/
+  inline endian_array subarray(size_type first, size_type count) const
+  {
+    if (first > m_size || count > m_size - first) {
+      throw std::out_of_range("Range exceeds the size of the endian_array.");
+    }
+    return endian_array(m_data + first * sizeof(intT), count);
+  }
+
+private:
+  char const *  m_data;
+  size_type     m_size;
+};
+
+}} // namespace meta::byte_order
+
+#endif // guard
@@ -0,0 +1,377 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_FIXED_H
+#define META_FIXED_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+#include <meta/inttypes.h>
+#include <meta/math.h>
+
+#include <cstddef>
+#include <stdexcept>
+
+#include <meta/detail/fixed.h>
+
+namespace meta {
+namespace math {
+
+/**
+ * Rounding policies for fixed point multiplication and rescaling. Each
+ * decides from the magnitude of the truncated quotient, the remainder and
+ * the divisor whether to increase the magnitude by one.
+ **/
+struct round_toward_zero
+{
+  inline static bool increment(uint64_t, uint64_t, uint64_t, bool)
+  {
+    return false;
+  }
+};
+
+// Towards negative infinity
+struct round_down
+{
+  inline static bool increment(uint64_t, uint64_t remainder, uint64_t,
+      bool negative)
+  {
+    return negative && remainder;
+  }
+};
+
+// Towards positive infinity
+struct round_up
+{
+  inline static bool increment(uint64_t, uint64_t remainder, uint64_t,
+      bool negative)
+  {
+    return !negative && remainder;
+  }
+};
+
+struct round_half_away_from_zero
+{
+  inline static bool increment(uint64_t, uint64_t remainder,
+      uint64_t divisor, bool)
+  {
+    return remainder >= divisor - remainder;
+  }
+};
+
+// Ties to the even neighbour, also known as banker's rounding.
+struct round_half_even
+{
+  inline static bool increment(uint64_t quotient, uint64_t remainder,
+      uint64_t divisor, bool)
+  {
+    return remainder > divisor - remainder
+      || (remainder == divisor - remainder && (quotient & 1));
+  }
+};
+
+
+namespace detail {
+
+// (hi * 2^64 + lo) / D, where D is a constant, so the common case of a
+// 64 bit dividend compiles to a multiplication.
+template <uint64_t D>
+inline uint64_t
+constant_wide_div(uint64_t hi, uint64_t lo, uint64_t & remainder)
+{
+  if (!hi) {
+    remainder = lo % D;
+    return lo / D;
+  }
+  return wide_div(hi, lo, D, remainder);
+}
+
+/**
+ * The magnitude of a * b * N / D, rounded according to roundingT; negative
+ * is the sign of the result. a * b * N / D must fit 64 bits, and a * b must
+ * fit 64 bits unless WIDE is set.
+ **/
+template <uint64_t N, uint64_t D, typename roundingT, bool WIDE>
+inline uint64_t
+mul_div_rounded(uint64_t a, uint64_t b, bool negative)
+{
+  uint64_t hi = 0;
+  uint64_t lo = a * b;
+  if (WIDE) {
+    wide_mul(a, b, hi, lo);
+  }
+  uint64_t remainder;
+  uint64_t quotient = constant_wide_div<D>(hi, lo, remainder);
+  if (N != 1) {
+    // (q * D + r) * N / D = q * N + r * N / D
+    wide_mul(remainder, N, hi, lo);
+    quotient = quotient * N + constant_wide_div<D>(hi, lo, remainder);
+  }
+  return quotient + roundingT::increment(quotient, remainder, D, negative);
+}
+
+
+template <typename intT>
+inline uint64_t
+magnitude(intT value)
+{
+  typedef typename unsigned_type<intT>::type unsigned_t;
+  unsigned_t u = static_cast<unsigned_t>(value);
+  return sign<intT>::negative(value) ? uint64_t(unsigned_t(unsigned_t(0) - u))
+    : uint64_t(u);
+}
+
+template <typename intT>
+inline intT
+apply_sign(uint64_t magnitude, bool negative)
+{
+  typedef typename unsigned_type<intT>::type unsigned_t;
+  unsigned_t u = static_cast<unsigned_t>(magnitude);
+  return static_cast<intT>(negative ? unsigned_t(unsigned_t(0) - u) : u);
+}
+
+
+// A raw value in fromT units as a raw value of type resultT in toT units.
+template <typename fromT, typename toT, typename roundingT, typename resultT,
+         typename intT>
+inline resultT
+rescale(intT raw)
+{
+  typedef conversion_factor<fromT, toT> factor;
+  bool negative = sign<intT>::negative(raw);
+  return apply_sign<resultT>(mul_div_rounded<factor::DIVIDEND,
+      factor::DIVISOR, roundingT, false>(magnitude(raw), 1, negative),
+      negative);
+}
+
+} // namespace detail
+
+
+/**
+ * A fixed point number: an integer count of units of scaleT, a ratio. E.g.
+ * prices with four decimal places:
+ *
+ *    typedef fixed<int64_t, ratio<int64_t, 1, 10000> > price;
+ *    price p = price::from_raw(12345);     // 1.2345
+ *    price total = p * price(3);           // 3.7035
+ *
+ * Addition, subtraction and comparison are exact, and as cheap as on the
+ * integers. Multiplication computes the exact product in 128 bits and rounds
+ * it once, by the roundingT policy; multiply() takes another policy per
+ * call. Values are converted between scales by an explicit constructor,
+ * which rounds the same way; the conversion factor is cancelled down at
+ * compile time, so that converting e.g. cents into the above prices is a
+ * single multiplication. The raw type may change in the conversion, too.
+ *
+ * As with the built-in integers, results that do not fit intT overflow.
+ * Scales must be positive, and intT any of the (u)intN_t types.
+ **/
+template <
+  typename intT,
+  typename scaleT,
+  typename roundingT = round_half_away_from_zero
+>
+class fixed
+{
+public:
+  typedef intT      value_type;
+  typedef scaleT    scale_type;
+  typedef roundingT rounding_type;
+
+  inline fixed()
+    : m_raw(0)
+  {
+  }
+
+  // Whole units, e.g. 3 for 3.0000
+  explicit inline fixed(intT units)
+    : m_raw(detail::rescale<ratio<uint64_t, 1>, scaleT, roundingT, intT>(
+          units))
+  {
+  }
+
+  template <typename otherIntT, typename otherScaleT, typename otherRoundingT>
+  explicit inline fixed(
+      fixed<otherIntT, otherScaleT, otherRoundingT> const & other)
+    : m_raw(detail::rescale<otherScaleT, scaleT, roundingT, intT>(
+          other.raw()))
+  {
+  }
+
+  inline static fixed from_raw(intT raw)
+  {
+    fixed result;
+    result.m_raw = raw;
+    return result;
+  }
+
+  // The number of scaleT units.
+  inline intT raw() const
+  {
+    return m_raw;
+  }
+
+  // For display; the result is subject to floating point rounding.
+  inline double to_double() const
+  {
+    return double(m_raw) * double(scaleT::DIVIDEND) / double(scaleT::DIVISOR);
+  }
+
+  inline fixed & operator+=(fixed const & other)
+  {
+    m_raw += other.m_raw;
+    return *this;
+  }
+
+  inline fixed & operator-=(fixed const & other)
+  {
+    m_raw -= other.m_raw;
+    return *this;
+  }
+
+  // Multiplication by an integer is exact.
+  inline fixed & operator*=(intT factor)
+  {
+    m_raw *= factor;
+    return *this;
+  }
+
+  inline fixed & operator*=(fixed const & other)
+  {
+    *this = multiply<roundingT>(other);
+    return *this;
+  }
+
+  template <typename otherRoundingT>
+  inline fixed multiply(fixed const & other) const
+  {
+    typedef detail::conversion_factor<scaleT, ratio<uint64_t, 1> > factor;
+    bool negative = detail::sign<intT>::negative(m_raw)
+      != detail::sign<intT>::negative(other.m_raw);
+    return from_raw(detail::apply_sign<intT>(
+          detail::mul_div_rounded<factor::DIVIDEND, factor::DIVISOR,
+            otherRoundingT, (sizeof(intT) > sizeof(uint32_t))>(
+              detail::magnitude(m_raw), detail::magnitude(other.m_raw),
+              negative), negative));
+  }
+
+  inline fixed operator-() const
+  {
+    return from_raw(intT(-m_raw));
+  }
+
+  inline fixed operator+(fixed const & other) const
+  {
+    return from_raw(intT(m_raw + other.m_raw));
+  }
+
+  inline fixed operator-(fixed const & other) const
+  {
+    return from_raw(intT(m_raw - other.m_raw));
+  }
+
+  inline fixed operator*(fixed const & other) const
+  {
+    return multiply<roundingT>(other);
+  }
+
+  inline fixed operator*(intT factor) const
+  {
+    return from_raw(intT(m_raw * factor));
+  }
+
+  inline bool operator==(fixed const & other) const
+  {
+    return m_raw == other.m_raw;
+  }
+
+  inline bool operator!=(fixed const & other) const
+  {
+    return m_raw != other.m_raw;
+  }
+
+  inline bool operator<(fixed const & other) const
+  {
+    return m_raw < other.m_raw;
+  }
+
+  inline bool operator<=(fixed const & other) const
+  {
+    return m_raw <= other.m_raw;
+  }
+
+  inline bool operator>(fixed const & other) const
+  {
+    return m_raw > other.m_raw;
+  }
+
+  inline bool operator>=(fixed const & other) const
+  {
+    return m_raw >= other.m_raw;
+  }
+
+private:
+  intT  m_raw;
+};
+
+
+/**
+ * Aggregates of columns of fixed point values, using AVX2 where available.
+ * Values narrower than 64 bits are summed in 64 bits, so only the sum itself
+ * can overflow. minimum() and maximum() throw for empty columns.
+ **/
+template <typename intT, typename scaleT, typename roundingT>
+inline fixed<intT, scaleT, roundingT>
+sum(fixed<intT, scaleT, roundingT> const * values, std::size_t count)
+{
+  return fixed<intT, scaleT, roundingT>::from_raw(static_cast<intT>(
+        detail::column_sum(reinterpret_cast<intT const *>(values), count)));
+}
+
+template <typename intT, typename scaleT, typename roundingT>
+inline fixed<intT, scaleT, roundingT>
+minimum(fixed<intT, scaleT, roundingT> const * values, std::size_t count)
+{
+  if (!count) {
+    throw std::invalid_argument("The minimum of no values is undefined.");
+  }
+  return fixed<intT, scaleT, roundingT>::from_raw(
+      detail::column_extreme<detail::minimum_op>(
+        reinterpret_cast<intT const *>(values), count));
+}
+
+template <typename intT, typename scaleT, typename roundingT>
+inline fixed<intT, scaleT, roundingT>
+maximum(fixed<intT, scaleT, roundingT> const * values, std::size_t count)
+{
+  if (!count) {
+    throw std::invalid_argument("The maximum of no values is undefined.");
+  }
+  return fixed<intT, scaleT, roundingT>::from_raw(
+      detail::column_extreme<detail::maximum_op>(
+        reinterpret_cast<intT const *>(values), count));
+}
+
+}} // namespace meta::math
+
+#endif // guard
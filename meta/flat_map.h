@@ -0,0 +1,813 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_FLAT_MAP_H
+#define META_FLAT_MAP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/flat_map.h because there's no C++11 support.
+#endif
+
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <cstring>
+
+#include <meta/hash.h>
+#include <meta/detail/flat_map_group.h>
+
+namespace meta {
+namespace hash {
+
+/**
+ * The default hash and equality functions of flat_map. Both accept any types,
+ * which allows looking up keys without first converting them to the key type.
+ *
+ * Strings hash by their contents with key_hash(), whether given as
+ * std::string or as C strings, so that either can be used to look up the
+ * other. Values wrapped in hashed<> use their stored hash, which is the same
+ * as that of the value itself, and all other types hash with multi_hash().
+ **/
+struct transparent_hash
+{
+  typedef void is_transparent;
+
+  template <typename T>
+  inline std::size_t operator()(T const & value) const
+  {
+    return detail::value_hash(value);
+  }
+
+  inline std::size_t operator()(char const * value) const
+  {
+    return static_cast<std::size_t>(key_hash(value, std::strlen(value)));
+  }
+
+  template <typename T>
+  inline std::size_t operator()(hashed<T> const & value) const
+  {
+    return value.hash();
+  }
+};
+
+struct transparent_equal
+{
+  typedef void is_transparent;
+
+  template <typename T1, typename T2>
+  inline bool operator()(T1 const & first, T2 const & second) const
+  {
+    return first == second;
+  }
+};
+
+
+namespace detail {
+
+template <typename T, typename = void>
+struct is_transparent
+  : public std::false_type
+{
+};
+
+template <typename T>
+struct is_transparent<T,
+    typename std::conditional<true, void, typename T::is_transparent>::type>
+  : public std::true_type
+{
+};
+
+} // namespace detail
+
+
+/**
+ * An open addressing hash map, in the style of Abseil's "Swiss tables".
+ *
+ * Entries are stored in a single flat array of slots, next to an array of
+ * one control byte per slot. The control byte holds seven bits of the key's
+ * hash, so a lookup compares a group of 16 control bytes at once with SSE2,
+ * and only compares keys in slots whose control byte matches. Most misses
+ * never touch the slots at all.
+ *
+ * The interface follows std::unordered_map, with these differences:
+ *
+ * - Inserting or erasing invalidates all iterators and references, and
+ *   rehashing moves entries.
+ * - If both hashT and equalT define is_transparent, find(), count(),
+ *   contains() and erase() accept any type the two accept, e.g. a C string
+ *   for a map with std::string keys.
+ * - reserve(n) guarantees that n entries can be inserted without rehashing.
+ **/
+template <
+  typename keyT,
+  typename valueT,
+  typename hashT = transparent_hash,
+  typename equalT = transparent_equal,
+  typename allocT = std::allocator<std::pair<keyT const, valueT> >
+>
+class flat_map
+{
+public:
+  typedef keyT                            key_type;
+  typedef valueT                          mapped_type;
+  typedef std::pair<keyT const, valueT>   value_type;
+  typedef std::size_t                     size_type;
+  typedef hashT                           hasher;
+  typedef equalT                          key_equal;
+  typedef allocT                          allocator_type;
+
+  template <typename entryT>
+  class basic_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef entryT                    value_type;
+    typedef std::ptrdiff_t            difference_type;
+    typedef entryT *                  pointer;
+    typedef entryT &                  reference;
+
+    inline basic_iterator()
+      : m_ctrl(nullptr)
+      , m_slot(nullptr)
+      , m_end(nullptr)
+    {
+    }
+
+    // Allows conversion from iterator to const_iterator.
+    template <typename otherT>
+    inline basic_iterator(basic_iterator<otherT> const & other)
+      : m_ctrl(other.m_ctrl)
+      , m_slot(other.m_slot)
+      , m_end(other.m_end)
+    {
+    }
+
+    inline entryT & operator*() const
+    {
+      return *m_slot;
+    }
+
+    inline entryT * operator->() const
+    {
+      return m_slot;
+    }
+
+    inline basic_iterator & operator++()
+    {
+      ++m_ctrl;
+      ++m_slot;
+      skip_free();
+      return *this;
+    }
+
+    inline basic_iterator operator++(int)
+    {
+      basic_iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    inline bool operator==(basic_iterator const & other) const
+    {
+      return m_ctrl == other.m_ctrl;
+    }
+
+    inline bool operator!=(basic_iterator const & other) const
+    {
+      return m_ctrl != other.m_ctrl;
+    }
+
+  private:
+    friend class flat_map;
+    template <typename otherT> friend class basic_iterator;
+
+    inline basic_iterator(detail::ctrl_t const * ctrl, entryT * slot,
+        detail::ctrl_t const * end)
+      : m_ctrl(ctrl)
+      , m_slot(slot)
+      , m_end(end)
+    {
+      skip_free();
+    }
+
+    inline void skip_free()
+    {
+      while (m_ctrl != m_end && *m_ctrl < 0) {
+        ++m_ctrl;
+        ++m_slot;
+      }
+    }
+
+    detail::ctrl_t const *  m_ctrl;
+    entryT *                m_slot;
+    detail::ctrl_t const *  m_end;
+  };
+
+  typedef basic_iterator<value_type>        iterator;
+  typedef basic_iterator<value_type const>  const_iterator;
+
+private:
+  // Heterogeneous lookup is only enabled if both functions allow it.
+  template <typename otherT>
+  using transparent_key = typename std::enable_if<
+    detail::is_transparent<hashT>::value
+    && detail::is_transparent<equalT>::value
+    && !std::is_convertible<otherT const &, iterator>::value
+    && !std::is_convertible<otherT const &, const_iterator>::value
+  >::type;
+
+public:
+  /**
+   * Constructors and assignment
+   **/
+  explicit inline flat_map(size_type capacity = 0,
+      hasher const & hash = hasher(), key_equal const & equal = key_equal(),
+      allocator_type const & alloc = allocator_type())
+    : m_hash(hash)
+    , m_equal(equal)
+    , m_alloc(alloc)
+    , m_ctrl(nullptr)
+    , m_slots(nullptr)
+    , m_capacity(0)
+    , m_size(0)
+    , m_growth_left(0)
+  {
+    reserve(capacity);
+  }
+
+  inline flat_map(std::initializer_list<value_type> init)
+    : flat_map(init.size())
+  {
+    for (value_type const & value : init) {
+      insert(value);
+    }
+  }
+
+  // Copies keep the layout of the original, so nothing is rehashed.
+  inline flat_map(flat_map const & other)
+    : m_hash(other.m_hash)
+    , m_equal(other.m_equal)
+    , m_alloc(alloc_traits::select_on_container_copy_construction(
+          other.m_alloc))
+    , m_ctrl(nullptr)
+    , m_slots(nullptr)
+    , m_capacity(0)
+    , m_size(0)
+    , m_growth_left(0)
+  {
+    if (!other.m_size) {
+      return;
+    }
+    allocate(other.m_capacity);
+    try {
+      for (size_type i = 0 ; i < m_capacity ; ++i) {
+        if (other.m_ctrl[i] >= 0) {
+          alloc_traits::construct(m_alloc, m_slots + i, other.m_slots[i]);
+          ++m_size;
+        }
+        m_ctrl[i] = other.m_ctrl[i];
+      }
+    } catch (...) {
+      destroy();
+      throw;
+    }
+    m_growth_left = other.m_growth_left;
+  }
+
+  inline flat_map(flat_map && other)
+    : m_hash(std::move(other.m_hash))
+    , m_equal(std::move(other.m_equal))
+    , m_alloc(std::move(other.m_alloc))
+    , m_ctrl(other.m_ctrl)
+    , m_slots(other.m_slots)
+    , m_capacity(other.m_capacity)
+    , m_size(other.m_size)
+    , m_growth_left(other.m_growth_left)
+  {
+    other.m_ctrl = nullptr;
+    other.m_slots = nullptr;
+    other.m_capacity = other.m_size = other.m_growth_left = 0;
+  }
+
+  inline ~flat_map()
+  {
+    destroy();
+  }
+
+  inline flat_map & operator=(flat_map other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  inline void swap(flat_map & other)
+  {
+    using std::swap;
+    swap(m_hash, other.m_hash);
+    swap(m_equal, other.m_equal);
+    swap(m_alloc, other.m_alloc);
+    swap(m_ctrl, other.m_ctrl);
+    swap(m_slots, other.m_slots);
+    swap(m_capacity, other.m_capacity);
+    swap(m_size, other.m_size);
+    swap(m_growth_left, other.m_growth_left);
+  }
+
+  /**
+   * Iterators
+   **/
+  inline iterator begin()
+  {
+    return iterator(m_ctrl, m_slots, m_ctrl + m_capacity);
+  }
+
+  inline const_iterator begin() const
+  {
+    return const_iterator(m_ctrl, m_slots, m_ctrl + m_capacity);
+  }
+
+  inline const_iterator cbegin() const
+  {
+    return begin();
+  }
+
+  inline iterator end()
+  {
+    return iterator_at(m_capacity);
+  }
+
+  inline const_iterator end() const
+  {
+    return iterator_at(m_capacity);
+  }
+
+  inline const_iterator cend() const
+  {
+    return end();
+  }
+
+  /**
+   * Capacity
+   **/
+  inline bool empty() const
+  {
+    return !m_size;
+  }
+
+  inline size_type size() const
+  {
+    return m_size;
+  }
+
+  // The number of slots; at most 7/8 of them are used.
+  inline size_type capacity() const
+  {
+    return m_capacity;
+  }
+
+  inline void reserve(size_type count)
+  {
+    size_type capacity = detail::GROUP_WIDTH;
+    while (max_load(capacity) < count) {
+      capacity *= 2;
+    }
+    if (count && capacity > m_capacity) {
+      rehash(capacity);
+    }
+  }
+
+  /**
+   * Modifiers
+   **/
+  inline std::pair<iterator, bool> insert(value_type const & value)
+  {
+    return emplace_key(value.first, value);
+  }
+
+  inline std::pair<iterator, bool> insert(value_type && value)
+  {
+    return emplace_key(value.first, std::move(value));
+  }
+
+  template <typename... argsT>
+  inline std::pair<iterator, bool> emplace(argsT && ... args)
+  {
+    value_type value(std::forward<argsT>(args)...);
+    return emplace_key(value.first, std::move(value));
+  }
+
+  template <typename... argsT>
+  inline std::pair<iterator, bool> try_emplace(key_type const & key,
+      argsT && ... args)
+  {
+    return emplace_key(key, std::piecewise_construct,
+        std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<argsT>(args)...));
+  }
+
+  template <typename... argsT>
+  inline std::pair<iterator, bool> try_emplace(key_type && key,
+      argsT && ... args)
+  {
+    return emplace_key(key, std::piecewise_construct,
+        std::forward_as_tuple(std::move(key)),
+        std::forward_as_tuple(std::forward<argsT>(args)...));
+  }
+
+  inline mapped_type & operator[](key_type const & key)
+  {
+    return try_emplace(key).first->second;
+  }
+
+  inline mapped_type & operator[](key_type && key)
+  {
+    return try_emplace(std::move(key)).first->second;
+  }
+
+  inline iterator erase(const_iterator pos)
+  {
+    size_type index = static_cast<size_type>(pos.m_ctrl - m_ctrl);
+    erase_at(index);
+    return iterator(m_ctrl + index + 1, m_slots + index + 1,
+        m_ctrl + m_capacity);
+  }
+
+  inline iterator erase(iterator pos)
+  {
+    return erase(const_iterator(pos));
+  }
+
+  template <typename otherT, typename = transparent_key<otherT> >
+  inline size_type erase(otherT const & key)
+  {
+    return erase_key(key);
+  }
+
+  inline size_type erase(key_type const & key)
+  {
+    return erase_key(key);
+  }
+
+  // Keeps the capacity.
+  inline void clear()
+  {
+    destroy_slots();
+    if (m_capacity) {
+      std::memset(m_ctrl, detail::CTRL_EMPTY, m_capacity);
+    }
+    m_size = 0;
+    m_growth_left = max_load(m_capacity);
+  }
+
+  /**
+   * Lookup
+   **/
+  template <typename otherT, typename = transparent_key<otherT> >
+  inline iterator find(otherT const & key)
+  {
+    return iterator_at(find_index(key));
+  }
+
+  template <typename otherT, typename = transparent_key<otherT> >
+  inline const_iterator find(otherT const & key) const
+  {
+    return iterator_at(find_index(key));
+  }
+
+  inline iterator find(key_type const & key)
+  {
+    return iterator_at(find_index(key));
+  }
+
+  inline const_iterator find(key_type const & key) const
+  {
+    return iterator_at(find_index(key));
+  }
+
+  template <typename otherT, typename = transparent_key<otherT> >
+  inline size_type count(otherT const & key) const
+  {
+    return find_index(key) != m_capacity ? 1 : 0;
+  }
+
+  inline size_type count(key_type const & key) const
+  {
+    return find_index(key) != m_capacity ? 1 : 0;
+  }
+
+  template <typename otherT, typename = transparent_key<otherT> >
+  inline bool contains(otherT const & key) const
+  {
+    return find_index(key) != m_capacity;
+  }
+
+  inline bool contains(key_type const & key) const
+  {
+    return find_index(key) != m_capacity;
+  }
+
+  inline mapped_type & at(key_type const & key)
+  {
+    return m_slots[checked_index(key)].second;
+  }
+
+  inline mapped_type const & at(key_type const & key) const
+  {
+    return m_slots[checked_index(key)].second;
+  }
+
+  inline hasher hash_function() const
+  {
+    return m_hash;
+  }
+
+  inline key_equal key_eq() const
+  {
+    return m_equal;
+  }
+
+  inline allocator_type get_allocator() const
+  {
+    return m_alloc;
+  }
+
+private:
+  typedef std::allocator_traits<allocT>                       alloc_traits;
+  typedef typename alloc_traits::template rebind_alloc<detail::ctrl_t>
+                                                              ctrl_alloc;
+  typedef std::allocator_traits<ctrl_alloc>                   ctrl_traits;
+
+  inline static size_type max_load(size_type capacity)
+  {
+    return capacity - capacity / 8;
+  }
+
+  // The lower seven bits of the hash go into the control byte, the remaining
+  // bits select the group at which probing starts.
+  inline static detail::ctrl_t control(std::size_t hash)
+  {
+    return static_cast<detail::ctrl_t>(hash & 0x7f);
+  }
+
+  inline size_type first_group(std::size_t hash) const
+  {
+    return (hash >> 7) & (m_capacity / detail::GROUP_WIDTH - 1);
+  }
+
+  // Groups are probed in triangular order, which visits every group exactly
+  // once, as their number is a power of two.
+  inline size_type next_group(size_type group, size_type step) const
+  {
+    return (group + step) & (m_capacity / detail::GROUP_WIDTH - 1);
+  }
+
+  inline iterator iterator_at(size_type index)
+  {
+    return iterator(m_ctrl + index, m_slots + index, m_ctrl + m_capacity);
+  }
+
+  inline const_iterator iterator_at(size_type index) const
+  {
+    return const_iterator(m_ctrl + index, m_slots + index,
+        m_ctrl + m_capacity);
+  }
+
+  // Returns m_capacity if the key is not found. A group with an empty slot
+  // ends the search: the key would have been inserted there.
+  template <typename otherT>
+  inline size_type find_index(otherT const & key) const
+  {
+    if (!m_size) {
+      return m_capacity;
+    }
+    std::size_t hash = m_hash(key);
+    detail::ctrl_t ctrl = control(hash);
+    size_type group = first_group(hash);
+    for (size_type step = 1 ; ; ++step) {
+      size_type base = group * detail::GROUP_WIDTH;
+      detail::group g(m_ctrl + base);
+      for (uint32_t match = g.match(ctrl) ; match ; match &= match - 1) {
+        size_type index = base + detail::lowest_bit(match);
+        if (m_equal(m_slots[index].first, key)) {
+          return index;
+        }
+      }
+      if (g.match_empty()) {
+        return m_capacity;
+      }
+      group = next_group(group, step);
+    }
+  }
+
+  inline size_type checked_index(key_type const & key) const
+  {
+    size_type index = find_index(key);
+    if (index == m_capacity) {
+      throw std::out_of_range("Key not found in flat_map.");
+    }
+    return index;
+  }
+
+  template <typename otherT>
+  inline size_type erase_key(otherT const & key)
+  {
+    size_type index = find_index(key);
+    if (index == m_capacity) {
+      return 0;
+    }
+    erase_at(index);
+    return 1;
+  }
+
+  // The first empty or deleted slot in the probe sequence of a hash.
+  inline size_type free_index(std::size_t hash) const
+  {
+    size_type group = first_group(hash);
+    for (size_type step = 1 ; ; ++step) {
+      uint32_t match = detail::group(m_ctrl + group * detail::GROUP_WIDTH)
+        .match_free();
+      if (match) {
+        return group * detail::GROUP_WIDTH + detail::lowest_bit(match);
+      }
+      group = next_group(group, step);
+    }
+  }
+
+  template <typename... argsT>
+  inline std::pair<iterator, bool> emplace_key(key_type const & key,
+      argsT && ... args)
+  {
+    size_type index = find_index(key);
+    if (index != m_capacity) {
+      return std::make_pair(iterator_at(index), false);
+    }
+
+    std::size_t hash = m_hash(key);
+    index = m_capacity ? free_index(hash) : 0;
+    // Reusing a deleted slot does not use up any room; filling an empty one
+    // does.
+    if (!m_capacity
+        || (m_ctrl[index] == detail::CTRL_EMPTY && !m_growth_left)) {
+      grow();
+      index = free_index(hash);
+    }
+
+    alloc_traits::construct(m_alloc, m_slots + index,
+        std::forward<argsT>(args)...);
+    if (m_ctrl[index] == detail::CTRL_EMPTY) {
+      --m_growth_left;
+    }
+    m_ctrl[index] = control(hash);
+    ++m_size;
+    return std::make_pair(iterator_at(index), true);
+  }
+
+  // If a group has an empty slot, no probe sequence continues past it, and
+  // an erased slot in it can become empty again. Otherwise, it must be marked
+  // as deleted, so that probes continue to the next group.
+  inline void erase_at(size_type index)
+  {
+    alloc_traits::destroy(m_alloc, m_slots + index);
+    --m_size;
+    if (detail::group(m_ctrl + index / detail::GROUP_WIDTH
+          * detail::GROUP_WIDTH).match_empty()) {
+      m_ctrl[index] = detail::CTRL_EMPTY;
+      ++m_growth_left;
+    } else {
+      m_ctrl[index] = detail::CTRL_DELETED;
+    }
+  }
+
+  // If deleted slots take up much of the room, rehashing into the same
+  // capacity is enough to reclaim them.
+  inline void grow()
+  {
+    if (m_capacity && m_size < max_load(m_capacity) / 2) {
+      rehash(m_capacity);
+    } else {
+      rehash(m_capacity ? m_capacity * 2 : detail::GROUP_WIDTH);
+    }
+  }
+
+  inline void rehash(size_type capacity)
+  {
+    detail::ctrl_t * old_ctrl = m_ctrl;
+    value_type * old_slots = m_slots;
+    size_type old_capacity = m_capacity;
+
+    allocate(capacity);
+    m_growth_left = max_load(capacity) - m_size;
+
+    for (size_type i = 0 ; i < old_capacity ; ++i) {
+      if (old_ctrl[i] < 0) {
+        continue;
+      }
+      std::size_t hash = m_hash(old_slots[i].first);
+      size_type index = free_index(hash);
+      // The old slot is destroyed right away, so its key can be moved from.
+      alloc_traits::construct(m_alloc, m_slots + index,
+          std::move(const_cast<key_type &>(old_slots[i].first)),
+          std::move(old_slots[i].second));
+      alloc_traits::destroy(m_alloc, old_slots + i);
+      m_ctrl[index] = control(hash);
+    }
+
+    deallocate(old_ctrl, old_slots, old_capacity);
+  }
+
+  // Allocates empty slots; does not touch the size.
+  inline void allocate(size_type capacity)
+  {
+    ctrl_alloc calloc(m_alloc);
+    m_ctrl = ctrl_traits::allocate(calloc, capacity);
+    try {
+      m_slots = alloc_traits::allocate(m_alloc, capacity);
+    } catch (...) {
+      ctrl_traits::deallocate(calloc, m_ctrl, capacity);
+      throw;
+    }
+    std::memset(m_ctrl, detail::CTRL_EMPTY, capacity);
+    m_capacity = capacity;
+  }
+
+  inline void deallocate(detail::ctrl_t * ctrl, value_type * slots,
+      size_type capacity)
+  {
+    if (!capacity) {
+      return;
+    }
+    ctrl_alloc calloc(m_alloc);
+    ctrl_traits::deallocate(calloc, ctrl, capacity);
+    alloc_traits::deallocate(m_alloc, slots, capacity);
+  }
+
+  inline void destroy_slots()
+  {
+    if (!m_size) {
+      return;
+    }
+    for (size_type i = 0 ; i < m_capacity ; ++i) {
+      if (m_ctrl[i] >= 0) {
+        alloc_traits::destroy(m_alloc, m_slots + i);
+      }
+    }
+  }
+
+  inline void destroy()
+  {
+    destroy_slots();
+    deallocate(m_ctrl, m_slots, m_capacity);
+  }
+
+  hasher            m_hash;
+  key_equal         m_equal;
+  allocator_type    m_alloc;
+
+  detail::ctrl_t *  m_ctrl;
+  value_type *      m_slots;
+  size_type         m_capacity;
+  size_type         m_size;
+  size_type         m_growth_left;
+};
+
+
+template <typename keyT, typename valueT, typename hashT, typename equalT,
+         typename allocT>
+inline void
+swap(flat_map<keyT, valueT, hashT, equalT, allocT> & first,
+    flat_map<keyT, valueT, hashT, equalT, allocT> & second)
+{
+  first.swap(second);
+}
+
+}} // namespace meta::hash
+
+#endif // guard
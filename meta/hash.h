@@ -29,57 +29,1048 @@
 #include <meta/meta.h>
 
 #if META_CXX_MODE != META_CXX_MODE_CXX0X
-#error Can't compile meta/singleton.h because there's no C++11 support.
+#error Can't compile meta/hash.h because there's no C++11 support.
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <cstddef>
+#include <cstring>
+
+#include <meta/inttypes.h>
 
 namespace meta {
 namespace hash {
 
+namespace detail {
+
+template <typename uintT>
+inline META_CONSTEXPR uintT
+xorshift(uintT value, unsigned int shift)
+{
+  return value ^ (value >> shift);
+}
+
+
+/**
+ * Multiply-xorshift finalizers, which make every bit of the result depend on
+ * every bit of the input. The 64 bit version uses the constants from
+ * splitmix64, the 32 bit version those found by Chris Wellons' hash-prospector.
+ *
+ * The golden ratio constant is used to offset combined values, so that a zero
+ * value still changes the seed.
+ **/
+template <std::size_t SIZE>
+struct mixer;
+
+template <>
+struct mixer<8>
+{
+  typedef uint64_t type;
+
+  static type const golden = 0x9e3779b97f4a7c15ULL;
+
+  inline static META_CONSTEXPR type mix(type value)
+  {
+    return xorshift<type>(xorshift<type>(xorshift(value, 30)
+          * 0xbf58476d1ce4e5b9ULL, 27)
+        * 0x94d049bb133111ebULL, 31);
+  }
+};
+
+template <>
+struct mixer<4>
+{
+  typedef uint32_t type;
+
+  static type const golden = 0x9e3779b9UL;
+
+  inline static META_CONSTEXPR type mix(type value)
+  {
+    return xorshift<type>(xorshift<type>(xorshift(value, 16) * 0x7feb352dUL, 15)
+        * 0x846ca68bUL, 16);
+  }
+};
+
+typedef mixer<sizeof(std::size_t)> size_mixer;
+
+} // namespace detail
+
+
 /**
  * Combine two hash values.
- * Based on boost::hash_combine, which is based on
- * http://www.cs.rmit.edu.au/~jz/fulltext/jasist-tch.pdf
+ *
+ * This is boost::hash_combine, with the result run through a finalizer of the
+ * same width as std::size_t, so that the upper bits are as well distributed as
+ * the lower bits. That matters e.g. for hash tables that derive the bucket
+ * index from the upper bits.
  **/
+inline META_CONSTEXPR std::size_t
+combine(std::size_t seed, std::size_t value)
+{
+  return detail::size_mixer::mix(seed ^ (value + detail::size_mixer::golden
+        + (seed << 6) + (seed >> 2)));
+}
+
 inline void
 hash_combine(std::size_t & seed, std::size_t const & value)
 {
-
-  seed ^= value + 0x9e3779b9
-    + (seed << 6) + (seed >> 2);
+  seed = combine(seed, value);
 }
 
 
 /**
- * Hash multiple values
+ * Hash multiple values, by hashing each with std::hash and folding the results
+ * into a seed from left to right. Each step of the fold is a single multiply;
+ * the full finalizer only runs once, on the result.
  *
  * std::hash only exists from C++11 onwards.
  **/
+namespace detail {
+
+inline void
+fold(std::size_t & seed, std::size_t const & value)
+{
+  seed = (seed ^ value) * size_mixer::golden;
+}
+
+} // namespace detail
+
+template <typename... Ts>
+inline std::size_t multi_hash(Ts const & ... ts)
+{
+  // Starting from a non-zero seed means zero values still change the hash.
+  std::size_t seed = detail::size_mixer::golden;
+  // Elements of a braced initializer list are evaluated in order.
+  int expand[] = { 0, (detail::fold(seed, std::hash<Ts>()(ts)), 0)... };
+  (void) expand;
+  return detail::size_mixer::mix(seed);
+}
+
+
+/**
+ * String hashing that works both at compile time and at runtime, with
+ * identical results. This allows e.g. switching on strings:
+ *
+ *    using namespace meta::hash::literals;
+ *
+ *    switch (meta::hash::key_hash(type.data(), type.size())) {
+ *      case "ORDER"_h:
+ *        ...
+ *      case "CANCEL"_h:
+ *        ...
+ *    }
+ *
+ * Two keys with the same hash value produce duplicate case labels, so
+ * collisions between the keys themselves are caught by the compiler. Input
+ * that is not among the keys may still collide with one, though; compare
+ * the string after matching the hash if that matters.
+ *
+ * Since C++11 constexpr functions can't contain loops, the functions below
+ * recurse for constant evaluation, splitting the input in halves so that the
+ * depth grows only logarithmically with its size. Runtime calls use loops
+ * instead where the compiler can tell the two apart, and always for the
+ * std::string overloads.
+ **/
+namespace detail {
+
+inline META_CONSTEXPR uint64_t
+byte(char const * str, std::size_t index)
+{
+  return static_cast<unsigned char>(str[index]);
+}
+
+
+/**
+ * FNV-1a, 64 bit
+ **/
+static uint64_t const FNV1A_OFFSET = 0xcbf29ce484222325ULL;
+static uint64_t const FNV1A_PRIME = 0x100000001b3ULL;
+
+inline META_CONSTEXPR uint64_t
+fnv1a_step(uint64_t hash, char const * str, std::size_t index)
+{
+  return (hash ^ byte(str, index)) * FNV1A_PRIME;
+}
+
+// The first half, rounded down to 8 byte steps, then the rest.
+inline META_CONSTEXPR uint64_t
+fnv1a_impl(char const * str, std::size_t size, uint64_t hash)
+{
+  return size >= 16
+    ? fnv1a_impl(str + size / 16 * 8, size - size / 16 * 8,
+        fnv1a_impl(str, size / 16 * 8, hash))
+    : (size >= 8
+        ? fnv1a_impl(str + 8, size - 8,
+            fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(
+            fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(hash,
+            str, 0), str, 1), str, 2), str, 3),
+            str, 4), str, 5), str, 6), str, 7))
+        : (size
+            ? fnv1a_impl(str + 1, size - 1, fnv1a_step(hash, str, 0))
+            : hash));
+}
+
+inline uint64_t
+fnv1a_loop(char const * str, std::size_t size, uint64_t hash)
+{
+  for (std::size_t i = 0 ; i < size ; ++i) {
+    hash = fnv1a_step(hash, str, i);
+  }
+  return hash;
+}
+
+
+/**
+ * The upper 64 bits of the 128 bit product of a and b. The portable version
+ * is used where there is no 128 bit integer type.
+ **/
+inline META_CONSTEXPR uint64_t
+mul_hi_combine(uint64_t hi_hi, uint64_t hi_lo, uint64_t cross)
+{
+  return hi_hi + (hi_lo >> 32) + (cross >> 32);
+}
+
+inline META_CONSTEXPR uint64_t
+mul_hi_portable(uint64_t a, uint64_t b)
+{
+  return mul_hi_combine((a >> 32) * (b >> 32), (a >> 32) * (b & 0xffffffffULL),
+      (((a & 0xffffffffULL) * (b & 0xffffffffULL)) >> 32)
+      + (((a >> 32) * (b & 0xffffffffULL)) & 0xffffffffULL)
+      + (a & 0xffffffffULL) * (b >> 32));
+}
+
+inline META_CONSTEXPR uint64_t
+mul_hi(uint64_t a, uint64_t b)
+{
+#if defined(META_HAVE_INT128)
+  return static_cast<uint64_t>((static_cast< ::meta::uint128_t>(a) * b) >> 64);
+#else
+  return mul_hi_portable(a, b);
+#endif
+}
+
+
+/**
+ * wyhash style hashing: the core operation is a 64x64 to 128 bit multiply,
+ * folding the two halves of the product together.
+ **/
+static uint64_t const WY_SECRET0 = 0xa0761d6478bd642fULL;
+static uint64_t const WY_SECRET1 = 0xe7037ed1a0b428dbULL;
+
+inline META_CONSTEXPR uint64_t
+wymix(uint64_t a, uint64_t b)
+{
+  return (a * b) ^ mul_hi(a, b);
+}
+
+inline META_CONSTEXPR uint64_t
+read64(char const * str)
+{
+  return byte(str, 0) | (byte(str, 1) << 8) | (byte(str, 2) << 16)
+    | (byte(str, 3) << 24) | (byte(str, 4) << 32) | (byte(str, 5) << 40)
+    | (byte(str, 6) << 48) | (byte(str, 7) << 56);
+}
+
+inline META_CONSTEXPR uint64_t
+read32(char const * str)
+{
+  return byte(str, 0) | (byte(str, 1) << 8) | (byte(str, 2) << 16)
+    | (byte(str, 3) << 24);
+}
+
+inline META_CONSTEXPR uint64_t
+read_small(char const * str, std::size_t size)
+{
+  return (byte(str, 0) << 16) | (byte(str, size >> 1) << 8)
+    | byte(str, size - 1);
+}
+
+inline META_CONSTEXPR uint64_t
+wy_finish(uint64_t a, uint64_t b, uint64_t seed, std::size_t size)
+{
+  return wymix(((a ^ WY_SECRET1) * (b ^ seed)) ^ WY_SECRET0 ^ size,
+      mul_hi(a ^ WY_SECRET1, b ^ seed) ^ WY_SECRET1);
+}
+
+// Up to 16 bytes are read as (possibly overlapping) 32 bit words.
+inline META_CONSTEXPR uint64_t
+wy_short(char const * str, std::size_t size, uint64_t seed)
+{
+  return size >= 4
+    ? wy_finish(
+        (read32(str) << 32) | read32(str + ((size >> 3) << 2)),
+        (read32(str + size - 4) << 32)
+          | read32(str + size - 4 - ((size >> 3) << 2)),
+        seed, size)
+    : wy_finish(size ? read_small(str, size) : 0, 0, seed, size);
+}
+
+// Longer input is consumed 16 bytes at a time; the last 16 bytes, which may
+// overlap with the previous block, go into the finalization.
+inline META_CONSTEXPR uint64_t
+wy_block(char const * str, uint64_t seed)
+{
+  return wymix(read64(str) ^ WY_SECRET1, read64(str + 8) ^ seed);
+}
+
+inline META_CONSTEXPR uint64_t
+wy_blocks(char const * str, std::size_t blocks, uint64_t seed)
+{
+  return blocks > 1
+    ? wy_blocks(str + blocks / 2 * 16, blocks - blocks / 2,
+        wy_blocks(str, blocks / 2, seed))
+    : (blocks ? wy_block(str, seed) : seed);
+}
+
+inline META_CONSTEXPR uint64_t
+wy_long(char const * str, std::size_t size, uint64_t seed)
+{
+  return wy_finish(read64(str + size - 16), read64(str + size - 8),
+      wy_blocks(str, (size - 1) / 16, seed), size);
+}
+
+inline META_CONSTEXPR uint64_t
+wyhash_seeded(char const * str, std::size_t size, uint64_t seed)
+{
+  return size <= 16
+    ? wy_short(str, size, seed)
+    : wy_long(str, size, seed);
+}
+
+inline uint64_t
+wyhash_loop(char const * str, std::size_t size, uint64_t seed)
+{
+  if (size <= 16) {
+    return wy_short(str, size, seed);
+  }
+  std::size_t const blocks = (size - 1) / 16;
+  for (std::size_t i = 0 ; i < blocks ; ++i) {
+    seed = wy_block(str + i * 16, seed);
+  }
+  return wy_finish(read64(str + size - 16), read64(str + size - 8), seed,
+      size);
+}
+
+
+/**
+ * Whether a constexpr function is evaluated at compile time. Without
+ * compiler support, this is assumed, so that the result is always usable in
+ * constant expressions.
+ **/
+inline META_CONSTEXPR bool
+constant_evaluated()
+{
+#if defined(META_HAVE_CONSTANT_EVALUATED)
+  return __builtin_is_constant_evaluated();
+#else
+  return true;
+#endif
+}
+
+
+inline META_CONSTEXPR uint64_t
+wyhash_seed(uint64_t seed)
+{
+  return seed ^ wymix(seed ^ WY_SECRET0, WY_SECRET1);
+}
+
+} // namespace detail
+
+
+/**
+ * FNV-1a is simple and produces good results for short keys, but processes
+ * input one byte at a time.
+ **/
+inline META_CONSTEXPR uint64_t
+fnv1a(char const * str, std::size_t size)
+{
+  return detail::constant_evaluated()
+    ? detail::fnv1a_impl(str, size, detail::FNV1A_OFFSET)
+    : detail::fnv1a_loop(str, size, detail::FNV1A_OFFSET);
+}
+
+inline uint64_t
+fnv1a(std::string const & str)
+{
+  return detail::fnv1a_loop(str.data(), str.size(), detail::FNV1A_OFFSET);
+}
+
+
+/**
+ * A wyhash style hash, which is faster than FNV-1a for all but the shortest
+ * keys.
+ **/
+inline META_CONSTEXPR uint64_t
+wyhash(char const * str, std::size_t size, uint64_t seed = 0)
+{
+  return detail::constant_evaluated()
+    ? detail::wyhash_seeded(str, size, detail::wyhash_seed(seed))
+    : detail::wyhash_loop(str, size, detail::wyhash_seed(seed));
+}
+
+inline uint64_t
+wyhash(std::string const & str, uint64_t seed = 0)
+{
+  return detail::wyhash_loop(str.data(), str.size(),
+      detail::wyhash_seed(seed));
+}
+
+
+}} // namespace meta::hash
+
+
+#include <meta/detail/hash_bytes.h>
+
+namespace meta {
+namespace hash {
+
+/**
+ * Hash arbitrary binary data, e.g. buffers or file contents.
+ *
+ * Up to 128 bytes of input, this produces the same result as wyhash() with
+ * the same seed, which keeps latency for typical keys low. Longer input is
+ * processed 64 bytes at a time in eight independent lanes, using AVX2 where
+ * the CPU supports it; for large buffers, that is limited by memory bandwidth
+ * rather than by the hash function. The result does not depend on which code
+ * path is chosen, nor on the alignment of data.
+ **/
+inline uint64_t
+hash_bytes(void const * data, std::size_t size, uint64_t seed = 0)
+{
+  unsigned char const * p = static_cast<unsigned char const *>(data);
+  if (size <= detail::SHORT_INPUT) {
+    return detail::hash_short(p, size, seed);
+  }
+
+  // Deriving the secret is only necessary for non-zero seeds.
+  uint64_t seeded[detail::SECRET_WORDS];
+  uint64_t const * secret = detail::BASE_SECRET;
+  if (seed) {
+    detail::make_secret(seeded, seed);
+    secret = seeded;
+  }
+
+  uint64_t acc[detail::LANES];
+  detail::init_lanes(acc);
+
+  detail::accumulate(acc, p, (size - 1) / detail::STRIPE, 0, secret);
+  return detail::finish_long(acc, p + size - detail::STRIPE, secret, size);
+}
+
+
+/**
+ * Streaming version of hash_bytes(), for input that arrives in pieces:
+ *
+ *    hasher h(seed);
+ *    while (...) {
+ *      h.update(chunk, chunk_size);
+ *    }
+ *    uint64_t result = h.finalize();
+ *
+ * The result is identical to that of hash_bytes() over the concatenated input,
+ * no matter how it is split into chunks. finalize() does not modify the
+ * state, so more input can follow.
+ **/
+class hasher
+{
+public:
+  inline explicit hasher(uint64_t seed = 0)
+    : m_seed(seed)
+    , m_total(0)
+    , m_stripes(0)
+    , m_buffered(0)
+  {
+    detail::make_secret(m_secret, seed);
+    detail::init_lanes(m_acc);
+  }
+
+  inline void update(void const * data, std::size_t size)
+  {
+    unsigned char const * p = static_cast<unsigned char const *>(data);
+    m_total += size;
+
+    if (m_buffered + size <= BUFFER_SIZE) {
+      std::memcpy(m_buffer + m_buffered, p, size);
+      m_buffered += size;
+      return;
+    }
+
+    // More input follows the buffered stripes, so none of them can be the
+    // final stripe; process them.
+    if (m_buffered) {
+      std::size_t fill = BUFFER_SIZE - m_buffered;
+      std::memcpy(m_buffer + m_buffered, p, fill);
+      p += fill;
+      size -= fill;
+      consume(m_buffer, BUFFER_SIZE / detail::STRIPE);
+      m_buffered = 0;
+    }
+
+    // Process large inputs in place, but always keep back at least one byte.
+    if (size > BUFFER_SIZE) {
+      std::size_t stripes = (size - 1) / detail::STRIPE;
+      consume(p, stripes);
+      p += stripes * detail::STRIPE;
+      size -= stripes * detail::STRIPE;
+    }
+
+    std::memcpy(m_buffer, p, size);
+    m_buffered = size;
+  }
+
+  inline uint64_t finalize() const
+  {
+    if (m_total <= detail::SHORT_INPUT) {
+      return detail::hash_short(m_buffer, m_buffered, m_seed);
+    }
+
+    uint64_t acc[detail::LANES];
+    std::memcpy(acc, m_acc, sizeof(acc));
+    detail::accumulate(acc, m_buffer, (m_buffered - 1) / detail::STRIPE,
+        m_stripes, m_secret);
+
+    // The final stripe may reach back into input that was already processed.
+    unsigned char const * last = m_buffer + m_buffered - detail::STRIPE;
+    unsigned char tmp[detail::STRIPE];
+    if (m_buffered < detail::STRIPE) {
+      std::size_t reach_back = detail::STRIPE - m_buffered;
+      std::memcpy(tmp, m_last + m_buffered, reach_back);
+      std::memcpy(tmp + reach_back, m_buffer, m_buffered);
+      last = tmp;
+    }
+    return detail::finish_long(acc, last, m_secret, m_total);
+  }
+
+private:
+  static std::size_t const BUFFER_SIZE = 4 * detail::STRIPE;
+
+  inline void consume(unsigned char const * p, std::size_t stripes)
+  {
+    detail::accumulate(m_acc, p, stripes, m_stripes, m_secret);
+    m_stripes += stripes;
+    std::memcpy(m_last, p + (stripes - 1) * detail::STRIPE, detail::STRIPE);
+  }
+
+  uint64_t      m_seed;
+  uint64_t      m_total;
+  std::size_t   m_stripes;
+  std::size_t   m_buffered;
+  uint64_t      m_secret[detail::SECRET_WORDS];
+  uint64_t      m_acc[detail::LANES];
+  unsigned char m_buffer[BUFFER_SIZE];
+  unsigned char m_last[detail::STRIPE];
+};
+
+}} // namespace meta::hash
+
+
+#include <meta/detail/hash_batch.h>
+
+namespace meta {
+namespace hash {
+
+/**
+ * Prefetch policies for hash_batch(). The default does nothing;
+ * bucket_prefetch fetches the bucket a hash maps to in a table of
+ * bucket_count buckets of bucket_size bytes each, where the bucket index is
+ * the hash modulo bucket_count, and bucket_count is a power of two.
+ *
+ * Any functor taking the hash value can be used, e.g. to match the bucket
+ * layout of other tables.
+ **/
+struct no_prefetch
+{
+  inline void operator()(uint64_t) const
+  {
+  }
+};
+
+class bucket_prefetch
+{
+public:
+  inline bucket_prefetch(void const * buckets, std::size_t bucket_size,
+      std::size_t bucket_count)
+    : m_buckets(static_cast<char const *>(buckets))
+    , m_bucket_size(bucket_size)
+    , m_mask(bucket_count - 1)
+  {
+  }
+
+  inline void operator()(uint64_t hash) const
+  {
+#if defined(__GNUC__)
+    __builtin_prefetch(m_buckets
+        + (static_cast<std::size_t>(hash) & m_mask) * m_bucket_size);
+#else
+    (void) hash;
+#endif
+  }
+
+private:
+  char const *  m_buckets;
+  std::size_t   m_bucket_size;
+  std::size_t   m_mask;
+};
+
+
+/**
+ * Hash count keys at once; out[i] is identical to multi_hash(keys[i]).
+ *
+ * Hashing keys one at a time is bound by the latency of each key's chain of
+ * multiplies. Here, keys are processed in small chunks, so that the
+ * multiplies of different keys overlap, or run in AVX2 lanes where the CPU
+ * supports it.
+ *
+ * When the hashes are used to probe a table, pass a prefetch policy; the
+ * table's buckets are then requested while the remaining keys are being
+ * hashed:
+ *
+ *    hash_batch(keys, count, hashes,
+ *        bucket_prefetch(&buckets[0], sizeof(bucket), buckets.size()));
+ *    for (std::size_t i = 0 ; i < count ; ++i) {
+ *      probe(buckets[hashes[i] & (buckets.size() - 1)], keys[i]);
+ *    }
+ **/
+template <typename T, typename prefetchT>
+inline void
+hash_batch(T const * keys, std::size_t count, std::size_t * out,
+    prefetchT const & prefetch)
+{
+  for (std::size_t i = 0 ; i < count ; i += detail::BATCH_CHUNK) {
+    std::size_t chunk = std::min(count - i, detail::BATCH_CHUNK);
+    for (std::size_t k = 0 ; k < chunk ; ++k) {
+      out[i + k] = std::hash<T>()(keys[i + k]);
+    }
+    detail::finalize_batch(out + i, chunk);
+    for (std::size_t k = 0 ; k < chunk ; ++k) {
+      prefetch(out[i + k]);
+    }
+  }
+}
+
+template <typename T>
+inline void
+hash_batch(T const * keys, std::size_t count, std::size_t * out)
+{
+  hash_batch(keys, count, out, no_prefetch());
+}
+
+
+/**
+ * Hash count binary keys of key_size bytes each, stored back to back; out[i]
+ * is identical to hash_bytes() of the i-th key with the same seed. Keys of
+ * up to 128 bytes are hashed several at a time.
+ **/
+template <typename prefetchT>
+inline void
+hash_bytes_batch(void const * keys, std::size_t key_size, std::size_t count,
+    uint64_t * out, uint64_t seed, prefetchT const & prefetch)
+{
+  unsigned char const * p = static_cast<unsigned char const *>(keys);
+  std::size_t i = 0;
+  if (key_size <= detail::SHORT_INPUT) {
+    for ( ; i + detail::BATCH_LANES <= count ; i += detail::BATCH_LANES) {
+      detail::hash_short_lanes(p + i * key_size, key_size, seed, out + i);
+      for (std::size_t l = 0 ; l < detail::BATCH_LANES ; ++l) {
+        prefetch(out[i + l]);
+      }
+    }
+  }
+  for ( ; i < count ; ++i) {
+    out[i] = hash_bytes(p + i * key_size, key_size, seed);
+    prefetch(out[i]);
+  }
+}
+
+inline void
+hash_bytes_batch(void const * keys, std::size_t key_size, std::size_t count,
+    uint64_t * out, uint64_t seed = 0)
+{
+  hash_bytes_batch(keys, key_size, count, out, seed, no_prefetch());
+}
+
+
+/**
+ * Tree hashing: the input is split into leaves of TREE_LEAF_SIZE bytes (the
+ * last leaf may be shorter), which are hashed with hash_bytes() on up to
+ * threads threads. The leaf hashes are then combined in order, so the result
+ * only depends on the input and the seed, never on the number of threads.
+ *
+ * A value of 0 for threads uses as many threads as the hardware supports.
+ * Threads pick leaves one at a time, so that a slow thread, e.g. one waiting
+ * for pages of a mapped_file, does not hold up the others. If threads cannot
+ * be started, the calling thread does the remaining work.
+ *
+ * Note that the result differs from hash_bytes() over the same input.
+ **/
+static std::size_t const TREE_LEAF_SIZE = std::size_t(1) << 20;
+
+namespace detail {
+
+inline uint64_t
+combine64(uint64_t seed, uint64_t value)
+{
+  return mixer<8>::mix(seed ^ (value + mixer<8>::golden
+        + (seed << 6) + (seed >> 2)));
+}
+
+inline void
+hash_leaves(unsigned char const * data, std::size_t size, uint64_t seed,
+    std::atomic<std::size_t> & next, std::vector<uint64_t> & leaves)
+{
+  for (std::size_t leaf = next++ ; leaf < leaves.size() ; leaf = next++) {
+    std::size_t offset = leaf * TREE_LEAF_SIZE;
+    leaves[leaf] = hash_bytes(data + offset,
+        std::min(TREE_LEAF_SIZE, size - offset), seed);
+  }
+}
+
+} // namespace detail
+
+inline uint64_t
+tree_hash(void const * data, std::size_t size, unsigned int threads = 0,
+    uint64_t seed = 0)
+{
+  unsigned char const * p = static_cast<unsigned char const *>(data);
+  std::vector<uint64_t> leaves((size + TREE_LEAF_SIZE - 1) / TREE_LEAF_SIZE);
+
+  if (!threads) {
+    threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  std::size_t helpers = std::min<std::size_t>(threads, leaves.size());
+  helpers = helpers ? helpers - 1 : 0;
+
+  std::atomic<std::size_t> next(0);
+  std::vector<std::thread> workers;
+  workers.reserve(helpers);
+  try {
+    for (std::size_t i = 0 ; i < helpers ; ++i) {
+      workers.push_back(std::thread(&detail::hash_leaves, p, size, seed,
+            std::ref(next), std::ref(leaves)));
+    }
+  } catch (std::system_error const &) {
+    // Continue with the threads we have.
+  }
+  detail::hash_leaves(p, size, seed, next, leaves);
+  for (std::size_t i = 0 ; i < workers.size() ; ++i) {
+    workers[i].join();
+  }
+
+  uint64_t root = detail::wymix(seed ^ detail::WY_SECRET0,
+      size ^ detail::WY_SECRET1);
+  for (std::size_t i = 0 ; i < leaves.size() ; ++i) {
+    root = detail::combine64(root, leaves[i]);
+  }
+  return root;
+}
+
+
+/**
+ * The hash function used by the _h literal.
+ **/
+inline META_CONSTEXPR uint64_t
+key_hash(char const * str, std::size_t size)
+{
+  return wyhash(str, size);
+}
+
+inline uint64_t
+key_hash(std::string const & str)
+{
+  return wyhash(str);
+}
+
+
+namespace detail {
+
+// The hash of a value as flat_map's transparent_hash computes it: strings by
+// their contents with key_hash(), all other types with multi_hash().
 template <typename T>
-inline std::size_t multi_hash(T const & t)
+inline std::size_t
+value_hash(T const & value)
 {
-  return std::hash<T>()(t);
+  return multi_hash(value);
 }
 
-template <typename T0, typename... Ts>
-inline std::size_t multi_hash(T0 const & t0, Ts && ... ts)
+inline std::size_t
+value_hash(std::string const & value)
 {
-  std::size_t seed = multi_hash(t0);
-  if (0 == sizeof...(ts)) {
-    return seed;
+  return static_cast<std::size_t>(key_hash(value));
+}
+
+} // namespace detail
+
+
+/**
+ * A value together with its hash, computed once at construction. Use it for
+ * keys that are looked up in several hash tables in turn; std::hash of a
+ * hashed<T> just returns the stored hash.
+ *
+ *    hashed<std::string> key(name);
+ *    auto iter = first_table.find(key);
+ *    ...
+ *    auto other = second_table.find(key);
+ *
+ * The hash is the one flat_map's default transparent_hash computes for a T,
+ * and a hashed<T> compares equal to the T it wraps, so it can be looked up
+ * in flat_maps with plain T keys as well as in tables of hashed<T> keys.
+ *
+ * Comparisons between hashed<T> check the hashes first, so that unequal
+ * values rarely need to be compared. The value cannot be modified, as that
+ * would invalidate the hash.
+ **/
+template <typename T>
+class hashed
+{
+public:
+  typedef T value_type;
+
+  explicit inline hashed(T const & value)
+    : m_value(value)
+    , m_hash(detail::value_hash(m_value))
+  {
   }
 
-  std::size_t remainder = multi_hash(std::forward<Ts>(ts)...);
+  explicit inline hashed(T && value)
+    : m_value(std::move(value))
+    , m_hash(detail::value_hash(m_value))
+  {
+  }
+
+  inline T const & value() const
+  {
+    return m_value;
+  }
 
-  hash_combine(seed, remainder);
-  return seed;
+  inline T const & operator*() const
+  {
+    return m_value;
+  }
+
+  inline T const * operator->() const
+  {
+    return &m_value;
+  }
+
+  inline std::size_t hash() const
+  {
+    return m_hash;
+  }
+
+  inline bool operator==(hashed const & other) const
+  {
+    return m_hash == other.m_hash && m_value == other.m_value;
+  }
+
+  inline bool operator!=(hashed const & other) const
+  {
+    return !(*this == other);
+  }
+
+  // Comparisons with plain values, e.g. with the keys of a flat_map<T, ...>
+  friend inline bool operator==(hashed const & first, T const & second)
+  {
+    return first.m_value == second;
+  }
+
+  friend inline bool operator==(T const & first, hashed const & second)
+  {
+    return first == second.m_value;
+  }
+
+  friend inline bool operator!=(hashed const & first, T const & second)
+  {
+    return !(first.m_value == second);
+  }
+
+  friend inline bool operator!=(T const & first, hashed const & second)
+  {
+    return !(first == second.m_value);
+  }
+
+private:
+  T           m_value;
+  std::size_t m_hash;
+};
+
+template <typename T>
+inline hashed<typename std::decay<T>::type>
+make_hashed(T && value)
+{
+  return hashed<typename std::decay<T>::type>(std::forward<T>(value));
 }
 
 
+/**
+ * Jump consistent hashing (Lamping and Veach): maps a key to one of buckets
+ * buckets, such that growing from n to n + 1 buckets moves only 1 / (n + 1)
+ * of the keys, all of them to the new bucket. It needs no memory, and takes
+ * O(log(buckets)) steps.
+ *
+ * Buckets are numbered, so only the last bucket can be removed; use
+ * rendezvous_hash where arbitrary nodes come and go.
+ **/
+inline uint32_t
+jump_consistent_hash(uint64_t key, uint32_t buckets)
+{
+  if (!buckets) {
+    throw std::invalid_argument("Jump consistent hashing needs at least one "
+        "bucket.");
+  }
 
+  int64_t bucket = -1;
+  int64_t next = 0;
+  while (next < int64_t(buckets)) {
+    bucket = next;
+    key = key * 2862933555777941757ULL + 1;
+    next = static_cast<int64_t>((bucket + 1)
+        * (double(int64_t(1) << 31) / double((key >> 33) + 1)));
+  }
+  return static_cast<uint32_t>(bucket);
+}
+
+}} // namespace meta::hash
+
+
+#include <meta/detail/rendezvous.h>
+
+namespace meta {
+namespace hash {
+
+/**
+ * Weighted rendezvous (highest random weight) hashing: each key goes to the
+ * node that scores best for it, where the scores of a node are spread in
+ * proportion to its weight. Adding or removing a node only moves the keys
+ * that it wins or won, and changing a weight only moves keys to or from that
+ * node.
+ *
+ *    rendezvous_hash nodes;
+ *    for (auto const & server : servers) {
+ *      nodes.add(multi_hash(server.name), server.capacity);
+ *    }
+ *    ...
+ *    auto & server = servers[nodes(multi_hash(request.key))];
+ *
+ * Nodes are identified by the hash of their name; the index returned by add()
+ * and operator() is the position of the node in the order of adding, with
+ * removed nodes closing the gap.
+ *
+ * A lookup scores every node, eight at a time with AVX2 where the CPU
+ * supports it, so it costs O(nodes) without any memory beyond the nodes
+ * themselves. All kernels pick the same node. Key shares follow the weights
+ * to within about 2%. With thousands of nodes of equal weight,
+ * jump_consistent_hash() is much faster.
+ **/
+class rendezvous_hash
+{
+public:
+  inline rendezvous_hash()
+    : m_size(0)
+  {
+  }
+
+  inline std::size_t add(uint64_t node, double weight = 1.0)
+  {
+    if (!(weight > 0) || weight == std::numeric_limits<double>::infinity()) {
+      throw std::invalid_argument("Rendezvous hash weights must be positive "
+          "and finite.");
+    }
+    m_seeds.insert(m_seeds.begin() + m_size,
+        static_cast<uint32_t>(node ^ (node >> 32)));
+    m_inverse_weights.insert(m_inverse_weights.begin() + m_size,
+        static_cast<float>(1.0 / weight));
+    ++m_size;
+    pad();
+    return m_size - 1;
+  }
+
+  inline void remove(std::size_t index)
+  {
+    if (index >= m_size) {
+      throw std::out_of_range("No such node in rendezvous_hash.");
+    }
+    m_seeds.erase(m_seeds.begin() + index);
+    m_inverse_weights.erase(m_inverse_weights.begin() + index);
+    --m_size;
+    pad();
+  }
+
+  inline std::size_t size() const
+  {
+    return m_size;
+  }
+
+  inline bool empty() const
+  {
+    return !m_size;
+  }
+
+  inline void clear()
+  {
+    m_seeds.clear();
+    m_inverse_weights.clear();
+    m_size = 0;
+  }
+
+  // The index of the node for a key.
+  inline std::size_t operator()(uint64_t key) const
+  {
+    if (!m_size) {
+      throw std::out_of_range("No nodes in rendezvous_hash.");
+    }
+    return detail::rendezvous(m_seeds.data(), m_inverse_weights.data(),
+        m_seeds.size(), key);
+  }
+
+private:
+  inline void pad()
+  {
+    std::size_t padded = (m_size + detail::RENDEZVOUS_LANES - 1)
+      / detail::RENDEZVOUS_LANES * detail::RENDEZVOUS_LANES;
+    m_seeds.resize(padded, 0);
+    m_inverse_weights.resize(padded, std::numeric_limits<float>::infinity());
+  }
+
+  std::size_t           m_size;
+  std::vector<uint32_t> m_seeds;
+  std::vector<float>    m_inverse_weights;
+};
+
+
+namespace literals {
+
+inline META_CONSTEXPR uint64_t
+operator"" _h(char const * str, std::size_t size)
+{
+  return key_hash(str, size);
+}
+
+} // namespace literals
 
 }} // namespace meta::hash
 
+
+namespace std {
+
+template <typename T>
+struct hash<meta::hash::hashed<T> >
+{
+  inline std::size_t operator()(meta::hash::hashed<T> const & value) const
+  {
+    return value.hash();
+  }
+};
+
+} // namespace std
+
 #endif // guard
@@ -0,0 +1,388 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_INTERNER_H
+#define META_INTERNER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/interner.h because there's no C++11 support.
+#endif
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+#include <meta/inttypes.h>
+#include <meta/noncopyable.h>
+#include <meta/hash.h>
+
+namespace meta {
+namespace hash {
+
+namespace detail {
+
+struct interned_string
+{
+  char const *  data;
+  std::size_t   size;
+  uint64_t      hash;
+};
+
+/**
+ * Interned strings are kept in segments that never move, so that they can be
+ * read while new segments are added. The first segment holds
+ * 2^INTERN_FIRST_SEGMENT_BITS strings, and each further one twice as many as
+ * the one before, which covers all 32 bit IDs with INTERN_SEGMENTS segments.
+ **/
+static std::size_t const INTERN_FIRST_SEGMENT_BITS = 10;
+static std::size_t const INTERN_SEGMENTS = 33 - INTERN_FIRST_SEGMENT_BITS;
+
+// The segment holding an ID, and the ID's offset in it.
+inline std::size_t
+intern_segment(uint32_t id)
+{
+  uint64_t n = (uint64_t(id) >> INTERN_FIRST_SEGMENT_BITS) + 1;
+#if defined(__GNUC__)
+  return static_cast<std::size_t>(63 - __builtin_clzll(n));
+#else
+  std::size_t segment = 0;
+  while (n >>= 1) {
+    ++segment;
+  }
+  return segment;
+#endif
+}
+
+inline std::size_t
+intern_offset(uint32_t id, std::size_t segment)
+{
+  return static_cast<std::size_t>(id - (((uint64_t(1) << segment) - 1)
+        << INTERN_FIRST_SEGMENT_BITS));
+}
+
+
+/**
+ * The table maps hashes to IDs by linear probing. Each slot holds the upper
+ * 32 bits of the hash and the ID plus one, so that zero marks an empty slot,
+ * and most mismatches are found without looking at the string.
+ **/
+struct intern_table
+{
+  explicit inline intern_table(std::size_t capacity)
+    : mask(capacity - 1)
+    , slots(new std::atomic<uint64_t>[capacity])
+  {
+    for (std::size_t i = 0 ; i < capacity ; ++i) {
+      slots[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  inline void insert(uint64_t hash, uint32_t id)
+  {
+    std::size_t i = static_cast<std::size_t>(hash) & mask;
+    while (slots[i].load(std::memory_order_relaxed)) {
+      i = (i + 1) & mask;
+    }
+    slots[i].store(((hash >> 32) << 32) | (uint64_t(id) + 1),
+        std::memory_order_release);
+  }
+
+  std::size_t                               mask;
+  std::unique_ptr<std::atomic<uint64_t>[]>  slots;
+};
+
+static std::size_t const INTERN_MIN_CAPACITY = 64;
+static std::size_t const INTERN_ARENA_CHUNK = 65536;
+
+} // namespace detail
+
+
+// Returned by interner::find() for strings that are not interned.
+static uint32_t const NOT_INTERNED = ~uint32_t(0);
+
+
+/**
+ * A string interning table: maps strings to dense 32 bit IDs, starting at
+ * zero, in the order in which they were first interned. Once interned,
+ * strings can be compared by comparing their IDs, and their hashes are
+ * cached.
+ *
+ *    interner symbols;
+ *    uint32_t foo = symbols.intern("foo");
+ *    ...
+ *    if (symbols.intern(name) == foo) {
+ *      std::cout << symbols.c_str(foo) << std::endl;
+ *    }
+ *
+ * Strings are copied into an arena of large chunks, with a terminating zero;
+ * their addresses remain valid for the lifetime of the interner.
+ *
+ * All functions can be called from multiple threads at once. Looking up
+ * strings that are already interned, and getting an ID's string, takes no
+ * lock. Interning a new string takes a lock; it then checks again whether
+ * another thread interned the same string in the meantime, so that each
+ * string gets exactly one ID.
+ *
+ * When the table grows, the previous tables are kept until the interner is
+ * destroyed, so that concurrent readers can finish with them. This costs at
+ * most as much memory again as the current table.
+ **/
+class interner
+  : public ::meta::noncopyable
+{
+public:
+  typedef uint32_t id_type;
+
+  explicit inline interner(std::size_t expected = 0)
+    : m_size(0)
+    , m_arena_left(0)
+    , m_arena_next(nullptr)
+  {
+    std::size_t capacity = detail::INTERN_MIN_CAPACITY;
+    while (capacity < 2 * expected) {
+      capacity *= 2;
+    }
+    m_tables.push_back(std::unique_ptr<detail::intern_table>(
+          new detail::intern_table(capacity)));
+    m_table.store(m_tables.back().get(), std::memory_order_relaxed);
+
+    for (std::size_t i = 0 ; i < detail::INTERN_SEGMENTS ; ++i) {
+      m_segments[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  inline ~interner()
+  {
+    for (std::size_t i = 0 ; i < detail::INTERN_SEGMENTS ; ++i) {
+      delete [] m_segments[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * The ID of a string, interning it first if necessary.
+   **/
+  inline id_type intern(char const * str, std::size_t size)
+  {
+    uint64_t hash = key_hash(str, size);
+    id_type id = find(str, size, hash);
+    if (id != NOT_INTERNED) {
+      return id;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    id = find(str, size, hash);
+    if (id != NOT_INTERNED) {
+      return id;
+    }
+
+    id = static_cast<id_type>(m_size.load(std::memory_order_relaxed));
+    if (id == NOT_INTERNED) {
+      throw std::length_error("Too many interned strings.");
+    }
+
+    detail::interned_string & entry = allocate_entry(id);
+    entry.data = copy(str, size);
+    entry.size = size;
+    entry.hash = hash;
+
+    detail::intern_table * table = m_table.load(std::memory_order_relaxed);
+    if (2 * (std::size_t(id) + 1) > table->mask + 1) {
+      table = grow(table);
+    }
+    table->insert(hash, id);
+    m_size.store(std::size_t(id) + 1, std::memory_order_release);
+    return id;
+  }
+
+  inline id_type intern(std::string const & str)
+  {
+    return intern(str.data(), str.size());
+  }
+
+  inline id_type intern(char const * str)
+  {
+    return intern(str, std::strlen(str));
+  }
+
+  /**
+   * The ID of a string if it is interned, NOT_INTERNED otherwise. Never
+   * takes a lock.
+   **/
+  inline id_type find(char const * str, std::size_t size) const
+  {
+    return find(str, size, key_hash(str, size));
+  }
+
+  inline id_type find(std::string const & str) const
+  {
+    return find(str.data(), str.size());
+  }
+
+  inline id_type find(char const * str) const
+  {
+    return find(str, std::strlen(str));
+  }
+
+  /**
+   * The string of an ID, which must have been returned by intern().
+   **/
+  inline char const * c_str(id_type id) const
+  {
+    return entry(id).data;
+  }
+
+  inline std::size_t length(id_type id) const
+  {
+    return entry(id).size;
+  }
+
+  inline std::string str(id_type id) const
+  {
+    detail::interned_string const & e = entry(id);
+    return std::string(e.data, e.size);
+  }
+
+  // The key_hash() of the string of an ID.
+  inline uint64_t hash(id_type id) const
+  {
+    return entry(id).hash;
+  }
+
+  // The number of interned strings; IDs are below this.
+  inline std::size_t size() const
+  {
+    return m_size.load(std::memory_order_acquire);
+  }
+
+  inline bool empty() const
+  {
+    return !size();
+  }
+
+private:
+  inline id_type find(char const * str, std::size_t size, uint64_t hash) const
+  {
+    detail::intern_table const * table
+      = m_table.load(std::memory_order_acquire);
+    uint32_t tag = static_cast<uint32_t>(hash >> 32);
+    for (std::size_t i = static_cast<std::size_t>(hash) & table->mask ; ;
+        i = (i + 1) & table->mask)
+    {
+      uint64_t slot = table->slots[i].load(std::memory_order_acquire);
+      if (!slot) {
+        return NOT_INTERNED;
+      }
+      if (static_cast<uint32_t>(slot >> 32) != tag) {
+        continue;
+      }
+      id_type id = static_cast<id_type>(slot) - 1;
+      detail::interned_string const & e = entry(id);
+      if (e.size == size && !std::memcmp(e.data, str, size)) {
+        return id;
+      }
+    }
+  }
+
+  inline detail::interned_string const & entry(id_type id) const
+  {
+    std::size_t segment = detail::intern_segment(id);
+    return m_segments[segment].load(std::memory_order_acquire)[
+      detail::intern_offset(id, segment)];
+  }
+
+  // Called with the lock held.
+  inline detail::interned_string & allocate_entry(id_type id)
+  {
+    std::size_t segment = detail::intern_segment(id);
+    detail::interned_string * strings
+      = m_segments[segment].load(std::memory_order_relaxed);
+    if (!strings) {
+      strings = new detail::interned_string[
+        std::size_t(1) << (segment + detail::INTERN_FIRST_SEGMENT_BITS)];
+      m_segments[segment].store(strings, std::memory_order_release);
+    }
+    return strings[detail::intern_offset(id, segment)];
+  }
+
+  inline char const * copy(char const * str, std::size_t size)
+  {
+    char * result;
+    if (size + 1 > detail::INTERN_ARENA_CHUNK / 4) {
+      // Large strings get a chunk of their own.
+      m_arena.push_back(std::unique_ptr<char[]>(new char[size + 1]));
+      result = m_arena.back().get();
+    } else {
+      if (size + 1 > m_arena_left) {
+        m_arena.push_back(std::unique_ptr<char[]>(
+              new char[detail::INTERN_ARENA_CHUNK]));
+        m_arena_next = m_arena.back().get();
+        m_arena_left = detail::INTERN_ARENA_CHUNK;
+      }
+      result = m_arena_next;
+      m_arena_next += size + 1;
+      m_arena_left -= size + 1;
+    }
+    std::memcpy(result, str, size);
+    result[size] = '\0';
+    return result;
+  }
+
+  inline detail::intern_table * grow(detail::intern_table * table)
+  {
+    detail::intern_table * grown
+      = new detail::intern_table(2 * (table->mask + 1));
+    m_tables.push_back(std::unique_ptr<detail::intern_table>(grown));
+
+    std::size_t size = m_size.load(std::memory_order_relaxed);
+    for (std::size_t id = 0 ; id < size ; ++id) {
+      grown->insert(entry(static_cast<id_type>(id)).hash,
+          static_cast<id_type>(id));
+    }
+    m_table.store(grown, std::memory_order_release);
+    return grown;
+  }
+
+  std::atomic<std::size_t>                            m_size;
+  std::atomic<detail::intern_table *>                 m_table;
+  std::atomic<detail::interned_string *>              m_segments[
+    detail::INTERN_SEGMENTS];
+
+  // Only used with the lock held.
+  std::mutex                                          m_mutex;
+  std::vector<std::unique_ptr<detail::intern_table> > m_tables;
+  std::vector<std::unique_ptr<char[]> >               m_arena;
+  std::size_t                                         m_arena_left;
+  char *                                              m_arena_next;
+};
+
+}} // namespace meta::hash
+
+#endif // guard
@@ -45,4 +45,19 @@
 #  undef max
 #endif
 
+/**
+ * 128 bit integers are a compiler extension; if they're available,
+ * META_HAVE_INT128 is defined.
+ **/
+#if defined(__SIZEOF_INT128__)
+#  define META_HAVE_INT128
+
+namespace meta {
+
+__extension__ typedef __int128 int128_t;
+__extension__ typedef unsigned __int128 uint128_t;
+
+} // namespace meta
+#endif
+
 #endif // guard
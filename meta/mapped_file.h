@@ -0,0 +1,233 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_MAPPED_FILE_H
+#define META_MAPPED_FILE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/mapped_file.h because there's no C++11 support.
+#endif
+
+#if !defined(META_POSIX)
+#error meta/mapped_file.h is only available on POSIX platforms.
+#endif
+
+#include <string>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <meta/noncopyable.h>
+#include <meta/endian_array.h>
+
+namespace meta {
+
+/**
+ * A read-only memory mapping of an entire file.
+ *
+ * Mapping a file takes the same time no matter its size; pages are only read
+ * from disk when first accessed. Together with the endian_array views, which
+ * convert elements as they are read, that means data the program never looks
+ * at is never read nor converted:
+ *
+ *    mapped_file snapshot("snapshot.bin");
+ *    auto values = snapshot.array<uint64_t, byte_order::META_BIG_ENDIAN>(
+ *        header_size, count);
+ *    uint64_t v = values[12345];
+ *
+ * Binary headers can be described as structs of byte_order::endian_value
+ * members and accessed via overlay().
+ *
+ * Failure to map the file throws std::system_error; views exceeding the
+ * mapping throw std::out_of_range.
+ **/
+class mapped_file
+  : public noncopyable
+{
+public:
+  /**
+   * Access pattern hint for the kernel's read-ahead.
+   **/
+  enum access_pattern
+  {
+    ACCESS_NORMAL,
+    ACCESS_SEQUENTIAL,
+    ACCESS_RANDOM,
+  };
+
+  inline explicit mapped_file(std::string const & path,
+      access_pattern pattern = ACCESS_NORMAL)
+    : m_data(nullptr)
+    , m_size(0)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error(errno, std::system_category(),
+          "Could not open " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::system_category(),
+          "Could not stat " + path);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size) {
+      void * data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (MAP_FAILED == data) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::system_category(),
+            "Could not map " + path);
+      }
+      m_data = static_cast<char const *>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+
+    if (m_size && pattern != ACCESS_NORMAL) {
+      ::madvise(const_cast<char *>(m_data), m_size,
+          pattern == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+  }
+
+  inline mapped_file(mapped_file && other)
+    : noncopyable()
+    , m_data(other.m_data)
+    , m_size(other.m_size)
+  {
+    other.m_data = nullptr;
+    other.m_size = 0;
+  }
+
+  inline mapped_file & operator=(mapped_file && other)
+  {
+    if (this != &other) {
+      unmap();
+      m_data = other.m_data;
+      m_size = other.m_size;
+      other.m_data = nullptr;
+      other.m_size = 0;
+    }
+    return *this;
+  }
+
+  inline ~mapped_file()
+  {
+    unmap();
+  }
+
+  /**
+   * The raw file contents.
+   **/
+  inline char const * data() const
+  {
+    return m_data;
+  }
+
+  inline std::size_t size() const
+  {
+    return m_size;
+  }
+
+  /**
+   * A view of count integers of type intT at offset bytes into the file,
+   * stored in ENDIAN byte order.
+   **/
+  template <typename intT, int ENDIAN>
+  inline byte_order::endian_array<intT, ENDIAN>
+  array(std::size_t offset, std::size_t count) const
+  {
+    check_range(offset, count, sizeof(intT));
+    return byte_order::endian_array<intT, ENDIAN>(m_data + offset, count);
+  }
+
+  /**
+   * Interpret the bytes at offset as a T. Since offsets need not be aligned,
+   * T must not require any alignment, which is the case for structs made up
+   * of byte_order::endian_value and char members.
+   **/
+  template <typename T>
+  inline T const * overlay(std::size_t offset) const
+  {
+    static_assert(std::alignment_of<T>::value == 1,
+        "Overlay types must not require alignment.");
+    check_range(offset, 1, sizeof(T));
+    return reinterpret_cast<T const *>(m_data + offset);
+  }
+
+  /**
+   * Ask the kernel to start reading the given range in the background, e.g.
+   * just before processing it.
+   **/
+  inline void prefetch(std::size_t offset, std::size_t size) const
+  {
+    check_range(offset, size, 1);
+    if (!size) {
+      return;
+    }
+    // madvise() wants a page aligned address.
+    std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t start = offset - offset % page;
+    ::madvise(const_cast<char *>(m_data) + start, offset + size - start,
+        MADV_WILLNEED);
+  }
+
+private:
+  inline void check_range(std::size_t offset, std::size_t count,
+      std::size_t element_size) const
+  {
+    if (offset > m_size || count > (m_size - offset) / element_size) {
+      throw std::out_of_range("Range exceeds the size of the mapped file.");
+    }
+  }
+
+  inline void unmap()
+  {
+    if (m_data) {
+      ::munmap(const_cast<char *>(m_data), m_size);
+      m_data = nullptr;
+      m_size = 0;
+    }
+  }
+
+  char const *  m_data;
+  std::size_t   m_size;
+};
+
+} // namespace meta
+
+#endif // guard
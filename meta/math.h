@@ -29,6 +29,9 @@
 #include <meta/meta.h>
 #include <meta/inttypes.h>
 
+#include <cstddef>
+#include <stdexcept>
+
 #include <meta/comparison.h>
 
 namespace meta {
@@ -203,6 +206,409 @@ struct divide_ratios
 };
 
 
+/**
+ * Convert values between units expressed as ratios, e.g. ticks of a 24 MHz
+ * clock into nanoseconds:
+ *
+ *    typedef ratio<uint64_t, 1, 24000000> ticks;
+ *    typedef ratio<uint64_t, 1, 1000000000> nanoseconds;
+ *    uint64_t ns = convert<ticks, nanoseconds>(value);
+ *
+ * The conversion factor is cancelled down at compile time. Depending on it,
+ * the conversion is a shift, a multiplication, or a division by a constant,
+ * which compilers implement as a multiplication with its reciprocal. The
+ * value is split into a quotient and a remainder of the divisor first, so
+ * that intermediate results only overflow where the result would; where the
+ * remainder times the dividend exceeds 64 bits, a 128 bit intermediate is
+ * used.
+ *
+ * Like integer division, the result is truncated towards zero. Values may be
+ * of any of the (u)intN_t types; ratios must be positive, and the cancelled
+ * down dividend and divisor of the factor must each fit into 64 bits.
+ **/
+namespace detail {
+
+template <typename T>
+struct unsigned_type;
+
+#define META_MATH_UNSIGNED_TYPE(signed_t, unsigned_t, is_signed)  \
+  template <>                                                     \
+  struct unsigned_type<signed_t>                                  \
+  {                                                               \
+    typedef unsigned_t type;                                      \
+    static bool const SIGNED = is_signed;                         \
+  };
+
+META_MATH_UNSIGNED_TYPE(int8_t, uint8_t, true);
+META_MATH_UNSIGNED_TYPE(uint8_t, uint8_t, false);
+META_MATH_UNSIGNED_TYPE(int16_t, uint16_t, true);
+META_MATH_UNSIGNED_TYPE(uint16_t, uint16_t, false);
+META_MATH_UNSIGNED_TYPE(int32_t, uint32_t, true);
+META_MATH_UNSIGNED_TYPE(uint32_t, uint32_t, false);
+META_MATH_UNSIGNED_TYPE(int64_t, uint64_t, true);
+META_MATH_UNSIGNED_TYPE(uint64_t, uint64_t, false);
+
+#undef META_MATH_UNSIGNED_TYPE
+
+
+template <typename valueT, bool SIGNED = unsigned_type<valueT>::SIGNED>
+struct sign
+{
+  inline static bool negative(valueT value)
+  {
+    return value < 0;
+  }
+};
+
+template <typename valueT>
+struct sign<valueT, false>
+{
+  inline static bool negative(valueT)
+  {
+    return false;
+  }
+};
+
+
+/**
+ * The base 2 logarithm of N if it is a power of two, -1 otherwise.
+ **/
+template <uint64_t N>
+struct exact_log2
+{
+  static int const NEXT = exact_log2<N / 2>::VALUE;
+  static int const VALUE = (N % 2 || NEXT < 0) ? -1 : NEXT + 1;
+};
+
+template <>
+struct exact_log2<1>
+{
+  static int const VALUE = 0;
+};
+
+template <>
+struct exact_log2<0>
+{
+  static int const VALUE = -1;
+};
+
+
+/**
+ * The factor for converting from fromT to toT units, i.e. fromT / toT,
+ * cancelled down. The ratios are cancelled down already, so cancelling
+ * crosswise before multiplying yields the smallest terms.
+ **/
+template <typename fromT, typename toT>
+struct conversion_factor
+{
+  static uint64_t const FROM_DIVIDEND = uint64_t(fromT::DIVIDEND);
+  static uint64_t const FROM_DIVISOR = uint64_t(fromT::DIVISOR);
+  static uint64_t const TO_DIVIDEND = uint64_t(toT::DIVIDEND);
+  static uint64_t const TO_DIVISOR = uint64_t(toT::DIVISOR);
+
+  static uint64_t const GCD_DIVIDENDS = gcd<uint64_t, FROM_DIVIDEND,
+                 TO_DIVIDEND>::result;
+  static uint64_t const GCD_DIVISORS = gcd<uint64_t, FROM_DIVISOR,
+                 TO_DIVISOR>::result;
+
+  static uint64_t const DIVIDEND = (FROM_DIVIDEND / GCD_DIVIDENDS)
+    * (TO_DIVISOR / GCD_DIVISORS);
+  static uint64_t const DIVISOR = (FROM_DIVISOR / GCD_DIVISORS)
+    * (TO_DIVIDEND / GCD_DIVIDENDS);
+};
+
+
+enum conversion_kind
+{
+  CONVERT_SHIFT_LEFT,     // x * 2^k
+  CONVERT_MULTIPLY,       // x * N
+  CONVERT_SHIFT_RIGHT,    // x / 2^k
+  CONVERT_FRACTION,       // x * N / D, with (D - 1) * N fitting 64 bits
+  CONVERT_WIDE_FRACTION   // x * N / D otherwise
+};
+
+template <uint64_t N, uint64_t D>
+struct select_conversion
+{
+  static conversion_kind const KIND =
+    (D == 1) ?
+      (exact_log2<N>::VALUE >= 0 ? CONVERT_SHIFT_LEFT : CONVERT_MULTIPLY)
+    : (N == 1 && exact_log2<D>::VALUE >= 0) ? CONVERT_SHIFT_RIGHT
+    : (N <= ~uint64_t(0) / D) ? CONVERT_FRACTION
+    : CONVERT_WIDE_FRACTION;
+};
+
+
+// The 128 bit product of a and b, in hi and lo.
+inline void
+wide_mul(uint64_t a, uint64_t b, uint64_t & hi, uint64_t & lo)
+{
+#if defined(META_HAVE_INT128)
+  uint128_t product = uint128_t(a) * b;
+  hi = uint64_t(product >> 64);
+  lo = uint64_t(product);
+#else
+  // From 32 bit halves
+  uint64_t a_lo = a & 0xffffffffUL;
+  uint64_t a_hi = a >> 32;
+  uint64_t b_lo = b & 0xffffffffUL;
+  uint64_t b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo;
+  uint64_t mid = (lo_lo >> 32) + (a_hi * b_lo & 0xffffffffUL) + a_lo * b_hi;
+  hi = a_hi * b_hi + (a_hi * b_lo >> 32) + (mid >> 32);
+  lo = (mid << 32) | (lo_lo & 0xffffffffUL);
+#endif
+}
+
+
+// (hi * 2^64 + lo) / d and its remainder, for hi < d, so that the quotient
+// fits 64 bits.
+inline uint64_t
+wide_div(uint64_t hi, uint64_t lo, uint64_t d, uint64_t & remainder)
+{
+#if defined(META_HAVE_INT128)
+  uint128_t dividend = (uint128_t(hi) << 64) | lo;
+  remainder = uint64_t(dividend % d);
+  return uint64_t(dividend / d);
+#else
+  // Long division, bit by bit.
+  uint64_t quotient = 0;
+  for (int bit = 63 ; bit >= 0 ; --bit) {
+    bool carry = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo <<= 1;
+    if (carry || hi >= d) {
+      hi -= d;
+      quotient |= uint64_t(1) << bit;
+    }
+  }
+  remainder = hi;
+  return quotient;
+#endif
+}
+
+
+// r * n / d, for r < d
+inline uint64_t
+wide_mul_div(uint64_t r, uint64_t n, uint64_t d)
+{
+  uint64_t hi, lo, remainder;
+  wide_mul(r, n, hi, lo);
+  return wide_div(hi, lo, d, remainder);
+}
+
+
+template <uint64_t N, uint64_t D,
+         conversion_kind KIND = select_conversion<N, D>::KIND>
+struct scale;
+
+template <uint64_t N, uint64_t D>
+struct scale<N, D, CONVERT_SHIFT_LEFT>
+{
+  inline static uint64_t apply(uint64_t value)
+  {
+    return value << exact_log2<N>::VALUE;
+  }
+};
+
+template <uint64_t N, uint64_t D>
+struct scale<N, D, CONVERT_MULTIPLY>
+{
+  inline static uint64_t apply(uint64_t value)
+  {
+    return value * N;
+  }
+};
+
+template <uint64_t N, uint64_t D>
+struct scale<N, D, CONVERT_SHIFT_RIGHT>
+{
+  inline static uint64_t apply(uint64_t value)
+  {
+    return value >> exact_log2<D>::VALUE;
+  }
+};
+
+template <uint64_t N, uint64_t D>
+struct scale<N, D, CONVERT_FRACTION>
+{
+  inline static uint64_t apply(uint64_t value)
+  {
+    return (value / D) * N + ((value % D) * N) / D;
+  }
+};
+
+template <uint64_t N, uint64_t D>
+struct scale<N, D, CONVERT_WIDE_FRACTION>
+{
+  inline static uint64_t apply(uint64_t value)
+  {
+    return (value / D) * N + wide_mul_div(value % D, N, D);
+  }
+};
+
+} // namespace detail
+
+
+template <typename fromT, typename toT, typename valueT>
+inline valueT
+convert(valueT value)
+{
+  typedef detail::conversion_factor<fromT, toT> factor;
+  typedef detail::scale<factor::DIVIDEND, factor::DIVISOR> scale_t;
+  typedef typename detail::unsigned_type<valueT>::type unsigned_t;
+
+  // Scale the magnitude, so that negative values truncate towards zero.
+  if (detail::sign<valueT>::negative(value)) {
+    unsigned_t magnitude = static_cast<unsigned_t>(
+        unsigned_t(0) - static_cast<unsigned_t>(value));
+    unsigned_t result = static_cast<unsigned_t>(scale_t::apply(magnitude));
+    return static_cast<valueT>(static_cast<unsigned_t>(
+          unsigned_t(0) - result));
+  }
+  return static_cast<valueT>(static_cast<unsigned_t>(scale_t::apply(
+          static_cast<unsigned_t>(value))));
+}
+
+
+/**
+ * Convert count values; in and out may be the same array. The loop has no
+ * branches for unsigned values, so compilers can vectorize it.
+ **/
+template <typename fromT, typename toT, typename valueT>
+inline void
+convert(valueT const * in, valueT * out, std::size_t count)
+{
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    out[i] = convert<fromT, toT>(in[i]);
+  }
+}
+
+
+}} // namespace meta::math
+
+
+#include <meta/detail/divider.h>
+
+namespace meta {
+namespace math {
+
+/**
+ * Division by a divisor that is only known at runtime, but then divides many
+ * values, e.g. a bucket or shard count from the configuration:
+ *
+ *    fast_divider<uint32_t> buckets(config.buckets);
+ *    ...
+ *    uint32_t bucket = hash % buckets;
+ *
+ * The constructor computes a reciprocal of the divisor; dividing is then a
+ * multiplication and shifts, or just a shift for powers of two, instead of a
+ * hardware division. Quotients and remainders are those of the built-in
+ * operators; as with those, dividing the lowest signed value by -1
+ * overflows, and yields the lowest value.
+ *
+ * Which of the algorithms a divisor needs is decided when the divider is
+ * constructed, and checked again on every division. This branch is well
+ * predicted when dividing by the same divisor in a loop; where dividers are
+ * mixed, BRANCH_FREE dividers use the one algorithm that works for all
+ * divisors, at the cost of a subtraction, an addition and a shift more for
+ * some divisors. Compilers can also vectorize loops that divide by a
+ * BRANCH_FREE divider.
+ *
+ * Dividing arrays by 32 bit divisors uses AVX2 where available.
+ *
+ * intT may be any of (u)int32_t and (u)int64_t.
+ **/
+template <typename intT, bool BRANCH_FREE = false>
+class fast_divider
+{
+public:
+  typedef intT value_type;
+
+  explicit inline fast_divider(intT divisor)
+    : m_divisor(divisor)
+  {
+    if (!divisor) {
+      throw std::invalid_argument("Division by zero.");
+    }
+    typedef typename detail::unsigned_type<intT>::type unsigned_t;
+    unsigned_t sign = detail::sign_mask(divisor);
+    m_params = detail::make_divider_params(
+        unsigned_t((unsigned_t(divisor) ^ sign) - sign), BRANCH_FREE);
+  }
+
+  inline intT divisor() const
+  {
+    return m_divisor;
+  }
+
+  inline intT divide(intT value) const
+  {
+    return apply<false>(value);
+  }
+
+  inline intT modulo(intT value) const
+  {
+    return apply<true>(value);
+  }
+
+  /**
+   * Divide count values, or take them modulo the divisor; in and out may be
+   * the same array.
+   **/
+  inline void divide(intT const * in, intT * out, std::size_t count) const
+  {
+    detail::divide(m_params, m_divisor, in, out, count, false);
+  }
+
+  inline void modulo(intT const * in, intT * out, std::size_t count) const
+  {
+    detail::divide(m_params, m_divisor, in, out, count, true);
+  }
+
+private:
+  template <bool REMAINDER>
+  inline intT apply(intT value) const
+  {
+    if (BRANCH_FREE) {
+      return detail::divide_value<detail::DIVIDE_MULTIPLY_ADD, REMAINDER>(
+          m_params, m_divisor, value);
+    }
+
+    switch (m_params.algorithm) {
+      case detail::DIVIDE_SHIFT:
+        return detail::divide_value<detail::DIVIDE_SHIFT, REMAINDER>(
+            m_params, m_divisor, value);
+
+      case detail::DIVIDE_MULTIPLY:
+        return detail::divide_value<detail::DIVIDE_MULTIPLY, REMAINDER>(
+            m_params, m_divisor, value);
+
+      default:
+        return detail::divide_value<detail::DIVIDE_MULTIPLY_ADD, REMAINDER>(
+            m_params, m_divisor, value);
+    }
+  }
+
+  intT                                                              m_divisor;
+  detail::divider_params<typename detail::unsigned_type<intT>::type> m_params;
+};
+
+
+template <typename intT, bool BRANCH_FREE>
+inline intT
+operator/(intT value, fast_divider<intT, BRANCH_FREE> const & divider)
+{
+  return divider.divide(value);
+}
+
+template <typename intT, bool BRANCH_FREE>
+inline intT
+operator%(intT value, fast_divider<intT, BRANCH_FREE> const & divider)
+{
+  return divider.modulo(value);
+}
+
 }} // namespace meta::math
 
 #endif // guard
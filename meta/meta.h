@@ -60,6 +60,17 @@
   #define META_PLATFORM_DEFINED
 #endif
 
+/**
+ * Can we dispatch to x86 SIMD kernels at runtime? This requires a compiler
+ * that understands per-function target attributes and __builtin_cpu_supports.
+ * Define META_NO_SIMD to restrict meta to portable code.
+ **/
+#if !defined(META_X86_SIMD) && !defined(META_NO_SIMD)
+  #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define META_X86_SIMD
+  #endif
+#endif
+
 /**
  * Decide what to include globally
  **/
@@ -75,6 +86,30 @@
   #endif
 #endif
 
+/**
+ * constexpr is only available in C++11 mode; code that should be usable in
+ * both modes can use META_CONSTEXPR instead.
+ **/
+#if META_CXX_MODE == META_CXX_MODE_CXX0X
+  #define META_CONSTEXPR constexpr
+#else
+  #define META_CONSTEXPR
+#endif
+
+/**
+ * Can constexpr functions tell whether they are evaluated at compile time?
+ * If so, they can choose an implementation suited to runtime there.
+ **/
+#if defined(__has_builtin)
+  #if __has_builtin(__builtin_is_constant_evaluated)
+    #define META_HAVE_CONSTANT_EVALUATED
+  #endif
+#endif
+#if !defined(META_HAVE_CONSTANT_EVALUATED) && defined(__GNUC__) \
+  && !defined(__clang__) && __GNUC__ >= 9
+  #define META_HAVE_CONSTANT_EVALUATED
+#endif
+
 /**
  * Enum classes may be supported in C++11 mode, and are required in some cases
  * on Windows. We'd like to abort compilation on Windows if not in C++11 mode,
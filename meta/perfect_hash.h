@@ -0,0 +1,722 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_PERFECT_HASH_H
+#define META_PERFECT_HASH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/perfect_hash.h because there's no C++11 support.
+#endif
+
+#include <stdexcept>
+#include <string>
+#include <cstring>
+
+#include <meta/hash.h>
+
+namespace meta {
+namespace hash {
+
+/**
+ * A key/value pair for perfect_map. Keys are string literals; their size is
+ * taken from the literal.
+ **/
+template <typename valueT>
+struct perfect_entry
+{
+  char const *  key;
+  std::size_t   size;
+  valueT        value;
+
+  // Empty slots have a size no key can match.
+  META_CONSTEXPR perfect_entry()
+    : key(nullptr)
+    , size(~std::size_t(0))
+    , value()
+  {
+  }
+
+  template <std::size_t SIZE>
+  META_CONSTEXPR perfect_entry(char const (& _key)[SIZE], valueT const & _value)
+    : key(_key)
+    , size(SIZE - 1)
+    , value(_value)
+  {
+  }
+};
+
+
+namespace detail {
+
+/**
+ * Index packs for building arrays element by element; created by halving, so
+ * that large tables do not exceed the template instantiation depth.
+ **/
+template <std::size_t... I>
+struct indices
+{
+};
+
+template <typename leftT, typename rightT>
+struct concat_indices;
+
+template <std::size_t... L, std::size_t... R>
+struct concat_indices<indices<L...>, indices<R...> >
+{
+  typedef indices<L..., (sizeof...(L) + R)...> type;
+};
+
+template <std::size_t N>
+struct make_indices
+{
+  typedef typename concat_indices<
+    typename make_indices<N / 2>::type,
+    typename make_indices<N - N / 2>::type
+  >::type type;
+};
+
+template <>
+struct make_indices<0>
+{
+  typedef indices<> type;
+};
+
+template <>
+struct make_indices<1>
+{
+  typedef indices<0> type;
+};
+
+
+/**
+ * Table geometry: keys are distributed over about half as many buckets, and
+ * placed into a power of two number of slots, at most 80% of which are used.
+ **/
+static std::size_t const NONE = ~std::size_t(0);
+static std::size_t const MAX_DISPLACEMENT = 1 << 16;
+
+inline META_CONSTEXPR std::size_t
+next_pow2(std::size_t value, std::size_t result = 1)
+{
+  return result >= value ? result : next_pow2(value, result * 2);
+}
+
+template <std::size_t N>
+struct chd_geometry
+{
+  static std::size_t const BUCKETS = (N + 1) / 2;
+  static std::size_t const SLOTS = next_pow2(N + N / 4 + 1);
+  static std::size_t const WORDS = (SLOTS + 63) / 64;
+};
+
+template <std::size_t N>
+inline META_CONSTEXPR std::size_t
+chd_bucket(uint64_t hash)
+{
+  return static_cast<std::size_t>(((hash >> 32) * chd_geometry<N>::BUCKETS)
+      >> 32);
+}
+
+template <std::size_t N>
+inline META_CONSTEXPR std::size_t
+chd_slot(uint64_t hash, std::size_t displacement)
+{
+  return static_cast<std::size_t>(mixer<8>::mix(hash
+        + displacement * mixer<8>::golden) & (chd_geometry<N>::SLOTS - 1));
+}
+
+
+inline META_CONSTEXPR bool
+equal(char const * a, char const * b, std::size_t size)
+{
+  return !size || (*a == *b && equal(a + 1, b + 1, size - 1));
+}
+
+
+template <typename T, std::size_t N>
+struct const_array
+{
+  T data[N];
+
+  META_CONSTEXPR T operator[](std::size_t index) const
+  {
+    return data[index];
+  }
+};
+
+
+/**
+ * Building the table happens in stages, each of which fills an array with
+ * the results of a constexpr function per element. Loops over ranges recurse
+ * into both halves of the range, which keeps the recursion depth logarithmic.
+ *
+ * Grouping and ordering is done by sorting 64 bit sort keys, which combine
+ * the value to sort by in the upper half with an index in the lower half.
+ * That makes all sort keys unique.
+ **/
+inline META_CONSTEXPR uint64_t
+sort_key(uint64_t value, std::size_t index)
+{
+  return (value << 32) | index;
+}
+
+inline META_CONSTEXPR std::size_t
+sort_value(uint64_t key)
+{
+  return static_cast<std::size_t>(key >> 32);
+}
+
+inline META_CONSTEXPR std::size_t
+sort_index(uint64_t key)
+{
+  return static_cast<std::size_t>(key & 0xffffffffULL);
+}
+
+
+/**
+ * A bottom-up merge sort. Each output element of a pass is computed on its
+ * own: the k-th element of two merged runs is found by binary searching for
+ * the number of elements it takes from the first run.
+ **/
+template <std::size_t N>
+inline META_CONSTEXPR std::size_t
+merge_split(const_array<uint64_t, N> const & in, std::size_t a,
+    std::size_t b, std::size_t b_len, std::size_t k, std::size_t first,
+    std::size_t last)
+{
+  return first >= last ? first
+    : (k - (first + last + 1) / 2 >= b_len
+        || in.data[a + (first + last + 1) / 2 - 1]
+          < in.data[b + k - (first + last + 1) / 2])
+      ? merge_split<N>(in, a, b, b_len, k, (first + last + 1) / 2, last)
+      : merge_split<N>(in, a, b, b_len, k, first, (first + last + 1) / 2 - 1);
+}
+
+template <std::size_t N>
+inline META_CONSTEXPR uint64_t
+merge_pick(const_array<uint64_t, N> const & in, std::size_t a,
+    std::size_t a_len, std::size_t b, std::size_t b_len, std::size_t k,
+    std::size_t taken)
+{
+  return taken < a_len
+      && (k - taken >= b_len || in.data[a + taken] < in.data[b + k - taken])
+    ? in.data[a + taken]
+    : in.data[b + k - taken];
+}
+
+template <std::size_t N>
+inline META_CONSTEXPR uint64_t
+merge_runs(const_array<uint64_t, N> const & in, std::size_t a,
+    std::size_t a_len, std::size_t b_len, std::size_t k)
+{
+  return merge_pick<N>(in, a, a_len, a + a_len, b_len, k,
+      merge_split<N>(in, a, a + a_len, b_len, k,
+        k > b_len ? k - b_len : 0,
+        k < a_len ? k : a_len));
+}
+
+template <std::size_t N>
+inline META_CONSTEXPR uint64_t
+merged(const_array<uint64_t, N> const & in, std::size_t width,
+    std::size_t base, std::size_t k)
+{
+  return merge_runs<N>(in, base,
+      width < N - base ? width : N - base,
+      base + width >= N ? 0
+        : width < N - base - width ? width : N - base - width,
+      k);
+}
+
+template <std::size_t N, std::size_t... I>
+inline META_CONSTEXPR const_array<uint64_t, N>
+merge_pass(const_array<uint64_t, N> const & in, std::size_t width,
+    indices<I...>)
+{
+  return const_array<uint64_t, N>{ {
+    merged<N>(in, width, I - I % (2 * width), I % (2 * width))...
+  } };
+}
+
+template <std::size_t N>
+inline META_CONSTEXPR const_array<uint64_t, N>
+merge_sort(const_array<uint64_t, N> const & in, std::size_t width = 1)
+{
+  return width >= N ? in
+    : merge_sort<N>(merge_pass<N>(in, width,
+          typename make_indices<N>::type()), width * 2);
+}
+
+// The first position in the sorted range whose sort key is not below key.
+template <std::size_t N>
+inline META_CONSTEXPR std::size_t
+lower_bound(const_array<uint64_t, N> const & sorted, uint64_t key,
+    std::size_t first = 0, std::size_t last = N)
+{
+  return first >= last ? first
+    : sorted.data[(first + last) / 2] < key
+      ? lower_bound<N>(sorted, key, (first + last) / 2 + 1, last)
+      : lower_bound<N>(sorted, key, first, (first + last) / 2);
+}
+
+
+/**
+ * First, the key hashes, and the keys grouped by bucket.
+ **/
+template <std::size_t N>
+struct chd_keys
+{
+  const_array<uint64_t, N>  hash;
+  const_array<uint64_t, N>  by_bucket;
+};
+
+template <typename valueT, std::size_t N, std::size_t... I>
+inline META_CONSTEXPR const_array<uint64_t, N>
+hash_keys(perfect_entry<valueT> const * entries, indices<I...>)
+{
+  return const_array<uint64_t, N>{ {
+    key_hash(entries[I].key, entries[I].size)...
+  } };
+}
+
+template <std::size_t N, std::size_t... I>
+inline META_CONSTEXPR chd_keys<N>
+group_keys(const_array<uint64_t, N> const & hash, indices<I...>)
+{
+  return chd_keys<N>{
+    hash,
+    merge_sort<N>(const_array<uint64_t, N>{ {
+      sort_key(chd_bucket<N>(hash.data[I]), I)...
+    } }),
+  };
+}
+
+
+/**
+ * Second, where each bucket's keys start, and the order in which buckets are
+ * placed: largest first, as those are the hardest to place.
+ **/
+template <std::size_t B>
+struct chd_buckets
+{
+  const_array<std::size_t, B + 1> start;
+  const_array<uint64_t, B>        order;
+};
+
+template <std::size_t N, std::size_t B, std::size_t... BI>
+inline META_CONSTEXPR const_array<std::size_t, B + 1>
+bucket_starts(chd_keys<N> const & keys, indices<BI...>)
+{
+  return const_array<std::size_t, B + 1>{ {
+    lower_bound<N>(keys.by_bucket, sort_key(BI, 0))...
+  } };
+}
+
+template <std::size_t N, std::size_t B, std::size_t... BI>
+inline META_CONSTEXPR chd_buckets<B>
+order_buckets(const_array<std::size_t, B + 1> const & start, indices<BI...>)
+{
+  return chd_buckets<B>{
+    start,
+    merge_sort<B>(const_array<uint64_t, B>{ {
+      sort_key(N - (start.data[BI + 1] - start.data[BI]), BI)...
+    } }),
+  };
+}
+
+template <typename bucketsT>
+inline META_CONSTEXPR std::size_t
+bucket_size(bucketsT const & buckets, std::size_t bucket)
+{
+  return buckets.start.data[bucket + 1] - buckets.start.data[bucket];
+}
+
+template <typename keysT, typename bucketsT>
+inline META_CONSTEXPR uint64_t
+member_hash(keysT const & keys, bucketsT const & buckets, std::size_t bucket,
+    std::size_t member)
+{
+  return keys.hash.data[sort_index(
+      keys.by_bucket.data[buckets.start.data[bucket] + member])];
+}
+
+
+/**
+ * Third, find a displacement for each bucket that moves all of its keys into
+ * slots that are still free. The state holds a bitmap of used slots and the
+ * displacements found so far.
+ **/
+template <std::size_t W, std::size_t B>
+struct chd_state
+{
+  const_array<uint64_t, W>  used;
+  const_array<uint16_t, B>  displacement;
+};
+
+template <std::size_t N, typename keysT, typename bucketsT>
+inline META_CONSTEXPR std::size_t
+member_slot(keysT const & keys, bucketsT const & buckets, std::size_t bucket,
+    std::size_t member, std::size_t displacement)
+{
+  return chd_slot<N>(member_hash(keys, buckets, bucket, member), displacement);
+}
+
+template <std::size_t N, typename keysT, typename bucketsT, typename stateT>
+inline META_CONSTEXPR bool
+slot_conflicts(keysT const & keys, bucketsT const & buckets,
+    stateT const & state, std::size_t bucket, std::size_t member,
+    std::size_t displacement, std::size_t slot)
+{
+  // Used by an earlier bucket, or by an earlier member of this bucket
+  return member == 0
+    ? ((state.used.data[slot / 64] >> (slot % 64)) & 1) != 0
+    : (member_slot<N>(keys, buckets, bucket, member - 1, displacement) == slot
+       || slot_conflicts<N>(keys, buckets, state, bucket, member - 1,
+         displacement, slot));
+}
+
+template <std::size_t N, typename keysT, typename bucketsT, typename stateT>
+inline META_CONSTEXPR bool
+fits(keysT const & keys, bucketsT const & buckets, stateT const & state,
+    std::size_t bucket, std::size_t members, std::size_t displacement)
+{
+  return !members
+    || (!slot_conflicts<N>(keys, buckets, state, bucket, members - 1,
+          displacement,
+          member_slot<N>(keys, buckets, bucket, members - 1, displacement))
+        && fits<N>(keys, buckets, state, bucket, members - 1, displacement));
+}
+
+// The second half of the range is only searched if the first half yields
+// no result.
+template <std::size_t N, typename keysT, typename bucketsT, typename stateT>
+inline META_CONSTEXPR std::size_t
+find_displacement(keysT const & keys, bucketsT const & buckets,
+    stateT const & state, std::size_t bucket, std::size_t first,
+    std::size_t last);
+
+template <std::size_t N, typename keysT, typename bucketsT, typename stateT>
+inline META_CONSTEXPR std::size_t
+continue_search(keysT const & keys, bucketsT const & buckets,
+    stateT const & state, std::size_t bucket, std::size_t found,
+    std::size_t first, std::size_t last)
+{
+  return found != NONE ? found
+    : find_displacement<N>(keys, buckets, state, bucket, first, last);
+}
+
+template <std::size_t N, typename keysT, typename bucketsT, typename stateT>
+inline META_CONSTEXPR std::size_t
+find_displacement(keysT const & keys, bucketsT const & buckets,
+    stateT const & state, std::size_t bucket, std::size_t first,
+    std::size_t last)
+{
+  return last - first <= 1
+    ? (fits<N>(keys, buckets, state, bucket, bucket_size(buckets, bucket), first)
+        ? first : NONE)
+    : continue_search<N>(keys, buckets, state, bucket,
+        find_displacement<N>(keys, buckets, state, bucket, first,
+          (first + last) / 2),
+        (first + last) / 2, last);
+}
+
+template <std::size_t N, typename keysT, typename bucketsT>
+inline META_CONSTEXPR uint64_t
+used_bits(keysT const & keys, bucketsT const & buckets, std::size_t bucket,
+    std::size_t members, std::size_t displacement, std::size_t word)
+{
+  return !members ? 0
+    : (used_bits<N>(keys, buckets, bucket, members - 1, displacement, word)
+       | (member_slot<N>(keys, buckets, bucket, members - 1, displacement) / 64
+           == word
+         ? uint64_t(1) << (member_slot<N>(keys, buckets, bucket, members - 1,
+             displacement) % 64)
+         : 0));
+}
+
+template <std::size_t N, typename keysT, typename bucketsT, std::size_t W,
+         std::size_t B, std::size_t... WI, std::size_t... BI>
+inline META_CONSTEXPR chd_state<W, B>
+place_bucket(keysT const & keys, bucketsT const & buckets,
+    chd_state<W, B> const & state, std::size_t bucket,
+    std::size_t displacement, indices<WI...>, indices<BI...>)
+{
+  return displacement == NONE
+    ? throw std::logic_error("Could not find a perfect hash function.")
+    : chd_state<W, B>{
+        { { state.used.data[WI] | used_bits<N>(keys, buckets, bucket,
+              bucket_size(buckets, bucket), displacement, WI)... } },
+        { { (BI == bucket ? static_cast<uint16_t>(displacement)
+              : state.displacement.data[BI])... } },
+      };
+}
+
+// Identical keys have identical hashes, and so end up in the same bucket.
+template <std::size_t N, typename keysT, typename bucketsT>
+inline META_CONSTEXPR bool
+same_hash(keysT const & keys, bucketsT const & buckets, std::size_t bucket,
+    std::size_t member, std::size_t other)
+{
+  return other < member
+    && (member_hash(keys, buckets, bucket, member)
+          == member_hash(keys, buckets, bucket, other)
+        || same_hash<N>(keys, buckets, bucket, member, other + 1));
+}
+
+template <std::size_t N, typename keysT, typename bucketsT>
+inline META_CONSTEXPR bool
+has_duplicates(keysT const & keys, bucketsT const & buckets,
+    std::size_t bucket, std::size_t members)
+{
+  return members > 1
+    && (same_hash<N>(keys, buckets, bucket, members - 1, 0)
+        || has_duplicates<N>(keys, buckets, bucket, members - 1));
+}
+
+template <std::size_t N, typename keysT, typename bucketsT, std::size_t W,
+         std::size_t B>
+inline META_CONSTEXPR chd_state<W, B>
+place_ordered(keysT const & keys, bucketsT const & buckets,
+    chd_state<W, B> const & state, std::size_t bucket)
+{
+  return has_duplicates<N>(keys, buckets, bucket, bucket_size(buckets, bucket))
+    ? throw std::logic_error("Duplicate keys in perfect_map.")
+    : place_bucket<N>(keys, buckets, state, bucket,
+        find_displacement<N>(keys, buckets, state, bucket, 0,
+          MAX_DISPLACEMENT),
+        typename make_indices<W>::type(), typename make_indices<B>::type());
+}
+
+// Buckets are placed in order; empty buckets sort last.
+template <std::size_t N, typename keysT, typename bucketsT, std::size_t W,
+         std::size_t B>
+inline META_CONSTEXPR chd_state<W, B>
+place_buckets(keysT const & keys, bucketsT const & buckets,
+    chd_state<W, B> const & state, std::size_t first, std::size_t last)
+{
+  return last - first <= 1
+    ? (first < last && sort_value(buckets.order.data[first]) < N
+        ? place_ordered<N>(keys, buckets, state,
+            sort_index(buckets.order.data[first]))
+        : state)
+    : place_buckets<N>(keys, buckets,
+        place_buckets<N>(keys, buckets, state, first, (first + last) / 2),
+        (first + last) / 2, last);
+}
+
+} // namespace detail
+
+
+/**
+ * A read-only map from strings to values of a literal type, built entirely at
+ * compile time from a fixed set of keys:
+ *
+ *    constexpr perfect_entry<int> opcode_entries[] = {
+ *      { "ADD", 1 }, { "SUB", 2 }, { "JMP", 3 },
+ *    };
+ *    constexpr auto opcodes = make_perfect_map(opcode_entries);
+ *
+ *    int const * code = opcodes.find(name);
+ *
+ * The map is a perfect hash table in the style of CHD ("compress, hash and
+ * displace"): keys are distributed into buckets, and each bucket stores a
+ * displacement that moves its keys into slots no other key uses. A lookup
+ * hashes the key once with key_hash(), reads the bucket's displacement, and
+ * compares the key against the one entry in the slot it maps to. There are
+ * no allocations and nothing happens at startup; the map is a flat static
+ * array.
+ *
+ * Lookups are constexpr, too, so the map can be used in static_assert().
+ *
+ * Duplicate keys, or failure to find displacements, make construction fail
+ * to compile. Placing the buckets takes time roughly quadratic in the number
+ * of keys; up to about a thousand keys build within GCC's default constexpr
+ * limits.
+ **/
+template <typename valueT, std::size_t N>
+class perfect_map
+{
+  static_assert(N > 0, "A perfect_map needs at least one key.");
+
+public:
+  typedef valueT                    value_type;
+  typedef perfect_entry<valueT>     entry_type;
+
+  static std::size_t const BUCKETS = detail::chd_geometry<N>::BUCKETS;
+  static std::size_t const SLOTS = detail::chd_geometry<N>::SLOTS;
+
+  template <std::size_t W, std::size_t... BI, std::size_t... SI>
+  META_CONSTEXPR perfect_map(entry_type const * entries,
+      detail::chd_state<W, BUCKETS> const & state,
+      detail::const_array<uint64_t, N> const & positions,
+      detail::indices<BI...>, detail::indices<SI...>)
+    : m_displacement{ state.displacement.data[BI]... }
+    , m_slots{ slot_entry(entries, positions, SI)... }
+  {
+  }
+
+  META_CONSTEXPR std::size_t size() const
+  {
+    return N;
+  }
+
+  /**
+   * Returns a pointer to the value for the given key, or nullptr if the key
+   * is not in the map.
+   **/
+  META_CONSTEXPR valueT const * find(char const * key, std::size_t size) const
+  {
+    return match(m_slots[slot(key_hash(key, size))], key, size);
+  }
+
+  inline valueT const * find(std::string const & key) const
+  {
+    entry_type const & entry = m_slots[slot(key_hash(key))];
+    if (entry.size != key.size()
+        || std::memcmp(entry.key, key.data(), key.size())) {
+      return nullptr;
+    }
+    return &entry.value;
+  }
+
+  META_CONSTEXPR bool contains(char const * key, std::size_t size) const
+  {
+    return find(key, size) != nullptr;
+  }
+
+  inline bool contains(std::string const & key) const
+  {
+    return find(key) != nullptr;
+  }
+
+private:
+  // Positions are sort keys of slot and key index, sorted by slot.
+  static META_CONSTEXPR entry_type
+  slot_entry(entry_type const * entries,
+      detail::const_array<uint64_t, N> const & positions, std::size_t slot)
+  {
+    return entry_at(entries, positions, slot,
+        detail::lower_bound<N>(positions, detail::sort_key(slot, 0)));
+  }
+
+  static META_CONSTEXPR entry_type
+  entry_at(entry_type const * entries,
+      detail::const_array<uint64_t, N> const & positions, std::size_t slot,
+      std::size_t index)
+  {
+    return index < N && detail::sort_value(positions.data[index]) == slot
+      ? entries[detail::sort_index(positions.data[index])]
+      : entry_type();
+  }
+
+  META_CONSTEXPR std::size_t slot(uint64_t hash) const
+  {
+    return detail::chd_slot<N>(hash,
+        m_displacement[detail::chd_bucket<N>(hash)]);
+  }
+
+  META_CONSTEXPR valueT const * match(entry_type const & entry,
+      char const * key, std::size_t size) const
+  {
+    return entry.size == size && detail::equal(entry.key, key, size)
+      ? &entry.value : nullptr;
+  }
+
+  uint16_t    m_displacement[BUCKETS];
+  entry_type  m_slots[SLOTS];
+};
+
+
+namespace detail {
+
+/**
+ * Finally, the slot each key ends up in, from which the table is filled.
+ **/
+template <std::size_t N, typename stateT, std::size_t... KI>
+inline META_CONSTEXPR const_array<uint64_t, N>
+key_slots(chd_keys<N> const & keys, stateT const & state, indices<KI...>)
+{
+  return merge_sort<N>(const_array<uint64_t, N>{ {
+    sort_key(chd_slot<N>(keys.hash.data[KI],
+        state.displacement.data[chd_bucket<N>(keys.hash.data[KI])]), KI)...
+  } });
+}
+
+template <typename valueT, std::size_t N, typename stateT>
+inline META_CONSTEXPR perfect_map<valueT, N>
+fill_perfect_map(perfect_entry<valueT> const * entries,
+    chd_keys<N> const & keys, stateT const & state)
+{
+  return perfect_map<valueT, N>(entries, state,
+      key_slots<N>(keys, state, typename make_indices<N>::type()),
+      typename make_indices<chd_geometry<N>::BUCKETS>::type(),
+      typename make_indices<chd_geometry<N>::SLOTS>::type());
+}
+
+template <typename valueT, std::size_t N, std::size_t B>
+inline META_CONSTEXPR perfect_map<valueT, N>
+build_perfect_map(perfect_entry<valueT> const * entries,
+    chd_keys<N> const & keys, chd_buckets<B> const & buckets)
+{
+  typedef chd_geometry<N> geometry;
+  typedef chd_state<geometry::WORDS, B> state_type;
+
+  return fill_perfect_map<valueT, N>(entries, keys,
+      place_buckets<N>(keys, buckets, state_type{ { { 0 } }, { { 0 } } },
+        0, B));
+}
+
+template <typename valueT, std::size_t N>
+inline META_CONSTEXPR perfect_map<valueT, N>
+build_perfect_map(perfect_entry<valueT> const * entries,
+    chd_keys<N> const & keys)
+{
+  typedef chd_geometry<N> geometry;
+
+  return build_perfect_map<valueT, N>(entries, keys,
+      order_buckets<N, geometry::BUCKETS>(
+        bucket_starts<N, geometry::BUCKETS>(keys,
+          typename make_indices<geometry::BUCKETS + 1>::type()),
+        typename make_indices<geometry::BUCKETS>::type()));
+}
+
+} // namespace detail
+
+
+template <typename valueT, std::size_t N>
+inline META_CONSTEXPR perfect_map<valueT, N>
+make_perfect_map(perfect_entry<valueT> const (& entries)[N])
+{
+  typedef typename detail::make_indices<N>::type key_indices;
+
+  return detail::build_perfect_map<valueT, N>(entries,
+      detail::group_keys<N>(
+        detail::hash_keys<valueT, N>(entries, key_indices()),
+        key_indices()));
+}
+
+}} // namespace meta::hash
+
+#endif // guard
@@ -0,0 +1,361 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_RECORD_SWAP_H
+#define META_RECORD_SWAP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/record_swap.h because there's no C++11 support.
+#endif
+
+#include <stdexcept>
+#include <cstddef>
+#include <cstring>
+
+#include <meta/byteorder.h>
+#include <meta/typelist.h>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+namespace meta {
+namespace byte_order {
+
+/**
+ * Describes a field of type T at byte offset OFFSET within a record. A record
+ * layout is a meta::types::typelist of fields; fields not in the layout (and
+ * padding) are left untouched by the functions below.
+ *
+ *    struct record
+ *    {
+ *      uint32_t  id;
+ *      char      name[10];
+ *      uint16_t  flags;
+ *      double    value;
+ *    };
+ *
+ *    typedef meta::types::typelist<
+ *      META_RECORD_FIELD(record, id),
+ *      META_RECORD_FIELD(record, flags),
+ *      META_RECORD_FIELD(record, value)
+ *    > record_layout;
+ *
+ *    swap_records<record_layout>(records, count);
+ **/
+template <typename T, std::size_t OFFSET>
+struct field
+{
+  typedef T type;
+  static std::size_t const offset = OFFSET;
+};
+
+#define META_RECORD_FIELD(recordT, member)                \
+  ::meta::byte_order::field<                              \
+    decltype(recordT::member),                            \
+    offsetof(recordT, member)                             \
+  >
+
+
+namespace detail {
+
+/**
+ * Compile-time iteration over a record layout; swap_record() swaps the fields
+ * of a single record, describe() passes each field's offset and size to a
+ * functor. extent is the end of the last field, i.e. the smallest stride the
+ * layout fits into.
+ **/
+template <typename layoutT>
+struct layout_helper;
+
+template <>
+struct layout_helper<types::typelist<>>
+{
+  static std::size_t const extent = 0;
+
+  inline static void swap_record(char *)
+  {
+  }
+
+  template <typename funcT>
+  inline static void describe(funcT &)
+  {
+  }
+};
+
+template <typename Head, typename... Tail>
+struct layout_helper<types::typelist<Head, Tail...>>
+{
+  static std::size_t const head_end = Head::offset
+    + sizeof(typename Head::type);
+  static std::size_t const tail_extent
+    = layout_helper<types::typelist<Tail...>>::extent;
+  static std::size_t const extent = head_end > tail_extent ? head_end
+    : tail_extent;
+
+  inline static void swap_record(char * record)
+  {
+    typedef typename uint_of_size<sizeof(typename Head::type)>::type uint_t;
+
+    uint_t tmp;
+    std::memcpy(&tmp, record + Head::offset, sizeof(uint_t));
+    tmp = swap(tmp);
+    std::memcpy(record + Head::offset, &tmp, sizeof(uint_t));
+
+    layout_helper<types::typelist<Tail...>>::swap_record(record);
+  }
+
+  template <typename funcT>
+  inline static void describe(funcT & func)
+  {
+    func(Head::offset, sizeof(typename Head::type));
+    layout_helper<types::typelist<Tail...>>::describe(func);
+  }
+};
+
+
+/**
+ * The vector kernels process the buffer in periods of lcm(stride, vector
+ * width) bytes, each of which holds a whole number of records. That lets us
+ * precompute one shuffle mask per vector in the period, as long as the period
+ * isn't too long and no field straddles a 16 byte lane.
+ **/
+static std::size_t const MAX_RECORD_PERIOD = 512;
+
+inline std::size_t
+runtime_gcd(std::size_t a, std::size_t b)
+{
+  while (b) {
+    std::size_t tmp = a % b;
+    a = b;
+    b = tmp;
+  }
+  return a;
+}
+
+
+struct record_mask_builder
+{
+  char *      mask;
+  std::size_t period;
+  std::size_t stride;
+  bool        valid;
+
+  inline void operator()(std::size_t offset, std::size_t size)
+  {
+    if (size < 2) {
+      return;
+    }
+    for (std::size_t record = 0 ; record < period ; record += stride) {
+      std::size_t start = record + offset;
+      if (start / 16 != (start + size - 1) / 16) {
+        valid = false;
+        return;
+      }
+      for (std::size_t i = 0 ; i < size ; ++i) {
+        mask[start + i] = static_cast<char>((start + size - 1 - i) % 16);
+      }
+    }
+  }
+};
+
+
+template <typename layoutT>
+inline bool
+build_record_mask(char * mask, std::size_t period, std::size_t stride)
+{
+  for (std::size_t i = 0 ; i < period ; ++i) {
+    mask[i] = static_cast<char>(i % 16);
+  }
+
+  record_mask_builder builder = { mask, period, stride, true };
+  layout_helper<layoutT>::describe(builder);
+  return builder.valid;
+}
+
+
+/**
+ * Kernels return the number of bytes processed, which is always a multiple
+ * of the period.
+ **/
+typedef std::size_t (*record_swap_func)(char *, std::size_t, char const *,
+    std::size_t);
+
+#if defined(META_X86_SIMD)
+
+__attribute__((target("ssse3")))
+inline std::size_t
+ssse3_record_swap(char * data, std::size_t size, char const * mask,
+    std::size_t period)
+{
+  std::size_t done = 0;
+  for ( ; done + period <= size ; done += period) {
+    for (std::size_t offset = 0 ; offset < period ; offset += 16) {
+      __m128i m = _mm_loadu_si128(
+          reinterpret_cast<__m128i const *>(mask + offset));
+      __m128i * p = reinterpret_cast<__m128i *>(data + done + offset);
+      _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), m));
+    }
+  }
+  return done;
+}
+
+
+
+__attribute__((target("avx2")))
+inline std::size_t
+avx2_record_swap(char * data, std::size_t size, char const * mask,
+    std::size_t period)
+{
+  std::size_t done = 0;
+  for ( ; done + period <= size ; done += period) {
+    for (std::size_t offset = 0 ; offset < period ; offset += 32) {
+      __m256i m = _mm256_loadu_si256(
+          reinterpret_cast<__m256i const *>(mask + offset));
+      __m256i * p = reinterpret_cast<__m256i *>(data + done + offset);
+      _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), m));
+    }
+  }
+  return done;
+}
+
+#endif // META_X86_SIMD
+
+
+struct record_kernel
+{
+  std::size_t       width;
+  record_swap_func  func;
+};
+
+inline record_kernel
+select_record_kernel()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return record_kernel{ 32, &avx2_record_swap };
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return record_kernel{ 16, &ssse3_record_swap };
+  }
+#endif
+  return record_kernel{ 0, nullptr };
+}
+
+} // namespace detail
+
+
+/**
+ * Swap the byte order of the fields described by layoutT in count records
+ * that are stride bytes apart. Fields must lie entirely within the first
+ * stride bytes of each record.
+ *
+ * Where the CPU supports it and the stride allows it, several records are
+ * swapped at once with SSSE3 or AVX2 shuffles; otherwise, each field of each
+ * record is swapped individually.
+ *
+ * Throws std::invalid_argument if the stride is zero, or too small for the
+ * fields of layoutT.
+ **/
+template <typename layoutT>
+inline void
+swap_records(void * records, std::size_t count, std::size_t stride)
+{
+  if (!stride || stride < detail::layout_helper<layoutT>::extent) {
+    throw std::invalid_argument("The stride is too small for the record "
+        "layout.");
+  }
+
+  char * data = static_cast<char *>(records);
+  std::size_t done = 0;
+
+  static detail::record_kernel const kernel = detail::select_record_kernel();
+  if (kernel.func) {
+    std::size_t period = stride / detail::runtime_gcd(stride, kernel.width)
+      * kernel.width;
+    if (period <= detail::MAX_RECORD_PERIOD && count * stride >= 2 * period) {
+      char mask[detail::MAX_RECORD_PERIOD];
+      if (detail::build_record_mask<layoutT>(mask, period, stride)) {
+        done = kernel.func(data, count * stride, mask, period) / stride;
+      }
+    }
+  }
+
+  for (std::size_t i = done ; i < count ; ++i) {
+    detail::layout_helper<layoutT>::swap_record(data + i * stride);
+  }
+}
+
+template <typename layoutT, typename recordT>
+inline void
+swap_records(recordT * records, std::size_t count)
+{
+  swap_records<layoutT>(static_cast<void *>(records), count, sizeof(recordT));
+}
+
+
+/**
+ * Convert records between host byte order and the given byte order, see
+ * to_host() and from_host().
+ **/
+template <typename layoutT>
+inline void
+to_host_records(void * records, std::size_t count, std::size_t stride,
+    endian records_endian)
+{
+  if (records_endian != host_byte_order()) {
+    swap_records<layoutT>(records, count, stride);
+  }
+}
+
+template <typename layoutT, typename recordT>
+inline void
+to_host_records(recordT * records, std::size_t count, endian records_endian)
+{
+  to_host_records<layoutT>(static_cast<void *>(records), count,
+      sizeof(recordT), records_endian);
+}
+
+template <typename layoutT>
+inline void
+from_host_records(void * records, std::size_t count, std::size_t stride,
+    endian records_endian)
+{
+  to_host_records<layoutT>(records, count, stride, records_endian);
+}
+
+template <typename layoutT, typename recordT>
+inline void
+from_host_records(recordT * records, std::size_t count, endian records_endian)
+{
+  to_host_records<layoutT>(static_cast<void *>(records), count,
+      sizeof(recordT), records_endian);
+}
+
+}} // namespace meta::byte_order
+
+#endif // guard
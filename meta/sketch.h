@@ -0,0 +1,460 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_SKETCH_H
+#define META_SKETCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/sketch.h because there's no C++11 support.
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <cstddef>
+
+#include <meta/inttypes.h>
+#include <meta/hash.h>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+namespace meta {
+namespace hash {
+
+namespace detail {
+
+// A 64 bit hash, also where std::size_t is smaller.
+template <typename T>
+inline uint64_t
+hash64(T const & value)
+{
+  return sizeof(std::size_t) >= 8 ? multi_hash(value)
+    : mixer<8>::mix(multi_hash(value));
+}
+
+
+/**
+ * Double hashing: the i-th probe of a hash is at h1 + i * h2. h2 is odd, so
+ * with a power of two modulus, the first probes are all distinct.
+ *
+ * Bloom filter blocks are chosen by the upper 32 bits of the hash, so the
+ * probes within a block use bits from the lower half.
+ **/
+inline uint32_t
+probe_start(uint64_t hash)
+{
+  return static_cast<uint32_t>(hash);
+}
+
+inline uint32_t
+probe_step(uint64_t hash)
+{
+  return static_cast<uint32_t>(hash >> 16) | 1;
+}
+
+
+/**
+ * Bloom filter blocks are one cache line of 16 32 bit words, i.e. 512 bits.
+ **/
+static std::size_t const BLOOM_BLOCK_WORDS = 16;
+static std::size_t const BLOOM_BLOCK_BITS = BLOOM_BLOCK_WORDS * 32;
+static std::size_t const BLOOM_MAX_PROBES = 16;
+
+typedef bool (*bloom_test_func)(uint32_t const *, uint64_t, std::size_t);
+
+inline bool
+scalar_bloom_test(uint32_t const * block, uint64_t hash, std::size_t probes)
+{
+  uint32_t pos = probe_start(hash);
+  uint32_t const step = probe_step(hash);
+  for (std::size_t i = 0 ; i < probes ; ++i, pos += step) {
+    uint32_t bit = pos % BLOOM_BLOCK_BITS;
+    if (!((block[bit / 32] >> (bit % 32)) & 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+#if defined(META_X86_SIMD)
+
+/**
+ * Eight probes at a time: the block is loaded into two registers, and each
+ * lane picks the word of its probe from them. The word is shifted so that the
+ * probed bit is the lowest, and all lanes must have it set. Lanes beyond the
+ * number of probes are forced to pass.
+ **/
+__attribute__((target("avx2")))
+inline bool
+avx2_bloom_test(uint32_t const * block, uint64_t hash, std::size_t probes)
+{
+  __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i const step = _mm256_set1_epi32(static_cast<int>(probe_step(hash)));
+  __m256i const bits = _mm256_set1_epi32(BLOOM_BLOCK_BITS - 1);
+  __m256i const one = _mm256_set1_epi32(1);
+
+  __m256i const low = _mm256_loadu_si256(
+      reinterpret_cast<__m256i const *>(block));
+  __m256i const high = _mm256_loadu_si256(
+      reinterpret_cast<__m256i const *>(block + 8));
+
+  __m256i pos = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(probe_start(hash))),
+      _mm256_mullo_epi32(lanes, step));
+  __m256i const advance = _mm256_slli_epi32(step, 3);
+
+  for (std::size_t i = 0 ; i < probes ; i += 8) {
+    __m256i bit = _mm256_and_si256(pos, bits);
+    __m256i index = _mm256_srli_epi32(bit, 5);
+    __m256i words = _mm256_blendv_epi8(
+        _mm256_permutevar8x32_epi32(low, index),
+        _mm256_permutevar8x32_epi32(high, index),
+        _mm256_cmpgt_epi32(index, _mm256_set1_epi32(7)));
+    __m256i set = _mm256_and_si256(_mm256_srlv_epi32(words,
+          _mm256_and_si256(bit, _mm256_set1_epi32(31))), one);
+    __m256i inactive = _mm256_cmpgt_epi32(lanes,
+        _mm256_set1_epi32(static_cast<int>(probes - i - 1)));
+    if (_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi32(set, one), inactive)) != -1) {
+      return false;
+    }
+    pos = _mm256_add_epi32(pos, advance);
+  }
+  return true;
+}
+
+#endif // META_X86_SIMD
+
+
+inline bloom_test_func
+select_bloom_test()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_bloom_test;
+  }
+#endif
+  return &scalar_bloom_test;
+}
+
+inline bool
+bloom_test(uint32_t const * block, uint64_t hash, std::size_t probes)
+{
+  static bloom_test_func const func = select_bloom_test();
+  return func(block, hash, probes);
+}
+
+} // namespace detail
+
+
+/**
+ * A cache line blocked Bloom filter: each value maps to one 64 byte block,
+ * and all of its probes are within that block, so that inserting or testing
+ * touches exactly one cache line. The probes are derived from a single 64 bit
+ * hash by double hashing; testing them uses AVX2 where the CPU supports it.
+ *
+ *    bloom_filter filter(expected_keys);
+ *    for (auto const & key : keys) {
+ *      filter.insert(key);
+ *    }
+ *    ...
+ *    if (filter.contains(key)) {
+ *      // key may be present; consult the index
+ *    }
+ *
+ * Blocking costs some accuracy compared to a classic Bloom filter of the same
+ * size: with 10 bits per value, the false positive rate is about 1% instead
+ * of about 0.8%. Add a bit or two per value to compensate.
+ *
+ * Values are hashed with multi_hash(); the *_hash() functions take hashes
+ * computed elsewhere, e.g. by hash_batch() or kept in hashed<>.
+ **/
+class bloom_filter
+{
+public:
+  explicit inline bloom_filter(std::size_t values,
+      std::size_t bits_per_value = 10)
+    : m_blocks(std::max<std::size_t>(1,
+          (values * bits_per_value + detail::BLOOM_BLOCK_BITS - 1)
+            / detail::BLOOM_BLOCK_BITS))
+    // Optimal for a classic Bloom filter: bits_per_value * ln(2)
+    , m_probes(std::min<std::size_t>(detail::BLOOM_MAX_PROBES,
+          std::max<std::size_t>(1, (bits_per_value * 693 + 500) / 1000)))
+    , m_storage(m_blocks * detail::BLOOM_BLOCK_WORDS
+        + detail::BLOOM_BLOCK_WORDS - 1)
+  {
+    if (m_blocks > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("Bloom filter too large.");
+    }
+  }
+
+  // The blocks are aligned within the storage of each copy, which may start
+  // at a different offset than the original's.
+  inline bloom_filter(bloom_filter const & other)
+    : m_blocks(other.m_blocks)
+    , m_probes(other.m_probes)
+    , m_storage(other.m_storage.size())
+  {
+    std::copy(other.blocks(), other.blocks() + block_words(),
+        const_cast<uint32_t *>(blocks()));
+  }
+
+  // Moving the storage keeps its address, and so the alignment.
+  inline bloom_filter(bloom_filter && other)
+    : m_blocks(other.m_blocks)
+    , m_probes(other.m_probes)
+    , m_storage(std::move(other.m_storage))
+  {
+  }
+
+  inline bloom_filter & operator=(bloom_filter other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  inline void swap(bloom_filter & other)
+  {
+    std::swap(m_blocks, other.m_blocks);
+    std::swap(m_probes, other.m_probes);
+    m_storage.swap(other.m_storage);
+  }
+
+  template <typename T>
+  inline void insert(T const & value)
+  {
+    insert_hash(detail::hash64(value));
+  }
+
+  template <typename T>
+  inline bool contains(T const & value) const
+  {
+    return contains_hash(detail::hash64(value));
+  }
+
+  inline void insert_hash(uint64_t hash)
+  {
+    uint32_t * block = block_of(hash);
+    uint32_t pos = detail::probe_start(hash);
+    uint32_t const step = detail::probe_step(hash);
+    for (std::size_t i = 0 ; i < m_probes ; ++i, pos += step) {
+      uint32_t bit = pos % detail::BLOOM_BLOCK_BITS;
+      block[bit / 32] |= uint32_t(1) << (bit % 32);
+    }
+  }
+
+  inline bool contains_hash(uint64_t hash) const
+  {
+    return detail::bloom_test(block_of(hash), hash, m_probes);
+  }
+
+  /**
+   * Fetch the block of a hash into the cache. This can be used as the
+   * prefetch policy of hash_batch(), when testing many values at once.
+   **/
+  inline void operator()(uint64_t hash) const
+  {
+#if defined(__GNUC__)
+    __builtin_prefetch(block_of(hash));
+#else
+    (void) hash;
+#endif
+  }
+
+  inline void clear()
+  {
+    std::fill(m_storage.begin(), m_storage.end(), 0);
+  }
+
+  inline std::size_t size_in_bytes() const
+  {
+    return block_words() * sizeof(uint32_t);
+  }
+
+  inline std::size_t probes() const
+  {
+    return m_probes;
+  }
+
+private:
+  inline std::size_t block_words() const
+  {
+    return m_blocks * detail::BLOOM_BLOCK_WORDS;
+  }
+
+  // The storage is padded, so that blocks can start at a cache line
+  // boundary.
+  inline uint32_t const * blocks() const
+  {
+    std::size_t misalignment = (reinterpret_cast<std::size_t>(
+          m_storage.data()) / sizeof(uint32_t)) % detail::BLOOM_BLOCK_WORDS;
+    return m_storage.data() + (misalignment
+        ? detail::BLOOM_BLOCK_WORDS - misalignment : 0);
+  }
+
+  inline uint32_t const * block_of(uint64_t hash) const
+  {
+    return blocks() + detail::BLOOM_BLOCK_WORDS
+      * static_cast<std::size_t>(((hash >> 32) * m_blocks) >> 32);
+  }
+
+  inline uint32_t * block_of(uint64_t hash)
+  {
+    return const_cast<uint32_t *>(
+        static_cast<bloom_filter const &>(*this).block_of(hash));
+  }
+
+  std::size_t           m_blocks;
+  std::size_t           m_probes;
+  std::vector<uint32_t> m_storage;
+};
+
+
+/**
+ * A count-min sketch: estimates how often each value was added, using a fixed
+ * amount of memory. Estimates are never too low; with a width of w and a
+ * depth of d, they exceed the true count by more than 2/w of the total count
+ * with a probability of at most 2^-d.
+ *
+ * The counters of a value, one per row, are found by double hashing the
+ * value's 64 bit hash, as in bloom_filter.
+ *
+ * To find heavy hitters, compare the estimate returned by add() against a
+ * threshold, or keep the values with the highest estimates in a small heap.
+ **/
+template <typename counterT = uint32_t>
+class count_min_sketch
+{
+public:
+  typedef counterT counter_type;
+
+  // The width is rounded up to a power of two.
+  inline count_min_sketch(std::size_t width, std::size_t depth)
+    : m_mask(next_pow2(std::max<std::size_t>(width, 2)) - 1)
+    , m_depth(depth)
+    , m_total(0)
+    , m_counters((m_mask + 1) * depth, 0)
+  {
+    if (!depth) {
+      throw std::invalid_argument("A count-min sketch needs at least one "
+          "row.");
+    }
+  }
+
+  template <typename T>
+  inline counter_type add(T const & value, counter_type count = 1)
+  {
+    return add_hash(detail::hash64(value), count);
+  }
+
+  template <typename T>
+  inline counter_type estimate(T const & value) const
+  {
+    return estimate_hash(detail::hash64(value));
+  }
+
+  /**
+   * Adds count to the counters of the hash, saturating at the maximum
+   * counter value, and returns the new estimate.
+   **/
+  inline counter_type add_hash(uint64_t hash, counter_type count = 1)
+  {
+    uint32_t pos = detail::probe_start(hash);
+    uint32_t const step = detail::probe_step(hash);
+    counter_type result = std::numeric_limits<counter_type>::max();
+    for (std::size_t row = 0 ; row < m_depth ; ++row, pos += step) {
+      counter_type & counter = m_counters[row * (m_mask + 1) + (pos & m_mask)];
+      counter = saturating_add(counter, count);
+      result = std::min(result, counter);
+    }
+    m_total += count;
+    return result;
+  }
+
+  inline counter_type estimate_hash(uint64_t hash) const
+  {
+    uint32_t pos = detail::probe_start(hash);
+    uint32_t const step = detail::probe_step(hash);
+    counter_type result = std::numeric_limits<counter_type>::max();
+    for (std::size_t row = 0 ; row < m_depth ; ++row, pos += step) {
+      result = std::min(result,
+          m_counters[row * (m_mask + 1) + (pos & m_mask)]);
+    }
+    return result;
+  }
+
+  // The sum of all counts added.
+  inline uint64_t total() const
+  {
+    return m_total;
+  }
+
+  inline std::size_t width() const
+  {
+    return m_mask + 1;
+  }
+
+  inline std::size_t depth() const
+  {
+    return m_depth;
+  }
+
+  inline void clear()
+  {
+    std::fill(m_counters.begin(), m_counters.end(), 0);
+    m_total = 0;
+  }
+
+private:
+  inline static std::size_t next_pow2(std::size_t value)
+  {
+    std::size_t result = 1;
+    while (result < value) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  inline static counter_type saturating_add(counter_type a, counter_type b)
+  {
+    return std::numeric_limits<counter_type>::max() - a < b
+      ? std::numeric_limits<counter_type>::max() : counter_type(a + b);
+  }
+
+  std::size_t               m_mask;
+  std::size_t               m_depth;
+  uint64_t                  m_total;
+  std::vector<counter_type> m_counters;
+};
+
+}} // namespace meta::hash
+
+#endif // guard
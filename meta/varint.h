@@ -0,0 +1,445 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#ifndef META_VARINT_H
+#define META_VARINT_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <meta/meta.h>
+
+#if META_CXX_MODE != META_CXX_MODE_CXX0X
+#error Can't compile meta/varint.h because there's no C++11 support.
+#endif
+
+#include <stdexcept>
+#include <limits>
+#include <type_traits>
+#include <cstddef>
+
+#include <meta/byteorder.h>
+
+#if defined(META_X86_SIMD)
+#  include <immintrin.h>
+#endif
+
+namespace meta {
+namespace varint {
+
+/**
+ * Variable length integer encoding, as in unsigned LEB128: each byte carries
+ * seven bits of the value, least significant group first, and the high bit
+ * is set on all but the last byte.
+ *
+ * Signed values are zigzag encoded first, i.e. mapped to unsigned values
+ * such that small magnitudes result in short encodings: 0, -1, 1, -2, 2...
+ * become 0, 1, 2, 3, 4...
+ *
+ * Decoding functions throw decode_error if the input is truncated, or if the
+ * encoded value does not fit into the requested type.
+ **/
+typedef std::runtime_error decode_error;
+
+
+/**
+ * The maximum number of bytes the encoding of intT can take.
+ **/
+template <typename intT>
+struct max_size
+{
+  enum { value = (sizeof(intT) * 8 + 6) / 7 };
+};
+
+
+/**
+ * Zigzag encoding and decoding
+ **/
+inline META_CONSTEXPR uint8_t zigzag_encode(int8_t value)
+{
+  return static_cast<uint8_t>((static_cast<uint8_t>(value) << 1)
+      ^ static_cast<uint8_t>(value >> 7));
+}
+
+inline META_CONSTEXPR uint16_t zigzag_encode(int16_t value)
+{
+  return static_cast<uint16_t>((static_cast<uint16_t>(value) << 1)
+      ^ static_cast<uint16_t>(value >> 15));
+}
+
+inline META_CONSTEXPR uint32_t zigzag_encode(int32_t value)
+{
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline META_CONSTEXPR uint64_t zigzag_encode(int64_t value)
+{
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline META_CONSTEXPR int8_t zigzag_decode(uint8_t value)
+{
+  return static_cast<int8_t>(static_cast<uint8_t>(
+        (value >> 1) ^ (0u - (value & 1u))));
+}
+
+inline META_CONSTEXPR int16_t zigzag_decode(uint16_t value)
+{
+  return static_cast<int16_t>(static_cast<uint16_t>(
+        (value >> 1) ^ (0u - (value & 1u))));
+}
+
+inline META_CONSTEXPR int32_t zigzag_decode(uint32_t value)
+{
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+inline META_CONSTEXPR int64_t zigzag_decode(uint64_t value)
+{
+  return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+
+namespace detail {
+
+/**
+ * Map signed types to their zigzag encoding and back; unsigned types are
+ * passed through.
+ **/
+template <typename intT, bool SIGNED = std::is_signed<intT>::value>
+struct zigzag
+{
+  typedef intT unsigned_type;
+
+  inline static unsigned_type encode(intT value)
+  {
+    return value;
+  }
+
+  inline static void decode_n(intT *, std::size_t)
+  {
+  }
+};
+
+template <typename intT>
+struct zigzag<intT, true>
+{
+  typedef typename std::make_unsigned<intT>::type unsigned_type;
+
+  inline static unsigned_type encode(intT value)
+  {
+    return zigzag_encode(value);
+  }
+
+  inline static void decode_n(intT * values, std::size_t count)
+  {
+    // Decoding happened into the same memory as unsigned values; this loop
+    // is trivially vectorized.
+    unsigned_type * u = reinterpret_cast<unsigned_type *>(values);
+    for (std::size_t i = 0 ; i < count ; ++i) {
+      values[i] = zigzag_decode(u[i]);
+    }
+  }
+};
+
+
+/**
+ * Decode a single value, byte by byte.
+ **/
+template <typename uintT>
+inline std::size_t
+decode_one(unsigned char const * src, std::size_t size, uintT & value)
+{
+  std::size_t const max = max_size<uintT>::value;
+  std::size_t const last_bits = sizeof(uintT) * 8 - 7 * (max - 1);
+
+  uint64_t result = 0;
+  for (std::size_t i = 0 ; i < size && i < max ; ++i) {
+    uint64_t byte = src[i];
+    if (i == max - 1 && (byte & 0x7f) >> last_bits) {
+      throw decode_error("Encoded value exceeds the range of the type.");
+    }
+    result |= (byte & 0x7f) << (7 * i);
+    if (!(byte & 0x80)) {
+      value = static_cast<uintT>(result);
+      return i + 1;
+    }
+  }
+
+  if (size < max) {
+    throw decode_error("Truncated variable length integer.");
+  }
+  throw decode_error("Encoded value exceeds the range of the type.");
+}
+
+
+/**
+ * Extract the value of a varint of len <= 8 bytes from the little endian
+ * load of its bytes, by masking off the continuation bits and squeezing the
+ * remaining 7 bit groups together in three steps.
+ **/
+inline uint64_t
+compact(uint64_t bytes, std::size_t len)
+{
+  uint64_t x = bytes & (0x7f7f7f7f7f7f7f7fULL >> (64 - 8 * len));
+  x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+  x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+  x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+  return x;
+}
+
+
+/**
+ * Vector kernels decode as many values as can be decoded safely while at
+ * least WINDOW_SLACK bytes of input remain, and leave the rest to
+ * decode_one(). They return the number of bytes consumed, and the number of
+ * values decoded in the out parameter.
+ **/
+static std::size_t const WINDOW_SLACK = 24;
+
+template <typename uintT>
+struct decode_kernel
+{
+  typedef std::size_t (*type)(unsigned char const *, std::size_t, uintT *,
+      std::size_t, std::size_t &);
+};
+
+
+#if defined(META_X86_SIMD)
+
+__attribute__((target("sse4.1")))
+inline void
+widen16(__m128i bytes, uint32_t * out)
+{
+  __m128i * o = reinterpret_cast<__m128i *>(out);
+  _mm_storeu_si128(o,     _mm_cvtepu8_epi32(bytes));
+  _mm_storeu_si128(o + 1, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+  _mm_storeu_si128(o + 2, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+  _mm_storeu_si128(o + 3, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+}
+
+__attribute__((target("sse4.1")))
+inline void
+widen16(__m128i bytes, uint64_t * out)
+{
+  __m128i * o = reinterpret_cast<__m128i *>(out);
+  _mm_storeu_si128(o,     _mm_cvtepu8_epi64(bytes));
+  _mm_storeu_si128(o + 1, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 2)));
+  _mm_storeu_si128(o + 2, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 4)));
+  _mm_storeu_si128(o + 3, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 6)));
+  _mm_storeu_si128(o + 4, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 8)));
+  _mm_storeu_si128(o + 5, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 10)));
+  _mm_storeu_si128(o + 6, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 12)));
+  _mm_storeu_si128(o + 7, _mm_cvtepu8_epi64(_mm_srli_si128(bytes, 14)));
+}
+
+
+/**
+ * Looks at 16 bytes at a time. The continuation bits of all of them are
+ * gathered into a mask with a single pmovmskb; if none are set, the window
+ * holds 16 single byte values that are just widened. Otherwise, the clear
+ * bits of the mask mark where each value ends, and values of up to 8 bytes
+ * are extracted with compact().
+ **/
+template <typename uintT>
+__attribute__((target("sse4.1")))
+inline std::size_t
+sse41_decode(unsigned char const * src, std::size_t size, uintT * out,
+    std::size_t count, std::size_t & decoded)
+{
+  std::size_t pos = 0;
+  decoded = 0;
+
+  while (size - pos >= WINDOW_SLACK && decoded < count) {
+    __m128i window = _mm_loadu_si128(
+        reinterpret_cast<__m128i const *>(src + pos));
+    unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(window));
+
+    if (!mask && count - decoded >= 16) {
+      widen16(window, out + decoded);
+      decoded += 16;
+      pos += 16;
+      continue;
+    }
+
+    unsigned int ends = ~mask & 0xffff;
+    if (!ends) {
+      // 16 continuation bytes in a row; let decode_one() raise the error.
+      break;
+    }
+
+    std::size_t start = 0;
+    while (ends && decoded < count) {
+      std::size_t end = static_cast<std::size_t>(__builtin_ctz(ends));
+      ends &= ends - 1;
+
+      // Encodings longer than max_size<uintT> are rejected by decode_one(),
+      // even if their value fits.
+      std::size_t len = end - start + 1;
+      bool const compactable = len <= 8
+        && len <= std::size_t(max_size<uintT>::value);
+      uint64_t value = 0;
+      if (compactable) {
+        value = compact(byte_order::load_le<uint64_t>(src + pos + start), len);
+      }
+      if (!compactable || value > std::numeric_limits<uintT>::max()) {
+        decode_one(src + pos + start, size - pos - start, out[decoded]);
+      } else {
+        out[decoded] = static_cast<uintT>(value);
+      }
+
+      ++decoded;
+      start = end + 1;
+    }
+    pos += start;
+  }
+
+  return pos;
+}
+
+#endif // META_X86_SIMD
+
+
+template <typename uintT>
+inline typename decode_kernel<uintT>::type
+select_decode_kernel()
+{
+#if defined(META_X86_SIMD)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    return &sse41_decode<uintT>;
+  }
+#endif
+  return nullptr;
+}
+
+} // namespace detail
+
+
+/**
+ * Returns the number of bytes value takes when encoded.
+ **/
+template <typename intT>
+inline std::size_t
+encoded_size(intT value)
+{
+  typename detail::zigzag<intT>::unsigned_type u = detail::zigzag<intT>::encode(value);
+  std::size_t size = 1;
+  while (u >= 0x80) {
+    u >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+
+/**
+ * Encode a single value to dest, which must have space for at least
+ * max_size<intT>::value bytes. Returns the number of bytes written.
+ **/
+template <typename intT>
+inline std::size_t
+encode(intT value, void * dest)
+{
+  typename detail::zigzag<intT>::unsigned_type u = detail::zigzag<intT>::encode(value);
+  unsigned char * d = static_cast<unsigned char *>(dest);
+  std::size_t size = 0;
+  while (u >= 0x80) {
+    d[size++] = static_cast<unsigned char>(u | 0x80);
+    u >>= 7;
+  }
+  d[size++] = static_cast<unsigned char>(u);
+  return size;
+}
+
+
+/**
+ * Decode a single value from up to size bytes at src. Returns the number of
+ * bytes consumed.
+ **/
+template <typename intT>
+inline std::size_t
+decode(void const * src, std::size_t size, intT & value)
+{
+  typedef typename detail::zigzag<intT>::unsigned_type uintT;
+  std::size_t consumed = detail::decode_one(
+      static_cast<unsigned char const *>(src), size,
+      reinterpret_cast<uintT &>(value));
+  detail::zigzag<intT>::decode_n(&value, 1);
+  return consumed;
+}
+
+
+/**
+ * Encode count values to dest, which must have space for at least
+ * count * max_size<intT>::value bytes. Returns the number of bytes written.
+ **/
+template <typename intT>
+inline std::size_t
+encode_n(intT const * values, std::size_t count, void * dest)
+{
+  unsigned char * d = static_cast<unsigned char *>(dest);
+  std::size_t size = 0;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    size += encode(values[i], d + size);
+  }
+  return size;
+}
+
+
+/**
+ * Decode count values from up to size bytes at src. Returns the number of
+ * bytes consumed.
+ *
+ * On x86 CPUs with SSE4.1, most of the input is decoded 16 bytes at a time,
+ * which is particularly fast if most values are small.
+ **/
+template <typename intT>
+inline std::size_t
+decode_n(void const * src, std::size_t size, intT * values, std::size_t count)
+{
+  typedef typename detail::zigzag<intT>::unsigned_type uintT;
+  static_assert(sizeof(uintT) == 4 || sizeof(uintT) == 8,
+      "Bulk decoding supports 32 and 64 bit integers only.");
+
+  unsigned char const * s = static_cast<unsigned char const *>(src);
+  uintT * out = reinterpret_cast<uintT *>(values);
+
+  std::size_t consumed = 0;
+  std::size_t decoded = 0;
+
+  static typename detail::decode_kernel<uintT>::type const kernel
+    = detail::select_decode_kernel<uintT>();
+  if (kernel) {
+    consumed = kernel(s, size, out, count, decoded);
+  }
+
+  for ( ; decoded < count ; ++decoded) {
+    consumed += detail::decode_one(s + consumed, size - consumed, out[decoded]);
+  }
+
+  detail::zigzag<intT>::decode_n(values, count);
+  return consumed;
+}
+
+}} // namespace meta::varint
+
+#endif // guard
@@ -0,0 +1,225 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <meta/bitstream.h>
+
+#include <vector>
+
+
+namespace {
+
+// Reference implementation, one bit at a time.
+bool get_bit(unsigned char const * buffer, std::size_t bit, bool msb_first)
+{
+  unsigned int shift = msb_first ? 7 - bit % 8 : bit % 8;
+  return (buffer[bit / 8] >> shift) & 1;
+}
+
+uint64_t reference_read(unsigned char const * buffer, std::size_t bit,
+    unsigned int n, bool msb_first)
+{
+  uint64_t value = 0;
+  for (unsigned int i = 0 ; i < n ; ++i) {
+    uint64_t b = get_bit(buffer, bit + i, msb_first);
+    if (msb_first) {
+      value = (value << 1) | b;
+    } else {
+      value |= b << i;
+    }
+  }
+  return value;
+}
+
+
+template <int ENDIAN>
+void check_round_trip(bool msb_first)
+{
+  namespace b = meta::byte_order;
+
+  std::vector<unsigned int> widths;
+  std::vector<uint64_t> values;
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+  std::size_t total = 0;
+  for (std::size_t i = 0 ; i < 500 ; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    unsigned int n = 1 + static_cast<unsigned int>(state % b::MAX_BIT_FIELD);
+    widths.push_back(n);
+    values.push_back(state >> (64 - n));
+    total += n;
+  }
+
+  std::vector<unsigned char> buffer((total + 7) / 8);
+  b::bit_writer<ENDIAN> w(&buffer[0], buffer.size());
+  for (std::size_t i = 0 ; i < widths.size() ; ++i) {
+    w.write(values[i], widths[i]);
+  }
+  CPPUNIT_ASSERT_EQUAL(total, w.bit_position());
+  CPPUNIT_ASSERT_EQUAL(buffer.size(), w.flush());
+
+  b::bit_reader<ENDIAN> r(&buffer[0], buffer.size());
+  std::size_t bit = 0;
+  for (std::size_t i = 0 ; i < widths.size() ; ++i) {
+    CPPUNIT_ASSERT_EQUAL(values[i],
+        reference_read(&buffer[0], bit, widths[i], msb_first));
+    CPPUNIT_ASSERT_EQUAL(values[i], r.read(widths[i]));
+    bit += widths[i];
+  }
+  CPPUNIT_ASSERT_EQUAL(total, r.bit_position());
+  CPPUNIT_ASSERT(r.bits_remaining() < 8);
+}
+
+} // anonymous namespace
+
+
+class BitStreamTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(BitStreamTest);
+
+        CPPUNIT_TEST(testReadBigEndian);
+        CPPUNIT_TEST(testReadLittleEndian);
+        CPPUNIT_TEST(testWriter);
+        CPPUNIT_TEST(testRoundTrip);
+        CPPUNIT_TEST(testBounds);
+
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+    void testReadBigEndian()
+    {
+        namespace b = meta::byte_order;
+
+        // 4 bit version, 12 bit length, 20 bit offset, 4 bits padding
+        unsigned char buffer[] = { 0x3a, 0xbc, 0x12, 0x34, 0x50 };
+
+        b::bit_reader<> r(buffer, sizeof(buffer));
+        CPPUNIT_ASSERT_EQUAL(std::size_t(40), r.bits_remaining());
+
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0x3), r.read<4>());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0xabc), r.peek<12>());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0xabc), r.read<12>());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x12345), r.read<20>());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(36), r.bit_position());
+
+        r.align();
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), r.bits_remaining());
+    }
+
+
+
+    void testReadLittleEndian()
+    {
+        namespace b = meta::byte_order;
+
+        // LSB first: 0x3 in the low nibble, then 0xabc, then 0x12345
+        unsigned char buffer[] = { 0xc3, 0xab, 0x45, 0x23, 0x01 };
+
+        b::bit_reader<b::META_LITTLE_ENDIAN> r(buffer, sizeof(buffer));
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0x3), r.read<4>());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0xabc), r.read<12>());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x12345), r.read<20>());
+
+        // Fields spanning whole bytes read like integers in the stream's
+        // byte order.
+        unsigned char words[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+          0x08, 0x09, 0x0a };
+        b::bit_reader<b::META_LITTLE_ENDIAN> le(words, sizeof(words));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0x0201), le.read<16>());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x06050403), le.read<32>());
+
+        b::bit_reader<b::META_BIG_ENDIAN> be(words, sizeof(words));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0x0102), be.read<16>());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x03040506), be.read<32>());
+    }
+
+
+
+    void testWriter()
+    {
+        namespace b = meta::byte_order;
+
+        unsigned char buffer[5] = { 0 };
+        b::bit_writer<> w(buffer, sizeof(buffer));
+        w.write<4>(0x3);
+        w.write<12>(0xfabc); // excess bits are ignored
+        w.write<20>(0x12345);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5), w.flush());
+
+        unsigned char expected[] = { 0x3a, 0xbc, 0x12, 0x34, 0x50 };
+        for (std::size_t i = 0 ; i < sizeof(expected) ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(int(expected[i]), int(buffer[i]));
+        }
+
+        unsigned char le_buffer[5] = { 0 };
+        b::bit_writer<b::META_LITTLE_ENDIAN> le(le_buffer, sizeof(le_buffer));
+        le.write<4>(0x3);
+        le.write<12>(0xabc);
+        le.write<20>(0x12345);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5), le.flush());
+
+        unsigned char le_expected[] = { 0xc3, 0xab, 0x45, 0x23, 0x01 };
+        for (std::size_t i = 0 ; i < sizeof(le_expected) ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(int(le_expected[i]), int(le_buffer[i]));
+        }
+    }
+
+
+
+    void testRoundTrip()
+    {
+        namespace b = meta::byte_order;
+
+        check_round_trip<b::META_BIG_ENDIAN>(true);
+        check_round_trip<b::META_LITTLE_ENDIAN>(false);
+    }
+
+
+
+    void testBounds()
+    {
+        namespace b = meta::byte_order;
+
+        unsigned char buffer[3] = { 0xff, 0xff, 0xff };
+
+        b::bit_reader<> r(buffer, sizeof(buffer));
+        r.skip(20);
+        CPPUNIT_ASSERT_THROW(r.read<5>(), b::out_of_range_error);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0xf), r.read<4>());
+        CPPUNIT_ASSERT_THROW(r.read(1), b::out_of_range_error);
+
+        b::bit_writer<> w(buffer, sizeof(buffer));
+        w.write<20>(0);
+        CPPUNIT_ASSERT_THROW(w.write<5>(0), b::out_of_range_error);
+        w.write<1>(1);
+        w.align();
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), w.bits_remaining());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(3), w.flush());
+        CPPUNIT_ASSERT_EQUAL(0x08, int(buffer[2]));
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BitStreamTest);
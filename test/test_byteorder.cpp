@@ -24,6 +24,13 @@
 
 #include <meta/byteorder.h>
 
+#include <vector>
+#include <cstring>
+
+#if META_CXX_MODE == META_CXX_MODE_CXX0X
+#  include <type_traits>
+#endif
+
 
 class ByteOrderTest
     : public CppUnit::TestFixture
@@ -32,6 +39,16 @@ public:
     CPPUNIT_TEST_SUITE(ByteOrderTest);
 
         CPPUNIT_TEST(testByteOrder);
+        CPPUNIT_TEST(testHostByteOrder);
+        CPPUNIT_TEST(testStaticToHost);
+        CPPUNIT_TEST(testLoadStore);
+        CPPUNIT_TEST(testFloatingPoint);
+        CPPUNIT_TEST(testInt128);
+        CPPUNIT_TEST(testEndianValue);
+        CPPUNIT_TEST(testEndianValueOverlay);
+        CPPUNIT_TEST(testBulkSwap);
+        CPPUNIT_TEST(testBulkSwapKernels);
+        CPPUNIT_TEST(testBulkToHost);
 
     CPPUNIT_TEST_SUITE_END();
 private:
@@ -55,6 +72,370 @@ private:
             CPPUNIT_ASSERT_EQUAL(static_cast<uint16_t>(1234), b::to_host(x, b::META_LITTLE_ENDIAN));
         }
     }
+
+
+
+    void testHostByteOrder()
+    {
+        namespace b = meta::byte_order;
+
+        // Inspect the in-memory representation of a known value.
+        uint32_t value = 0x01020304;
+        unsigned char bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        if (bytes[0] == 0x01) {
+            CPPUNIT_ASSERT_EQUAL(b::META_BIG_ENDIAN, b::host_byte_order());
+        } else {
+            CPPUNIT_ASSERT_EQUAL(b::META_LITTLE_ENDIAN, b::host_byte_order());
+        }
+    }
+
+
+
+    void testStaticToHost()
+    {
+        namespace b = meta::byte_order;
+
+        uint16_t x = 1234;
+        uint32_t y = 0x01020304;
+        uint64_t z = 0x0102030405060708ULL;
+
+        // The compile-time versions must agree with the runtime ones.
+        CPPUNIT_ASSERT_EQUAL(b::to_host(x, b::META_BIG_ENDIAN), b::to_host<b::META_BIG_ENDIAN>(x));
+        CPPUNIT_ASSERT_EQUAL(b::to_host(x, b::META_LITTLE_ENDIAN), b::to_host<b::META_LITTLE_ENDIAN>(x));
+        CPPUNIT_ASSERT_EQUAL(b::to_host(y, b::META_BIG_ENDIAN), b::to_host<b::META_BIG_ENDIAN>(y));
+        CPPUNIT_ASSERT_EQUAL(b::to_host(y, b::META_LITTLE_ENDIAN), b::to_host<b::META_LITTLE_ENDIAN>(y));
+        CPPUNIT_ASSERT_EQUAL(b::to_host(z, b::META_BIG_ENDIAN), b::to_host<b::META_BIG_ENDIAN>(z));
+        CPPUNIT_ASSERT_EQUAL(b::to_host(z, b::META_LITTLE_ENDIAN), b::to_host<b::META_LITTLE_ENDIAN>(z));
+
+        CPPUNIT_ASSERT_EQUAL(b::from_host(y, b::META_BIG_ENDIAN), b::from_host<b::META_BIG_ENDIAN>(y));
+        CPPUNIT_ASSERT_EQUAL(b::from_host(y, b::META_LITTLE_ENDIAN), b::from_host<b::META_LITTLE_ENDIAN>(y));
+
+        // The manual shifting must agree with whatever swap() uses.
+        CPPUNIT_ASSERT_EQUAL(b::swap(x), b::detail::shift_swap(x));
+        CPPUNIT_ASSERT_EQUAL(b::swap(y), b::detail::shift_swap(y));
+        CPPUNIT_ASSERT_EQUAL(b::swap(z), b::detail::shift_swap(z));
+
+#if META_CXX_MODE == META_CXX_MODE_CXX0X && defined(META_BYTE_ORDER_SWAP_BUILTIN)
+        // Conversions of constants happen at compile-time.
+        static_assert(b::swap(uint16_t(0x0102)) == 0x0201, "constexpr swap");
+        static_assert(b::swap(uint32_t(0x01020304)) == 0x04030201, "constexpr swap");
+        static_assert(b::swap(int64_t(1)) == int64_t(0x0100000000000000LL), "constexpr swap");
+        static_assert(b::to_host<b::META_BYTE_ORDER>(uint32_t(42)) == 42, "constexpr to_host");
+        static_assert(b::convert<b::META_LITTLE_ENDIAN>::hton(uint32_t(1)) == 0x01000000, "constexpr hton");
+#endif
+    }
+
+
+
+    void testLoadStore()
+    {
+        namespace b = meta::byte_order;
+
+        // Unaligned access at every offset
+        unsigned char buffer[16] = { 0 };
+        for (std::size_t offset = 0 ; offset < 8 ; ++offset) {
+            b::store_be(buffer + offset, uint32_t(0x01020304));
+            CPPUNIT_ASSERT_EQUAL(0x01, int(buffer[offset]));
+            CPPUNIT_ASSERT_EQUAL(0x04, int(buffer[offset + 3]));
+            CPPUNIT_ASSERT_EQUAL(uint32_t(0x01020304), b::load_be<uint32_t>(buffer + offset));
+            CPPUNIT_ASSERT_EQUAL(uint32_t(0x04030201), b::load_le<uint32_t>(buffer + offset));
+
+            b::store_le(buffer + offset, uint64_t(0x0102030405060708ULL));
+            CPPUNIT_ASSERT_EQUAL(0x08, int(buffer[offset]));
+            CPPUNIT_ASSERT_EQUAL(0x01, int(buffer[offset + 7]));
+            CPPUNIT_ASSERT_EQUAL(uint64_t(0x0102030405060708ULL), b::load_le<uint64_t>(buffer + offset));
+
+            b::store_be(buffer + offset, int16_t(-2));
+            CPPUNIT_ASSERT_EQUAL(int16_t(-2), b::load_be<int16_t>(buffer + offset));
+            CPPUNIT_ASSERT_EQUAL(int16_t(-257), b::load_le<int16_t>(buffer + offset));
+        }
+    }
+
+
+
+    void testFloatingPoint()
+    {
+        namespace b = meta::byte_order;
+
+        // IEEE 754 representation of 1.0f is 0x3f800000
+        float f = 1.0f;
+        float swapped_f = b::swap(f);
+        uint32_t bits = 0;
+        std::memcpy(&bits, &swapped_f, sizeof(bits));
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x0000803f), bits);
+        CPPUNIT_ASSERT_EQUAL(f, b::swap(swapped_f));
+
+        double d = -1234.5678;
+        CPPUNIT_ASSERT_EQUAL(d, b::convert<>::ntoh(b::convert<>::hton(d)));
+        CPPUNIT_ASSERT_EQUAL(d, b::to_host(b::from_host(d, b::META_BIG_ENDIAN), b::META_BIG_ENDIAN));
+
+        // Network byte order of 1.0 is 3f f0 00 00 00 00 00 00
+        unsigned char buffer[9] = { 0 };
+        b::store_be(buffer + 1, 1.0);
+        CPPUNIT_ASSERT_EQUAL(0x3f, int(buffer[1]));
+        CPPUNIT_ASSERT_EQUAL(0xf0, int(buffer[2]));
+        CPPUNIT_ASSERT_EQUAL(0x00, int(buffer[8]));
+        CPPUNIT_ASSERT_EQUAL(1.0, b::load_be<double>(buffer + 1));
+
+        b::endian_value<float, b::META_BIG_ENDIAN> ef = 3.25f;
+        CPPUNIT_ASSERT_EQUAL(3.25f, ef.get());
+
+        // Bulk
+        std::vector<double> values(50);
+        for (std::size_t i = 0 ; i < values.size() ; ++i) {
+            values[i] = i * 1.5 - 20;
+        }
+        std::vector<double> converted(values.size());
+        b::from_host_n(&converted[0], &values[0], values.size(), b::META_BIG_ENDIAN);
+        for (std::size_t i = 0 ; i < values.size() ; ++i) {
+            CPPUNIT_ASSERT(same_bits(b::from_host(values[i], b::META_BIG_ENDIAN), converted[i]));
+        }
+        b::to_host_n<b::META_BIG_ENDIAN>(&converted[0], converted.size());
+        CPPUNIT_ASSERT(values == converted);
+    }
+
+
+
+    void testInt128()
+    {
+#if defined(META_HAVE_INT128)
+        namespace b = meta::byte_order;
+
+        meta::uint128_t x = (meta::uint128_t(0x0102030405060708ULL) << 64)
+          | 0x090a0b0c0d0e0f10ULL;
+        meta::uint128_t expected = (meta::uint128_t(0x100f0e0d0c0b0a09ULL) << 64)
+          | 0x0807060504030201ULL;
+        CPPUNIT_ASSERT(expected == b::swap(x));
+        CPPUNIT_ASSERT(x == b::convert<>::ntoh(b::convert<>::hton(x)));
+
+        meta::int128_t y = -42;
+        CPPUNIT_ASSERT(y == b::swap(b::swap(y)));
+
+        unsigned char buffer[17] = { 0 };
+        b::store_be(buffer + 1, x);
+        CPPUNIT_ASSERT_EQUAL(0x01, int(buffer[1]));
+        CPPUNIT_ASSERT_EQUAL(0x10, int(buffer[16]));
+        CPPUNIT_ASSERT(x == b::load_be<meta::uint128_t>(buffer + 1));
+
+        std::vector<meta::uint128_t> values(21);
+        for (std::size_t i = 0 ; i < values.size() ; ++i) {
+            values[i] = x * i;
+        }
+        std::vector<meta::uint128_t> swapped(values);
+        b::swap_n(&swapped[0], swapped.size());
+        for (std::size_t i = 0 ; i < values.size() ; ++i) {
+            CPPUNIT_ASSERT(b::swap(values[i]) == swapped[i]);
+        }
+#endif
+    }
+
+
+
+    void testEndianValue()
+    {
+        namespace b = meta::byte_order;
+
+        typedef b::endian_value<uint32_t, b::META_BIG_ENDIAN> be32;
+        typedef b::endian_value<uint32_t, b::META_LITTLE_ENDIAN> le32;
+
+        CPPUNIT_ASSERT_EQUAL(sizeof(uint32_t), sizeof(be32));
+        CPPUNIT_ASSERT_EQUAL(sizeof(uint32_t), sizeof(le32));
+
+        be32 x = 0x01020304;
+        le32 y = 0x01020304;
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x01020304), x.get());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x01020304), uint32_t(y));
+
+        // Storage is in the requested byte order, regardless of the host.
+        unsigned char bytes[4];
+        std::memcpy(bytes, &x, sizeof(bytes));
+        CPPUNIT_ASSERT_EQUAL(0x01, int(bytes[0]));
+        CPPUNIT_ASSERT_EQUAL(0x04, int(bytes[3]));
+        std::memcpy(bytes, &y, sizeof(bytes));
+        CPPUNIT_ASSERT_EQUAL(0x04, int(bytes[0]));
+        CPPUNIT_ASSERT_EQUAL(0x01, int(bytes[3]));
+
+        x = 42;
+        CPPUNIT_ASSERT_EQUAL(uint32_t(42), x.get());
+        CPPUNIT_ASSERT(x == 42u);
+
+#if META_CXX_MODE == META_CXX_MODE_CXX0X
+        static_assert(std::is_trivially_copyable<b::big_endian<uint64_t>>::value,
+            "big_endian must be trivially copyable");
+        static_assert(alignof(b::big_endian<uint64_t>) == 1,
+            "big_endian must not impose alignment");
+        static_assert(sizeof(b::little_endian<int16_t>) == sizeof(int16_t),
+            "little_endian must not add padding");
+#endif
+    }
+
+
+
+    void testEndianValueOverlay()
+    {
+        namespace b = meta::byte_order;
+
+        struct header
+        {
+            b::endian_value<uint16_t, b::META_BIG_ENDIAN>     type;
+            b::endian_value<uint32_t, b::META_BIG_ENDIAN>     length;
+            b::endian_value<uint64_t, b::META_LITTLE_ENDIAN>  id;
+        };
+        CPPUNIT_ASSERT_EQUAL(std::size_t(14), sizeof(header));
+
+        // Lay the header over a buffer at an odd offset.
+        unsigned char buffer[1 + sizeof(header)] = {
+            0xff,
+            0x00, 0x2a,
+            0x00, 0x00, 0x01, 0x00,
+            0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+        };
+        header * hdr = reinterpret_cast<header *>(buffer + 1);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(42), hdr->type.get());
+        CPPUNIT_ASSERT_EQUAL(uint32_t(256), hdr->length.get());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0x0102030405060708ULL), hdr->id.get());
+
+        hdr->length = 0x0a0b0c0d;
+        CPPUNIT_ASSERT_EQUAL(0x0a, int(buffer[3]));
+        CPPUNIT_ASSERT_EQUAL(0x0d, int(buffer[6]));
+    }
+
+
+
+    // Swapped floating point values may be NaNs, which never compare equal.
+    template <typename T>
+    static bool same_bits(T const & first, T const & second)
+    {
+        return 0 == std::memcmp(&first, &second, sizeof(T));
+    }
+
+    template <typename intT>
+    void testBulkSwapImpl()
+    {
+        namespace b = meta::byte_order;
+
+        // Enough elements to exercise the unrolled AVX2 loop, the single vector
+        // loop and the scalar tail; the offsets shift the buffer start so that
+        // the alignment head gets exercised as well.
+        std::size_t const count = 300;
+        std::vector<intT> orig(count + 8);
+        for (std::size_t i = 0 ; i < orig.size() ; ++i) {
+            orig[i] = static_cast<intT>(i * 0x0102030405060708ULL + 0x1122);
+        }
+
+        for (std::size_t offset = 0 ; offset < 8 ; ++offset) {
+            for (std::size_t n = 0 ; n <= count ; n += 37) {
+                // In place
+                std::vector<intT> inplace(orig);
+                b::swap_n(&inplace[offset], n);
+                for (std::size_t i = 0 ; i < inplace.size() ; ++i) {
+                    if (i >= offset && i < offset + n) {
+                        CPPUNIT_ASSERT(same_bits(b::swap(orig[i]), inplace[i]));
+                    } else {
+                        CPPUNIT_ASSERT(same_bits(orig[i], inplace[i]));
+                    }
+                }
+
+                // Out of place, with source and destination misaligned differently
+                std::vector<intT> out(count + 8, 0);
+                b::swap_n(&out[7 - offset], &orig[offset], n);
+                for (std::size_t i = 0 ; i < n ; ++i) {
+                    CPPUNIT_ASSERT(same_bits(b::swap(orig[offset + i]), out[7 - offset + i]));
+                }
+            }
+        }
+    }
+
+    void testBulkSwap()
+    {
+        testBulkSwapImpl<uint16_t>();
+        testBulkSwapImpl<int16_t>();
+        testBulkSwapImpl<uint32_t>();
+        testBulkSwapImpl<int32_t>();
+        testBulkSwapImpl<uint64_t>();
+        testBulkSwapImpl<int64_t>();
+        testBulkSwapImpl<float>();
+        testBulkSwapImpl<double>();
+    }
+
+
+
+    template <std::size_t SIZE>
+    void testBulkSwapKernelsImpl()
+    {
+        namespace d = meta::byte_order::detail;
+
+        std::vector<char> orig(SIZE * 200 + 3);
+        for (std::size_t i = 0 ; i < orig.size() ; ++i) {
+            orig[i] = static_cast<char>(i * 7);
+        }
+
+        // The dispatcher only ever exercises the best kernel for this CPU, so
+        // compare every supported kernel against the scalar one; the +1 byte
+        // offsets also cover buffers that are not element aligned.
+        std::vector<d::bulk_swap_func> kernels;
+#if defined(META_X86_SIMD)
+        if (__builtin_cpu_supports("ssse3")) {
+            kernels.push_back(&d::ssse3_bulk_swap<SIZE>);
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back(&d::avx2_bulk_swap<SIZE>);
+        }
+#endif
+
+        std::vector<char> expected(orig.size());
+        std::vector<char> result(orig.size());
+        for (std::size_t offset = 0 ; offset < 3 ; ++offset) {
+            std::size_t count = (orig.size() - offset) / SIZE;
+            d::scalar_bulk_swap<SIZE>(&expected[offset], &orig[offset], count);
+            for (std::size_t k = 0 ; k < kernels.size() ; ++k) {
+                kernels[k](&result[offset], &orig[offset], count);
+                CPPUNIT_ASSERT(0 == std::memcmp(&expected[offset],
+                      &result[offset], count * SIZE));
+            }
+        }
+    }
+
+    void testBulkSwapKernels()
+    {
+        testBulkSwapKernelsImpl<2>();
+        testBulkSwapKernelsImpl<4>();
+        testBulkSwapKernelsImpl<8>();
+#if defined(META_HAVE_INT128)
+        testBulkSwapKernelsImpl<16>();
+#endif
+    }
+
+
+
+    void testBulkToHost()
+    {
+        namespace b = meta::byte_order;
+
+        std::vector<uint32_t> orig(100);
+        for (std::size_t i = 0 ; i < orig.size() ; ++i) {
+            orig[i] = static_cast<uint32_t>(i * 0x01020304);
+        }
+
+        b::endian endians[] = { b::META_BIG_ENDIAN, b::META_LITTLE_ENDIAN };
+        for (std::size_t e = 0 ; e < 2 ; ++e) {
+            std::vector<uint32_t> inplace(orig);
+            b::to_host_n(&inplace[0], inplace.size(), endians[e]);
+
+            std::vector<uint32_t> out(orig.size());
+            b::to_host_n(&out[0], &orig[0], orig.size(), endians[e]);
+
+            for (std::size_t i = 0 ; i < orig.size() ; ++i) {
+                CPPUNIT_ASSERT_EQUAL(b::to_host(orig[i], endians[e]), inplace[i]);
+                CPPUNIT_ASSERT_EQUAL(b::to_host(orig[i], endians[e]), out[i]);
+            }
+
+            // Round trip
+            b::from_host_n(&inplace[0], inplace.size(), endians[e]);
+            CPPUNIT_ASSERT(orig == inplace);
+        }
+    }
 };
 
 
@@ -0,0 +1,138 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include <meta/crc32c.h>
+
+
+class CRC32CTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(CRC32CTest);
+
+      CPPUNIT_TEST(testKnownValues);
+      CPPUNIT_TEST(testKernels);
+      CPPUNIT_TEST(testExtendAndCombine);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    static std::vector<unsigned char> random_bytes(std::size_t size)
+    {
+      std::vector<unsigned char> result(size);
+      uint32_t state = 12345;
+      for (std::size_t i = 0 ; i < size ; ++i) {
+        state = state * 1103515245UL + 12345UL;
+        result[i] = static_cast<unsigned char>(state >> 16);
+      }
+      return result;
+    }
+
+
+
+    void testKnownValues()
+    {
+      namespace c = meta::crc32c;
+
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), c::checksum("", 0));
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0xe3069283UL), c::checksum("123456789", 9));
+
+      // From RFC 3720, appendix B.4
+      std::vector<unsigned char> data(32, 0);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0x8a9136aaUL), c::checksum(&data[0], 32));
+
+      data.assign(32, 0xff);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0x62a8ab43UL), c::checksum(&data[0], 32));
+
+      for (std::size_t i = 0 ; i < 32 ; ++i) {
+        data[i] = static_cast<unsigned char>(i);
+      }
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0x46dd794eUL), c::checksum(&data[0], 32));
+    }
+
+
+
+    void testKernels()
+    {
+      namespace d = meta::crc32c::detail;
+
+      // Sizes around the stream and block boundaries of the hardware
+      // kernels, at all alignments.
+      std::size_t const sizes[] = { 0, 1, 7, 8, 9, 767, 768, 769, 3 * 256 * 5
+        + 13, 24575, 24576, 24577, 3 * 24576 + 3 * 256 + 9, 59990 };
+      std::size_t const max_offset = 8;
+      std::vector<unsigned char> data = random_bytes(
+          *std::max_element(std::begin(sizes), std::end(sizes)) + max_offset);
+
+      for (std::size_t size : sizes) {
+        for (std::size_t offset = 0 ; offset <= max_offset ; ++offset) {
+          uint32_t expected = d::scalar_extend(~uint32_t(0), &data[offset],
+              size);
+          CPPUNIT_ASSERT_EQUAL(expected,
+              d::extend(~uint32_t(0), &data[offset], size));
+#if defined(META_CRC32C_HW)
+          __builtin_cpu_init();
+          if (__builtin_cpu_supports("sse4.2")) {
+            CPPUNIT_ASSERT_EQUAL(expected,
+                d::sse42_extend(~uint32_t(0), &data[offset], size));
+          }
+          if (__builtin_cpu_supports("sse4.2")
+              && __builtin_cpu_supports("pclmul")) {
+            CPPUNIT_ASSERT_EQUAL(expected,
+                d::pclmul_extend(~uint32_t(0), &data[offset], size));
+          }
+#endif
+        }
+      }
+    }
+
+
+
+    void testExtendAndCombine()
+    {
+      namespace c = meta::crc32c;
+
+      std::vector<unsigned char> data = random_bytes(30000);
+      std::size_t const sizes[] = { 0, 1, 100, 1000, 30000 };
+
+      for (std::size_t size : sizes) {
+        uint32_t expected = c::checksum(&data[0], size);
+        for (std::size_t split = 0 ; split <= size ; split += size / 7 + 1) {
+          uint32_t first = c::checksum(&data[0], split);
+          uint32_t second = c::checksum(&data[split], size - split);
+
+          CPPUNIT_ASSERT_EQUAL(expected,
+              c::extend(first, &data[split], size - split));
+          CPPUNIT_ASSERT_EQUAL(expected,
+              c::combine(first, second, size - split));
+        }
+      }
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CRC32CTest);
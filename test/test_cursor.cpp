@@ -0,0 +1,145 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2009-2012 Jens Finkhaeuser.
+ * Copyright (c) 2013-2015 Unwesen Ltd.
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <meta/cursor.h>
+
+
+class CursorTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(CursorTest);
+
+        CPPUNIT_TEST(testReader);
+        CPPUNIT_TEST(testReaderBounds);
+        CPPUNIT_TEST(testWriter);
+        CPPUNIT_TEST(testRoundTrip);
+
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+    void testReader()
+    {
+        namespace b = meta::byte_order;
+
+        unsigned char buffer[] = {
+            0x00, 0x2a,
+            0x01, 0x02, 0x03, 0x04,
+            0xff, 0xfe,
+            'a', 'b', 'c',
+        };
+
+        b::reader<> r(buffer, sizeof(buffer));
+        CPPUNIT_ASSERT_EQUAL(sizeof(buffer), r.remaining());
+
+        CPPUNIT_ASSERT_EQUAL(uint16_t(42), r.read<uint16_t>());
+
+        // A validated record can be read without per-field checks.
+        r.require(6);
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0x01020304), r.read_unchecked<uint32_t>());
+        CPPUNIT_ASSERT_EQUAL(int16_t(-2), r.read_unchecked<int16_t>());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(8), r.position());
+
+        char str[2];
+        r.read(str, sizeof(str));
+        CPPUNIT_ASSERT_EQUAL('a', str[0]);
+        CPPUNIT_ASSERT_EQUAL('b', str[1]);
+
+        r.skip(1);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), r.remaining());
+    }
+
+
+
+    void testReaderBounds()
+    {
+        namespace b = meta::byte_order;
+
+        // The reader only gets to see the first three bytes.
+        unsigned char buffer[] = { 0x01, 0x02, 0x03, 0x04 };
+
+        b::reader<b::META_LITTLE_ENDIAN> r(buffer, 3);
+        CPPUNIT_ASSERT(r.has(3));
+        CPPUNIT_ASSERT(!r.has(4));
+        CPPUNIT_ASSERT_THROW(r.read<uint32_t>(), b::out_of_range_error);
+        CPPUNIT_ASSERT_THROW(r.require(4), b::out_of_range_error);
+        CPPUNIT_ASSERT_THROW(r.skip(4), b::out_of_range_error);
+
+        // Failed reads do not consume anything.
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), r.position());
+
+        uint16_t value = 0;
+        r >> value;
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0x0201), value);
+        CPPUNIT_ASSERT_THROW(r.read<uint16_t>(), b::out_of_range_error);
+        CPPUNIT_ASSERT_EQUAL(uint8_t(3), r.read<uint8_t>());
+    }
+
+
+
+    void testWriter()
+    {
+        namespace b = meta::byte_order;
+
+        unsigned char buffer[7] = { 0 };
+
+        b::writer<> w(buffer, sizeof(buffer));
+        w << uint16_t(42) << uint32_t(0x01020304);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(6), w.position());
+        CPPUNIT_ASSERT_EQUAL(0x00, int(buffer[0]));
+        CPPUNIT_ASSERT_EQUAL(0x2a, int(buffer[1]));
+        CPPUNIT_ASSERT_EQUAL(0x01, int(buffer[2]));
+        CPPUNIT_ASSERT_EQUAL(0x04, int(buffer[5]));
+
+        CPPUNIT_ASSERT_THROW(w.write(uint16_t(1)), b::out_of_range_error);
+        w.write_unchecked(uint8_t(0xff));
+        CPPUNIT_ASSERT_EQUAL(0xff, int(buffer[6]));
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), w.remaining());
+    }
+
+
+
+    void testRoundTrip()
+    {
+        namespace b = meta::byte_order;
+
+        char buffer[32];
+
+        b::writer<b::META_LITTLE_ENDIAN> w(buffer, sizeof(buffer));
+        w.require(14);
+        w.write_unchecked(uint64_t(0x0102030405060708ULL));
+        w.write_unchecked(int32_t(-12345));
+        w.write_unchecked(uint16_t(666));
+
+        b::reader<b::META_LITTLE_ENDIAN> r(buffer, w.position());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0x0102030405060708ULL), r.read<uint64_t>());
+        CPPUNIT_ASSERT_EQUAL(int32_t(-12345), r.read<int32_t>());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(666), r.read<uint16_t>());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), r.remaining());
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CursorTest);
@@ -0,0 +1,248 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <meta/fixed.h>
+
+namespace {
+
+typedef meta::math::ratio<int64_t, 1, 100> cents;
+typedef meta::math::ratio<int64_t, 1, 10000> basis_points;
+
+} // anonymous namespace
+
+
+class FixedTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(FixedTest);
+
+      CPPUNIT_TEST(testArithmetic);
+      CPPUNIT_TEST(testMultiply);
+      CPPUNIT_TEST(testRescale);
+      CPPUNIT_TEST(testColumns);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testArithmetic()
+    {
+      namespace m = meta::math;
+      typedef m::fixed<int64_t, cents> money;
+
+      money a = money::from_raw(125);
+      money b(3);
+      CPPUNIT_ASSERT_EQUAL(int64_t(0), money().raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(300), b.raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(425), (a + b).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-175), (a - b).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-125), (-a).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(375), (a * int64_t(3)).raw());
+      CPPUNIT_ASSERT_EQUAL(1.25, a.to_double());
+
+      // 0.1 + 0.2 == 0.3, unlike with doubles.
+      CPPUNIT_ASSERT(money::from_raw(10) + money::from_raw(20)
+          == money::from_raw(30));
+
+      CPPUNIT_ASSERT(a < b);
+      CPPUNIT_ASSERT(a <= b);
+      CPPUNIT_ASSERT(b > a);
+      CPPUNIT_ASSERT(b >= a);
+      CPPUNIT_ASSERT(a != b);
+      CPPUNIT_ASSERT(-b < -a);
+
+      money c = a;
+      c += b;
+      c -= money::from_raw(25);
+      c *= int64_t(2);
+      CPPUNIT_ASSERT_EQUAL(int64_t(800), c.raw());
+    }
+
+
+
+    template <typename roundingT>
+    int64_t multiplied(int64_t a, int64_t b)
+    {
+      namespace m = meta::math;
+      typedef m::fixed<int64_t, cents> money;
+      return money::from_raw(a).template multiply<roundingT>(
+          money::from_raw(b)).raw();
+    }
+
+    void testMultiply()
+    {
+      namespace m = meta::math;
+
+      // 1.25 * 0.5 = 0.625, 1.25 * 0.51 = 0.6375, 0.63 * 0.5 = 0.315
+      CPPUNIT_ASSERT_EQUAL(int64_t(62), multiplied<m::round_toward_zero>(125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(62), multiplied<m::round_down>(125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(63), multiplied<m::round_up>(125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(63), multiplied<m::round_half_away_from_zero>(125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(62), multiplied<m::round_half_even>(125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(32), multiplied<m::round_half_even>(63, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(64), multiplied<m::round_half_even>(125, 51));
+      CPPUNIT_ASSERT_EQUAL(int64_t(63), multiplied<m::round_toward_zero>(125, 51));
+
+      CPPUNIT_ASSERT_EQUAL(int64_t(-62), multiplied<m::round_toward_zero>(-125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-63), multiplied<m::round_down>(125, -50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-62), multiplied<m::round_up>(-125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-63), multiplied<m::round_half_away_from_zero>(-125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-62), multiplied<m::round_half_even>(-125, 50));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-64), multiplied<m::round_half_even>(125, -51));
+      CPPUNIT_ASSERT_EQUAL(int64_t(62), multiplied<m::round_down>(-125, -50));
+
+      // The default policy, and operator*
+      typedef m::fixed<int64_t, cents> money;
+      CPPUNIT_ASSERT_EQUAL(int64_t(63), (money::from_raw(125) * money::from_raw(50)).raw());
+      money product = money::from_raw(-125);
+      product *= money::from_raw(51);
+      CPPUNIT_ASSERT_EQUAL(int64_t(-64), product.raw());
+
+      // The raw product exceeds 64 bits.
+      typedef m::fixed<int64_t, basis_points> price;
+      CPPUNIT_ASSERT_EQUAL(int64_t(8000000000000000000LL),
+          (price::from_raw(4000000000000000000LL) * price(2)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-4000000000000000001LL),
+          (price::from_raw(-4000000000000000001LL) * price(1)).raw());
+
+      // A scale that is not a unit fraction: 7.5 * 7.5 = 56.25, which is
+      // 22.5 units of 2.5.
+      typedef m::fixed<int32_t, m::ratio<int32_t, 5, 2>, m::round_half_even> odd;
+      CPPUNIT_ASSERT_EQUAL(int32_t(22), (odd::from_raw(3) * odd::from_raw(3)).raw());
+      CPPUNIT_ASSERT_EQUAL(int32_t(23), (odd::from_raw(3).multiply<
+            m::round_half_away_from_zero>(odd::from_raw(3))).raw());
+
+      // Unsigned values never round down to a negative.
+      typedef m::fixed<uint32_t, m::ratio<uint32_t, 1, 100>, m::round_down> umoney;
+      CPPUNIT_ASSERT_EQUAL(uint32_t(62), (umoney::from_raw(125) * umoney::from_raw(50)).raw());
+    }
+
+
+
+    void testRescale()
+    {
+      namespace m = meta::math;
+      typedef m::fixed<int64_t, cents> money;
+      typedef m::fixed<int64_t, basis_points> price;
+      typedef m::fixed<int64_t, cents, m::round_half_even> even_money;
+      typedef m::fixed<int64_t, cents, m::round_toward_zero> truncated_money;
+
+      // Exact in one direction, rounded in the other.
+      CPPUNIT_ASSERT_EQUAL(int64_t(12300), price(money::from_raw(123)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-12300), price(money::from_raw(-123)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(123), money(price::from_raw(12345)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(124), money(price::from_raw(12350)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-124), money(price::from_raw(-12350)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(124), even_money(price::from_raw(12350)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(122), even_money(price::from_raw(12250)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-123), truncated_money(price::from_raw(-12399)).raw());
+
+      // Same as convert() when truncating.
+      CPPUNIT_ASSERT_EQUAL(
+          (m::convert<basis_points, cents>(int64_t(-987654321))),
+          truncated_money(price::from_raw(-987654321)).raw());
+
+      // Into another raw type
+      typedef m::fixed<int32_t, m::ratio<int32_t, 1, 10> > dimes;
+      CPPUNIT_ASSERT_EQUAL(int32_t(-12), dimes(money::from_raw(-123)).raw());
+      CPPUNIT_ASSERT_EQUAL(int64_t(-12000), price(dimes::from_raw(-12)).raw());
+
+      // Whole units into a scale coarser than one.
+      typedef m::fixed<int32_t, m::ratio<int32_t, 1000, 1> > thousands;
+      typedef m::fixed<int32_t, m::ratio<int32_t, 1000, 1>, m::round_half_even>
+        even_thousands;
+      CPPUNIT_ASSERT_EQUAL(int32_t(2), thousands(1500).raw());
+      CPPUNIT_ASSERT_EQUAL(int32_t(3), thousands(2500).raw());
+      CPPUNIT_ASSERT_EQUAL(int32_t(-3), thousands(-2500).raw());
+      CPPUNIT_ASSERT_EQUAL(int32_t(2), even_thousands(2500).raw());
+      CPPUNIT_ASSERT_EQUAL(1000.0, thousands(1000).to_double());
+    }
+
+
+
+    template <typename intT>
+    void testColumnsImpl()
+    {
+      namespace m = meta::math;
+      typedef m::fixed<intT, m::ratio<intT, 1, 100> > value_t;
+
+      // Partial sums of narrow values exceed intT, the total does not;
+      // lengths around the vector widths.
+      intT const big = sizeof(intT) < sizeof(int64_t)
+        ? intT(std::numeric_limits<intT>::max() - 1)
+        : intT(std::numeric_limits<intT>::max() / 256);
+      std::vector<value_t> values;
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (std::size_t i = 0 ; i < 67 ; ++i) {
+        values.push_back(value_t::from_raw(big));
+      }
+      for (std::size_t i = 0 ; i < 67 ; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        values.push_back(value_t::from_raw(intT(state % 1000)));
+        values.push_back(value_t::from_raw(intT(0 - big)));
+      }
+
+      for (std::size_t count = 1 ; count <= values.size() ; count += 1) {
+        std::size_t start = values.size() - count;
+        int64_t expected_sum = 0;
+        intT expected_min = values[start].raw();
+        intT expected_max = values[start].raw();
+        for (std::size_t i = start ; i < values.size() ; ++i) {
+          expected_sum += values[i].raw();
+          expected_min = std::min(expected_min, values[i].raw());
+          expected_max = std::max(expected_max, values[i].raw());
+        }
+        if (expected_sum >= std::numeric_limits<intT>::min()
+            && expected_sum <= std::numeric_limits<intT>::max())
+        {
+          CPPUNIT_ASSERT_EQUAL(intT(expected_sum),
+              m::sum(&values[start], count).raw());
+        }
+        CPPUNIT_ASSERT_EQUAL(expected_min,
+            m::minimum(&values[start], count).raw());
+        CPPUNIT_ASSERT_EQUAL(expected_max,
+            m::maximum(&values[start], count).raw());
+      }
+
+      CPPUNIT_ASSERT_EQUAL(intT(0), m::sum(&values[0], 0).raw());
+      CPPUNIT_ASSERT_THROW(m::minimum(&values[0], 0), std::invalid_argument);
+      CPPUNIT_ASSERT_THROW(m::maximum(&values[0], 0), std::invalid_argument);
+    }
+
+    void testColumns()
+    {
+      testColumnsImpl<int16_t>();
+      testColumnsImpl<int32_t>();
+      testColumnsImpl<int64_t>();
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FixedTest);
@@ -0,0 +1,261 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <meta/flat_map.h>
+
+
+class FlatMapTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(FlatMapTest);
+
+      CPPUNIT_TEST(testBasics);
+      CPPUNIT_TEST(testAgainstUnorderedMap);
+      CPPUNIT_TEST(testHeterogeneousLookup);
+      CPPUNIT_TEST(testHashedKeys);
+      CPPUNIT_TEST(testReserve);
+      CPPUNIT_TEST(testCopyAndMove);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testBasics()
+    {
+      namespace h = meta::hash;
+
+      h::flat_map<int, std::string> map;
+      CPPUNIT_ASSERT(map.empty());
+      CPPUNIT_ASSERT(map.find(1) == map.end());
+      CPPUNIT_ASSERT(map.begin() == map.end());
+
+      CPPUNIT_ASSERT(map.insert(std::make_pair(1, std::string("one"))).second);
+      CPPUNIT_ASSERT(!map.insert(std::make_pair(1, std::string("uno"))).second);
+      CPPUNIT_ASSERT(map.emplace(2, "two").second);
+      CPPUNIT_ASSERT(map.try_emplace(3, 5, 'x').second);
+      map[4] = "four";
+
+      CPPUNIT_ASSERT_EQUAL(std::size_t(4), map.size());
+      CPPUNIT_ASSERT_EQUAL(std::string("one"), map.at(1));
+      CPPUNIT_ASSERT_EQUAL(std::string("two"), map.find(2)->second);
+      CPPUNIT_ASSERT_EQUAL(std::string("xxxxx"), map[3]);
+      CPPUNIT_ASSERT_THROW(map.at(5), std::out_of_range);
+
+      std::size_t count = 0;
+      for (auto const & entry : map) {
+        CPPUNIT_ASSERT(entry.first >= 1 && entry.first <= 4);
+        ++count;
+      }
+      CPPUNIT_ASSERT_EQUAL(std::size_t(4), count);
+
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), map.erase(2));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(0), map.erase(2));
+      CPPUNIT_ASSERT(!map.contains(2));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(3), map.size());
+
+      map.clear();
+      CPPUNIT_ASSERT(map.empty());
+      CPPUNIT_ASSERT(map.capacity() > 0);
+      CPPUNIT_ASSERT(map.begin() == map.end());
+    }
+
+
+
+    void testAgainstUnorderedMap()
+    {
+      namespace h = meta::hash;
+
+      // Few distinct keys and many erasures, so that deleted slots are
+      // reused, and tables are rehashed to reclaim them.
+      h::flat_map<uint64_t, uint64_t> map;
+      std::unordered_map<uint64_t, uint64_t> expected;
+
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (uint64_t i = 0 ; i < 200000 ; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t key = (state >> 33) % 3000;
+        switch ((state >> 20) % 3) {
+          case 0:
+            map[key] = i;
+            expected[key] = i;
+            break;
+
+          case 1:
+            CPPUNIT_ASSERT_EQUAL(expected.erase(key), map.erase(key));
+            break;
+
+          default:
+            CPPUNIT_ASSERT_EQUAL(expected.count(key), map.count(key));
+            if (expected.count(key)) {
+              CPPUNIT_ASSERT_EQUAL(expected[key], map.find(key)->second);
+            }
+            break;
+        }
+        CPPUNIT_ASSERT_EQUAL(expected.size(), map.size());
+      }
+
+      std::size_t count = 0;
+      for (auto const & entry : map) {
+        CPPUNIT_ASSERT_EQUAL(expected[entry.first], entry.second);
+        ++count;
+      }
+      CPPUNIT_ASSERT_EQUAL(expected.size(), count);
+
+      // Erasing while iterating
+      for (auto iter = map.begin() ; iter != map.end() ; ) {
+        if (iter->first % 2) {
+          iter = map.erase(iter);
+        } else {
+          ++iter;
+        }
+      }
+      for (auto const & entry : map) {
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0), entry.first % 2);
+      }
+    }
+
+
+
+    void testHeterogeneousLookup()
+    {
+      namespace h = meta::hash;
+
+      h::flat_map<std::string, int> map = { { "foo", 1 }, { "bar", 2 } };
+
+      char const * foo = "foo";
+      CPPUNIT_ASSERT_EQUAL(1, map.find(foo)->second);
+      CPPUNIT_ASSERT_EQUAL(2, map.find("bar")->second);
+      CPPUNIT_ASSERT(map.contains("foo"));
+      CPPUNIT_ASSERT(!map.contains("baz"));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), map.count("bar"));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), map.erase("bar"));
+      CPPUNIT_ASSERT(!map.contains(std::string("bar")));
+
+      // Other hash functions work as well, just without heterogeneous lookup.
+      h::flat_map<std::string, int, std::hash<std::string>,
+        std::equal_to<std::string> > other;
+      other["foo"] = 3;
+      CPPUNIT_ASSERT_EQUAL(3, other.find("foo")->second);
+    }
+
+
+
+    void testHashedKeys()
+    {
+      namespace h = meta::hash;
+
+      h::hashed<std::string> key(std::string("key"));
+      CPPUNIT_ASSERT_EQUAL(key.hash(), h::transparent_hash()(key));
+
+      h::flat_map<h::hashed<std::string>, int> map;
+      map[key] = 1;
+      map[h::make_hashed(std::string("other"))] = 2;
+      CPPUNIT_ASSERT_EQUAL(1, map.at(h::make_hashed(std::string("key"))));
+      CPPUNIT_ASSERT(!map.contains(h::make_hashed(std::string("missing"))));
+
+      // A key hashed once, looked up in several tables of plain strings.
+      h::flat_map<std::string, int> first;
+      h::flat_map<std::string, int> second;
+      for (int i = 0 ; i < 100 ; ++i) {
+        first[std::to_string(i)] = i;
+        second[std::to_string(i * 2)] = i;
+      }
+      h::hashed<std::string> lookup(std::string("42"));
+      CPPUNIT_ASSERT_EQUAL(h::transparent_hash()(std::string("42")),
+          h::transparent_hash()(lookup));
+      CPPUNIT_ASSERT(first.contains(lookup));
+      CPPUNIT_ASSERT_EQUAL(42, first.find(lookup)->second);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), second.count(lookup));
+      CPPUNIT_ASSERT_EQUAL(21, second.find(lookup)->second);
+      CPPUNIT_ASSERT(!second.contains(h::make_hashed(std::string("43"))));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), first.erase(lookup));
+      CPPUNIT_ASSERT(!first.contains(lookup));
+    }
+
+
+
+    void testReserve()
+    {
+      namespace h = meta::hash;
+
+      h::flat_map<int, int> map;
+      map.reserve(1000);
+      std::size_t capacity = map.capacity();
+      CPPUNIT_ASSERT(capacity >= 1000);
+
+      for (int i = 0 ; i < 1000 ; ++i) {
+        map[i] = i;
+      }
+      CPPUNIT_ASSERT_EQUAL(capacity, map.capacity());
+
+      // Reserving less than is present changes nothing.
+      map.reserve(10);
+      CPPUNIT_ASSERT_EQUAL(capacity, map.capacity());
+      for (int i = 0 ; i < 1000 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(i, map.at(i));
+      }
+    }
+
+
+
+    void testCopyAndMove()
+    {
+      namespace h = meta::hash;
+
+      h::flat_map<std::string, std::string> map;
+      for (int i = 0 ; i < 100 ; ++i) {
+        map[std::to_string(i)] = std::string(50, 'a' + i % 26);
+      }
+      for (int i = 0 ; i < 100 ; i += 3) {
+        map.erase(std::to_string(i));
+      }
+
+      h::flat_map<std::string, std::string> copy(map);
+      CPPUNIT_ASSERT_EQUAL(map.size(), copy.size());
+      for (auto const & entry : map) {
+        CPPUNIT_ASSERT_EQUAL(entry.second, copy.at(entry.first));
+      }
+
+      copy["new"] = "value";
+      CPPUNIT_ASSERT(!map.contains("new"));
+
+      h::flat_map<std::string, std::string> moved(std::move(copy));
+      CPPUNIT_ASSERT(copy.empty());
+      CPPUNIT_ASSERT_EQUAL(std::string("value"), moved.at("new"));
+
+      copy = moved;
+      CPPUNIT_ASSERT_EQUAL(moved.size(), copy.size());
+      moved = h::flat_map<std::string, std::string>();
+      CPPUNIT_ASSERT(moved.empty());
+      moved["after"] = "move";
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1), moved.size());
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlatMapTest);
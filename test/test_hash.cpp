@@ -21,7 +21,13 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include <cmath>
 
 #include <meta/hash.h>
 
@@ -33,6 +39,23 @@ public:
     CPPUNIT_TEST_SUITE(HashTest);
 
       CPPUNIT_TEST(testHashCombine);
+      CPPUNIT_TEST(testHashOrder);
+      CPPUNIT_TEST(testUpperBits);
+      CPPUNIT_TEST(testFNV1a);
+      CPPUNIT_TEST(testWyhash);
+      CPPUNIT_TEST(testConstexprHashLarge);
+      CPPUNIT_TEST(testMulHi);
+      CPPUNIT_TEST(testSwitchOnString);
+      CPPUNIT_TEST(testHashBytes);
+      CPPUNIT_TEST(testHashBytesKernels);
+      CPPUNIT_TEST(testStreaming);
+      CPPUNIT_TEST(testHashBatch);
+      CPPUNIT_TEST(testHashBytesBatch);
+      CPPUNIT_TEST(testTreeHash);
+      CPPUNIT_TEST(testHashed);
+      CPPUNIT_TEST(testJumpConsistentHash);
+      CPPUNIT_TEST(testRendezvousHash);
+      CPPUNIT_TEST(testRendezvousKernels);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -61,6 +84,545 @@ private:
       size_t h4 = h::multi_hash(a, b, 123);
       CPPUNIT_ASSERT(h1 != h4);
     }
+
+
+
+    void testHashOrder()
+    {
+      namespace h = meta::hash;
+
+      CPPUNIT_ASSERT(h::multi_hash(1, 2) != h::multi_hash(2, 1));
+      CPPUNIT_ASSERT(h::multi_hash(0) != h::multi_hash(0, 0));
+      CPPUNIT_ASSERT(h::multi_hash(1, 2, 3) != h::multi_hash(3, 2, 1));
+
+      std::size_t seed = 0;
+      h::hash_combine(seed, std::hash<int>()(1));
+      h::hash_combine(seed, std::hash<std::string>()("two"));
+      std::size_t other = 0;
+      h::hash_combine(other, std::hash<std::string>()("two"));
+      h::hash_combine(other, std::hash<int>()(1));
+      CPPUNIT_ASSERT(seed != other);
+
+      static_assert(h::combine(0, 1) != h::combine(1, 0), "combine");
+    }
+
+
+
+    void testUpperBits()
+    {
+      namespace h = meta::hash;
+
+      // std::hash<int> is the identity function in most implementations, so
+      // for small keys, the upper bits only get populated by mixing. Hashing
+      // 1024 consecutive keys into 1024 buckets by the upper bits should fill
+      // about 1 - 1/e of the buckets.
+      std::size_t const bits = 10;
+      std::vector<bool> used(std::size_t(1) << bits);
+      for (int i = 0 ; i < (1 << bits) ; ++i) {
+        used[h::multi_hash(i) >> (sizeof(std::size_t) * 8 - bits)] = true;
+      }
+
+      std::size_t count = 0;
+      for (std::size_t i = 0 ; i < used.size() ; ++i) {
+        count += used[i];
+      }
+      CPPUNIT_ASSERT(count > 600);
+    }
+
+
+
+    void testFNV1a()
+    {
+      namespace h = meta::hash;
+
+      // Reference values
+      static_assert(h::fnv1a("", 0) == 0xcbf29ce484222325ULL, "fnv1a");
+      static_assert(h::fnv1a("a", 1) == 0xaf63dc4c8601ec8cULL, "fnv1a");
+      static_assert(h::fnv1a("foobar", 6) == 0x85944171f73967e8ULL, "fnv1a");
+
+      CPPUNIT_ASSERT_EQUAL(uint64_t(0x85944171f73967e8ULL),
+          h::fnv1a(std::string("foobar")));
+
+      // Inputs longer than the 8 byte steps
+      constexpr uint64_t compile_time = h::fnv1a("The quick brown fox", 19);
+      std::string runtime = "The quick brown fox";
+      CPPUNIT_ASSERT_EQUAL(compile_time, h::fnv1a(runtime));
+    }
+
+
+
+    void testWyhash()
+    {
+      namespace h = meta::hash;
+
+      constexpr uint64_t short_key = h::wyhash("ORDER", 5);
+      constexpr uint64_t long_key = h::wyhash(
+          "A somewhat longer key, which spans several blocks of input", 58);
+
+      CPPUNIT_ASSERT_EQUAL(short_key, h::wyhash(std::string("ORDER")));
+      CPPUNIT_ASSERT_EQUAL(long_key, h::wyhash(std::string(
+          "A somewhat longer key, which spans several blocks of input")));
+      CPPUNIT_ASSERT(h::wyhash("ORDER", 5, 1) != short_key);
+
+      // Every length takes a slightly different path; all prefixes of a
+      // string should hash differently.
+      std::string const text(100, 'x');
+      std::vector<uint64_t> hashes;
+      for (std::size_t i = 0 ; i <= text.size() ; ++i) {
+        hashes.push_back(h::wyhash(text.data(), i));
+      }
+      std::sort(hashes.begin(), hashes.end());
+      CPPUNIT_ASSERT(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+    }
+
+
+
+    void testConstexprHashLarge()
+    {
+      namespace h = meta::hash;
+      namespace d = meta::hash::detail;
+
+      // The recursive implementations for constant evaluation must agree with
+      // the loops used at runtime, and must not exhaust the stack on large
+      // input even in unoptimized builds.
+      std::string data;
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (std::size_t i = 0 ; i < (std::size_t(6) << 20) + 13 ; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data.push_back(static_cast<char>(state));
+      }
+
+      std::size_t const sizes[] = { 0, 7, 8, 15, 16, 17, 31, 32, 33, 1000,
+        std::size_t(4) << 20, data.size() };
+      for (std::size_t i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(
+            d::fnv1a_loop(data.data(), sizes[i], d::FNV1A_OFFSET),
+            d::fnv1a_impl(data.data(), sizes[i], d::FNV1A_OFFSET));
+        CPPUNIT_ASSERT_EQUAL(
+            d::wyhash_loop(data.data(), sizes[i], d::wyhash_seed(42)),
+            d::wyhash_seeded(data.data(), sizes[i], d::wyhash_seed(42)));
+      }
+
+      CPPUNIT_ASSERT_EQUAL(
+          d::fnv1a_impl(data.data(), data.size(), d::FNV1A_OFFSET),
+          h::fnv1a(data));
+      CPPUNIT_ASSERT_EQUAL(
+          d::wyhash_seeded(data.data(), data.size(), d::wyhash_seed(0)),
+          h::wyhash(data.data(), data.size()));
+      CPPUNIT_ASSERT_EQUAL(h::wyhash(data), h::key_hash(data));
+    }
+
+
+
+    void testMulHi()
+    {
+      namespace h = meta::hash;
+
+      static_assert(h::detail::mul_hi_portable(~uint64_t(0), ~uint64_t(0))
+          == ~uint64_t(0) - 1, "mul_hi");
+      static_assert(h::detail::mul_hi_portable(uint64_t(1) << 32,
+            uint64_t(1) << 32) == 1, "mul_hi");
+
+      uint64_t state = 0x9e3779b97f4a7c15ULL;
+      for (int i = 0 ; i < 1000 ; ++i) {
+        uint64_t a = state = h::detail::wymix(state, 0x2545f4914f6cdd1dULL);
+        uint64_t b = state = h::detail::wymix(state, 0x2545f4914f6cdd1dULL);
+        CPPUNIT_ASSERT_EQUAL(h::detail::mul_hi(a, b),
+            h::detail::mul_hi_portable(a, b));
+      }
+    }
+
+
+
+    int dispatch(std::string const & type)
+    {
+      using namespace meta::hash::literals;
+
+      switch (meta::hash::key_hash(type)) {
+        case "ORDER"_h:
+          return 1;
+
+        case "CANCEL"_h:
+          return 2;
+
+        case "A_MUCH_LONGER_MESSAGE_TYPE_NAME"_h:
+          return 3;
+
+        default:
+          return 0;
+      }
+    }
+
+    void testSwitchOnString()
+    {
+      CPPUNIT_ASSERT_EQUAL(1, dispatch("ORDER"));
+      CPPUNIT_ASSERT_EQUAL(2, dispatch("CANCEL"));
+      CPPUNIT_ASSERT_EQUAL(3, dispatch("A_MUCH_LONGER_MESSAGE_TYPE_NAME"));
+      CPPUNIT_ASSERT_EQUAL(0, dispatch("ORDERS"));
+      CPPUNIT_ASSERT_EQUAL(0, dispatch(""));
+    }
+
+
+
+    static std::vector<unsigned char> random_bytes(std::size_t size)
+    {
+      std::vector<unsigned char> result(size);
+      uint64_t state = 0x9e3779b97f4a7c15ULL;
+      for (std::size_t i = 0 ; i < size ; ++i) {
+        state = meta::hash::detail::wymix(state, 0x2545f4914f6cdd1dULL);
+        result[i] = static_cast<unsigned char>(state);
+      }
+      return result;
+    }
+
+
+
+    void testHashBytes()
+    {
+      namespace h = meta::hash;
+
+      std::vector<unsigned char> data = random_bytes(5000);
+      char const * str = reinterpret_cast<char const *>(&data[0]);
+
+      // Short input is hashed with wyhash.
+      for (std::size_t size = 0 ; size <= 128 ; ++size) {
+        CPPUNIT_ASSERT_EQUAL(h::wyhash(str, size), h::hash_bytes(str, size));
+        CPPUNIT_ASSERT_EQUAL(h::wyhash(str, size, 42),
+            h::hash_bytes(str, size, 42));
+      }
+
+      // All lengths, seeds and single bit changes produce different hashes.
+      std::vector<uint64_t> hashes;
+      for (std::size_t size = 0 ; size <= 1100 ; ++size) {
+        hashes.push_back(h::hash_bytes(&data[0], size));
+      }
+      hashes.push_back(h::hash_bytes(&data[0], 1000, 1));
+      hashes.push_back(h::hash_bytes(&data[0], 1000, 2));
+      for (std::size_t i = 0 ; i < 1000 ; i += 97) {
+        data[i] ^= 0x10;
+        hashes.push_back(h::hash_bytes(&data[0], 1000));
+        data[i] ^= 0x10;
+      }
+      std::sort(hashes.begin(), hashes.end());
+      CPPUNIT_ASSERT(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+
+      // Alignment does not matter
+      std::vector<unsigned char> copy(data.begin(), data.end());
+      copy.insert(copy.begin(), 0);
+      CPPUNIT_ASSERT_EQUAL(h::hash_bytes(&data[0], 4999),
+          h::hash_bytes(&copy[1], 4999));
+    }
+
+
+
+    void testHashBytesKernels()
+    {
+      namespace d = meta::hash::detail;
+
+      std::vector<unsigned char> data = random_bytes(64 * 40);
+      uint64_t secret[d::SECRET_WORDS];
+      d::make_secret(secret, 12345);
+
+      uint64_t expected[d::LANES];
+      d::init_lanes(expected);
+      d::scalar_accumulate(expected, &data[0], 37, 3, secret);
+
+      uint64_t result[d::LANES];
+      d::init_lanes(result);
+      d::accumulate(result, &data[0], 37, 3, secret);
+
+      for (std::size_t i = 0 ; i < d::LANES ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(expected[i], result[i]);
+      }
+    }
+
+
+
+    void testStreaming()
+    {
+      namespace h = meta::hash;
+
+      std::vector<unsigned char> data = random_bytes(5000);
+      std::size_t const sizes[] = { 0, 16, 17, 128, 129, 256, 257, 1000, 5000 };
+      std::size_t const chunks[] = { 1, 7, 63, 64, 65, 256, 300, 5000 };
+
+      for (std::size_t size : sizes) {
+        uint64_t expected = h::hash_bytes(&data[0], size, 7);
+        for (std::size_t chunk : chunks) {
+          h::hasher hasher(7);
+          for (std::size_t offset = 0 ; offset < size ; offset += chunk) {
+            hasher.update(&data[offset], std::min(chunk, size - offset));
+          }
+          CPPUNIT_ASSERT_EQUAL(expected, hasher.finalize());
+        }
+      }
+
+      // Irregular chunks, and intermediate results
+      h::hasher hasher;
+      std::size_t offset = 0;
+      for (std::size_t chunk = 1 ; offset + chunk <= data.size() ; ++chunk) {
+        hasher.update(&data[offset], chunk);
+        offset += chunk;
+        CPPUNIT_ASSERT_EQUAL(h::hash_bytes(&data[0], offset), hasher.finalize());
+      }
+    }
+
+
+
+    struct count_prefetch
+    {
+      std::vector<uint64_t> & hashes;
+
+      void operator()(uint64_t hash) const
+      {
+        hashes.push_back(hash);
+      }
+    };
+
+    void testHashBatch()
+    {
+      namespace h = meta::hash;
+
+      std::vector<uint64_t> ints;
+      std::vector<std::string> strings;
+      for (uint64_t i = 0 ; i < 103 ; ++i) {
+        ints.push_back(i * 0x10001);
+        strings.push_back("key-" + std::to_string(i));
+      }
+
+      std::vector<std::size_t> out(ints.size());
+      h::hash_batch(&ints[0], ints.size(), &out[0]);
+      for (std::size_t i = 0 ; i < ints.size() ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(h::multi_hash(ints[i]), out[i]);
+      }
+
+      // Prefetches are issued for every hash.
+      std::vector<uint64_t> prefetched;
+      count_prefetch prefetch = { prefetched };
+      h::hash_batch(&strings[0], strings.size(), &out[0], prefetch);
+      CPPUNIT_ASSERT_EQUAL(strings.size(), prefetched.size());
+      for (std::size_t i = 0 ; i < strings.size() ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(h::multi_hash(strings[i]), out[i]);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(out[i]), prefetched[i]);
+      }
+
+      std::vector<char> table(64 * 128);
+      h::hash_batch(&ints[0], ints.size(), &out[0],
+          h::bucket_prefetch(&table[0], 64, 128));
+
+      // All kernels finish the same way.
+      std::vector<std::size_t> expected(ints.begin(), ints.end());
+      std::vector<std::size_t> result(ints.begin(), ints.end());
+      h::detail::scalar_finalize_batch(&expected[0], expected.size());
+      h::detail::finalize_batch(&result[0], result.size());
+      CPPUNIT_ASSERT(expected == result);
+    }
+
+
+
+    void testHashBytesBatch()
+    {
+      namespace h = meta::hash;
+
+      std::vector<unsigned char> data = random_bytes(300 * 11);
+      std::size_t const sizes[] = { 0, 1, 3, 4, 8, 12, 16, 17, 32, 33, 128,
+        129, 300 };
+
+      for (std::size_t size : sizes) {
+        for (std::size_t count = 0 ; count <= 11 ; ++count) {
+          std::vector<uint64_t> out(count + 1, 42);
+          h::hash_bytes_batch(&data[0], size, count, &out[0], 3);
+          for (std::size_t i = 0 ; i < count ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(h::hash_bytes(&data[i * size], size, 3),
+                out[i]);
+          }
+          CPPUNIT_ASSERT_EQUAL(uint64_t(42), out[count]);
+        }
+      }
+    }
+
+
+
+    void testTreeHash()
+    {
+      namespace h = meta::hash;
+
+      std::size_t const leaf = h::TREE_LEAF_SIZE;
+      std::vector<unsigned char> data = random_bytes(leaf * 7 / 2);
+      std::size_t const sizes[] = { 0, 1, leaf - 1, leaf, leaf + 1,
+        data.size() };
+
+      std::vector<uint64_t> hashes;
+      for (std::size_t size : sizes) {
+        uint64_t expected = h::tree_hash(&data[0], size, 1);
+        for (unsigned int threads = 0 ; threads <= 5 ; ++threads) {
+          CPPUNIT_ASSERT_EQUAL(expected, h::tree_hash(&data[0], size, threads));
+        }
+        hashes.push_back(expected);
+        hashes.push_back(h::tree_hash(&data[0], size, 2, 1));
+      }
+
+      // Changes to any leaf change the result.
+      data[leaf * 3 + 5] ^= 1;
+      hashes.push_back(h::tree_hash(&data[0], data.size(), 3));
+      data[5] ^= 1;
+      hashes.push_back(h::tree_hash(&data[0], data.size(), 3));
+
+      std::sort(hashes.begin(), hashes.end());
+      CPPUNIT_ASSERT(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+    }
+
+
+
+    void testHashed()
+    {
+      namespace h = meta::hash;
+
+      std::string value = "some key";
+      h::hashed<std::string> key(value);
+      CPPUNIT_ASSERT_EQUAL(value, key.value());
+      CPPUNIT_ASSERT_EQUAL(value.size(), key->size());
+      CPPUNIT_ASSERT_EQUAL(std::size_t(h::key_hash(value)), key.hash());
+      CPPUNIT_ASSERT_EQUAL(h::multi_hash(42), h::make_hashed(42).hash());
+      CPPUNIT_ASSERT_EQUAL(key.hash(), std::hash<h::hashed<std::string> >()(key));
+
+      h::hashed<std::string> moved(std::string("some key"));
+      CPPUNIT_ASSERT(key == moved);
+      CPPUNIT_ASSERT(key != h::make_hashed(std::string("other key")));
+      CPPUNIT_ASSERT(h::make_hashed(42) == h::hashed<int>(42));
+
+      // Against plain values
+      CPPUNIT_ASSERT(key == value);
+      CPPUNIT_ASSERT(value == key);
+      CPPUNIT_ASSERT(key != std::string("other key"));
+      CPPUNIT_ASSERT(std::string("other key") != key);
+      CPPUNIT_ASSERT(h::make_hashed(42) == 42);
+
+      std::unordered_map<h::hashed<std::string>, int> map;
+      map[key] = 1;
+      map[h::make_hashed(std::string("other key"))] = 2;
+      CPPUNIT_ASSERT_EQUAL(1, map[moved]);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(2), map.size());
+    }
+
+
+
+    void testJumpConsistentHash()
+    {
+      namespace h = meta::hash;
+
+      // Reference values of the original implementation
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), h::jump_consistent_hash(1, 1));
+      CPPUNIT_ASSERT_EQUAL(uint32_t(43), h::jump_consistent_hash(42, 57));
+      CPPUNIT_ASSERT_EQUAL(uint32_t(361),
+          h::jump_consistent_hash(0xdead10ccULL, 666));
+      CPPUNIT_ASSERT_EQUAL(uint32_t(520), h::jump_consistent_hash(256, 1024));
+      CPPUNIT_ASSERT_THROW(h::jump_consistent_hash(1, 0),
+          std::invalid_argument);
+
+      // Adding a bucket moves keys only to the new bucket, and about
+      // 1 / buckets of them.
+      std::size_t moved = 0;
+      for (uint64_t i = 0 ; i < 10000 ; ++i) {
+        uint64_t key = h::multi_hash(i);
+        uint32_t before = h::jump_consistent_hash(key, 10);
+        uint32_t after = h::jump_consistent_hash(key, 11);
+        CPPUNIT_ASSERT(before < 10);
+        if (before != after) {
+          CPPUNIT_ASSERT_EQUAL(uint32_t(10), after);
+          ++moved;
+        }
+      }
+      CPPUNIT_ASSERT(moved > 800 && moved < 1000);
+    }
+
+
+
+    void testRendezvousHash()
+    {
+      namespace h = meta::hash;
+
+      h::rendezvous_hash nodes;
+      CPPUNIT_ASSERT(nodes.empty());
+      CPPUNIT_ASSERT_THROW(nodes(42), std::out_of_range);
+      CPPUNIT_ASSERT_THROW(nodes.add(1, 0), std::invalid_argument);
+
+      // Key shares follow the weights.
+      double const weights[] = { 1, 2, 3, 4, 1, 1, 1, 1, 1, 5 };
+      for (std::size_t i = 0 ; i < 10 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(i, nodes.add(h::multi_hash(std::string("node")
+                + std::to_string(i)), weights[i]));
+      }
+      CPPUNIT_ASSERT_EQUAL(std::size_t(10), nodes.size());
+
+      std::size_t const keys = 200000;
+      std::vector<std::size_t> placement(keys);
+      std::vector<std::size_t> counts(nodes.size());
+      for (std::size_t i = 0 ; i < keys ; ++i) {
+        placement[i] = nodes(h::multi_hash(i));
+        ++counts[placement[i]];
+      }
+      for (std::size_t i = 0 ; i < 10 ; ++i) {
+        double expected = keys * weights[i] / 20;
+        CPPUNIT_ASSERT(counts[i] > expected * 0.95);
+        CPPUNIT_ASSERT(counts[i] < expected * 1.05);
+      }
+
+      // Removing a node moves only its keys; the indices after it shift.
+      nodes.remove(3);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(9), nodes.size());
+      for (std::size_t i = 0 ; i < keys ; ++i) {
+        std::size_t node = nodes(h::multi_hash(i));
+        if (placement[i] != 3) {
+          CPPUNIT_ASSERT_EQUAL(placement[i] < 3 ? placement[i]
+              : placement[i] - 1, node);
+        }
+      }
+      CPPUNIT_ASSERT_THROW(nodes.remove(9), std::out_of_range);
+    }
+
+
+
+    void testRendezvousKernels()
+    {
+      namespace h = meta::hash;
+      namespace d = meta::hash::detail;
+
+      // Against the exact score, and between kernels, for all node counts
+      // up to a few groups.
+      for (uint32_t x = 1 ; x < (uint32_t(1) << 31) ; x += 65537) {
+        double exact = -std::log2(x / 2147483648.0) * 65536;
+        CPPUNIT_ASSERT(std::fabs(d::rendezvous_neg_log2(x) - exact) < 100);
+      }
+
+      h::rendezvous_hash nodes;
+      for (std::size_t n = 1 ; n <= 20 ; ++n) {
+        nodes.add(h::multi_hash(n), 1 + n % 3);
+        std::vector<uint32_t> seeds(24, 0);
+        std::vector<float> inverse_weights(24,
+            std::numeric_limits<float>::infinity());
+        for (std::size_t i = 0 ; i < n ; ++i) {
+          uint64_t node = h::multi_hash(i + 1);
+          seeds[i] = static_cast<uint32_t>(node ^ (node >> 32));
+          inverse_weights[i] = static_cast<float>(1.0 / (1 + (i + 1) % 3));
+        }
+
+        for (uint64_t key = 0 ; key < 1000 ; ++key) {
+          uint64_t hash = h::multi_hash(key);
+          std::size_t expected = d::scalar_rendezvous(&seeds[0],
+              &inverse_weights[0], 24, hash);
+          CPPUNIT_ASSERT_EQUAL(expected, nodes(hash));
+#if defined(META_X86_SIMD)
+          if (__builtin_cpu_supports("avx2")) {
+            CPPUNIT_ASSERT_EQUAL(expected, d::avx2_rendezvous(&seeds[0],
+                  &inverse_weights[0], 24, hash));
+          }
+#endif
+        }
+      }
+    }
 };
 
 
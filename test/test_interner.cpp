@@ -0,0 +1,166 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <meta/interner.h>
+
+
+class InternerTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(InternerTest);
+
+      CPPUNIT_TEST(testBasics);
+      CPPUNIT_TEST(testGrowth);
+      CPPUNIT_TEST(testConcurrent);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testBasics()
+    {
+      namespace h = meta::hash;
+
+      h::interner symbols;
+      CPPUNIT_ASSERT(symbols.empty());
+      CPPUNIT_ASSERT_EQUAL(h::NOT_INTERNED, symbols.find("foo"));
+
+      uint32_t foo = symbols.intern("foo");
+      uint32_t bar = symbols.intern(std::string("bar"));
+      uint32_t empty = symbols.intern("", 0);
+      uint32_t nul = symbols.intern("a\0b", 3);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), foo);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(1), bar);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(2), empty);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(3), nul);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(4), symbols.size());
+
+      CPPUNIT_ASSERT_EQUAL(foo, symbols.intern(std::string("foo")));
+      CPPUNIT_ASSERT_EQUAL(bar, symbols.find("bar"));
+      CPPUNIT_ASSERT_EQUAL(empty, symbols.find(""));
+      CPPUNIT_ASSERT_EQUAL(nul, symbols.find("a\0b", 3));
+      CPPUNIT_ASSERT_EQUAL(h::NOT_INTERNED, symbols.find("a"));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(4), symbols.size());
+
+      CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(symbols.c_str(foo)));
+      CPPUNIT_ASSERT_EQUAL(std::size_t(0), symbols.length(empty));
+      CPPUNIT_ASSERT_EQUAL(std::string("a\0b", 3), symbols.str(nul));
+      CPPUNIT_ASSERT_EQUAL(h::key_hash(std::string("bar")), symbols.hash(bar));
+    }
+
+
+
+    void testGrowth()
+    {
+      namespace h = meta::hash;
+
+      // Across several table sizes and ID segments, with a string that is
+      // too large for the arena's chunks.
+      h::interner symbols;
+      std::string large(100000, 'x');
+      for (uint32_t i = 0 ; i < 50000 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(i, symbols.intern("symbol" + std::to_string(i)));
+        if (i == 12345) {
+          CPPUNIT_ASSERT_EQUAL(i + 1, symbols.intern(large));
+          ++i;
+        }
+      }
+
+      char const * first = symbols.c_str(0);
+      for (uint32_t i = 0 ; i < 50000 ; ++i) {
+        if (i == 12346) {
+          CPPUNIT_ASSERT_EQUAL(large, symbols.str(i));
+          continue;
+        }
+        std::string expected = "symbol" + std::to_string(i);
+        CPPUNIT_ASSERT_EQUAL(i, symbols.find(expected));
+        CPPUNIT_ASSERT_EQUAL(expected, std::string(symbols.c_str(i)));
+      }
+      CPPUNIT_ASSERT_EQUAL(first, symbols.c_str(0));
+
+      h::interner presized(10000);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), presized.intern("foo"));
+    }
+
+
+
+    void testConcurrent()
+    {
+      namespace h = meta::hash;
+
+      // Threads intern overlapping sets of strings, in different orders,
+      // while others look them up.
+      h::interner symbols;
+      std::size_t const count = 20000;
+      std::size_t const writers = 4;
+      std::size_t const steps[writers] = { 1, 3, 7, 9 };
+      std::vector<std::vector<uint32_t> > ids(writers,
+          std::vector<uint32_t>(count));
+      std::atomic<bool> done(false);
+      std::atomic<std::size_t> errors(0);
+
+      std::vector<std::thread> threads;
+      for (std::size_t t = 0 ; t < writers ; ++t) {
+        threads.push_back(std::thread([&, t]() {
+              for (std::size_t i = 0 ; i < count ; ++i) {
+                std::size_t n = (i * steps[t]) % count;
+                ids[t][n] = symbols.intern("s" + std::to_string(n));
+              }
+            }));
+      }
+      std::thread reader([&]() {
+          while (!done) {
+            std::size_t size = symbols.size();
+            for (std::size_t i = 0 ; i < size ; i += 97) {
+              uint32_t id = static_cast<uint32_t>(i);
+              if (symbols.find(symbols.str(id)) != id) {
+                ++errors;
+              }
+            }
+          }
+        });
+
+      for (std::size_t t = 0 ; t < writers ; ++t) {
+        threads[t].join();
+      }
+      done = true;
+      reader.join();
+
+      CPPUNIT_ASSERT_EQUAL(std::size_t(0), errors.load());
+      CPPUNIT_ASSERT_EQUAL(count, symbols.size());
+      for (std::size_t n = 0 ; n < count ; ++n) {
+        for (std::size_t t = 1 ; t < writers ; ++t) {
+          CPPUNIT_ASSERT_EQUAL(ids[0][n], ids[t][n]);
+        }
+        CPPUNIT_ASSERT_EQUAL("s" + std::to_string(n), symbols.str(ids[0][n]));
+      }
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InternerTest);
@@ -0,0 +1,203 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <meta/mapped_file.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+
+namespace {
+
+namespace b = meta::byte_order;
+
+struct snapshot_header
+{
+  char                    magic[4];
+  b::big_endian<uint32_t> count;
+  b::big_endian<uint16_t> version;
+};
+
+
+/**
+ * Writes a snapshot file with a header, followed by count big endian 64 bit
+ * integers 0..count-1, and removes it again on destruction.
+ **/
+struct temp_snapshot
+{
+  std::string path;
+
+  temp_snapshot(uint32_t count)
+  {
+    char name[] = "/tmp/meta-test-XXXXXX";
+    int fd = mkstemp(name);
+    path = name;
+
+    std::vector<char> content(sizeof(snapshot_header) + count * 8);
+    snapshot_header * hdr = reinterpret_cast<snapshot_header *>(&content[0]);
+    std::copy(&"SNAP"[0], &"SNAP"[4], hdr->magic);
+    hdr->count = count;
+    hdr->version = 3;
+    for (uint32_t i = 0 ; i < count ; ++i) {
+      b::store_be(&content[sizeof(snapshot_header) + i * 8], uint64_t(i));
+    }
+
+    ssize_t written = ::write(fd, &content[0], content.size());
+    (void) written;
+    ::close(fd);
+  }
+
+  ~temp_snapshot()
+  {
+    ::unlink(path.c_str());
+  }
+};
+
+} // anonymous namespace
+
+
+class MappedFileTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(MappedFileTest);
+
+        CPPUNIT_TEST(testEndianArray);
+        CPPUNIT_TEST(testMapping);
+        CPPUNIT_TEST(testBounds);
+        CPPUNIT_TEST(testErrors);
+
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+    void testEndianArray()
+    {
+        unsigned char buffer[] = {
+            0xff,
+            0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x01, 0x00,
+        };
+
+        // Deliberately misaligned
+        b::endian_array<uint16_t, b::META_BIG_ENDIAN> be(buffer + 1, 4);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(4), be.size());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(1), be[0]);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0x100), be.at(3));
+        CPPUNIT_ASSERT_THROW(be.at(4), std::out_of_range);
+
+        b::endian_array<uint16_t, b::META_LITTLE_ENDIAN> le(buffer + 1, 4);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0x100), le[0]);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(1), le[3]);
+
+        std::vector<uint16_t> values(be.begin(), be.end());
+        CPPUNIT_ASSERT_EQUAL(std::size_t(4), values.size());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(3), values[2]);
+        CPPUNIT_ASSERT_EQUAL(std::ptrdiff_t(4), be.end() - be.begin());
+        CPPUNIT_ASSERT_EQUAL(uint16_t(2), be.begin()[1]);
+
+        uint16_t copied[2] = { 0 };
+        be.copy(copied, 1, 2);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(2), copied[0]);
+        CPPUNIT_ASSERT_EQUAL(uint16_t(3), copied[1]);
+        CPPUNIT_ASSERT_THROW(be.copy(copied, 3, 2), std::out_of_range);
+
+        CPPUNIT_ASSERT_EQUAL(uint16_t(3), be.subarray(2, 2)[0]);
+    }
+
+
+
+    void testMapping()
+    {
+        temp_snapshot file(10000);
+
+        meta::mapped_file mapped(file.path, meta::mapped_file::ACCESS_SEQUENTIAL);
+        CPPUNIT_ASSERT_EQUAL(sizeof(snapshot_header) + 80000, mapped.size());
+
+        snapshot_header const * hdr = mapped.overlay<snapshot_header>(0);
+        CPPUNIT_ASSERT(std::equal(&"SNAP"[0], &"SNAP"[4], hdr->magic));
+        CPPUNIT_ASSERT_EQUAL(uint32_t(10000), uint32_t(hdr->count));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(3), uint16_t(hdr->version));
+
+        b::endian_array<uint64_t, b::META_BIG_ENDIAN> values
+            = mapped.array<uint64_t, b::META_BIG_ENDIAN>(sizeof(snapshot_header),
+                hdr->count);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(10000), values.size());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1234), values[1234]);
+
+        mapped.prefetch(sizeof(snapshot_header) + 8000, 8000);
+        std::vector<uint64_t> chunk(1000);
+        values.copy(&chunk[0], 1000, chunk.size());
+        for (std::size_t i = 0 ; i < chunk.size() ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(uint64_t(1000 + i), chunk[i]);
+        }
+
+        CPPUNIT_ASSERT_EQUAL(uint64_t(9999) * 10000 / 2,
+            std::accumulate(values.begin(), values.end(), uint64_t(0)));
+
+        // Moving transfers the mapping
+        meta::mapped_file moved(std::move(mapped));
+        CPPUNIT_ASSERT(mapped.data() == nullptr);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(42), values[42]);
+    }
+
+
+
+    void testBounds()
+    {
+        temp_snapshot file(10);
+        meta::mapped_file mapped(file.path);
+
+        typedef b::endian_array<uint64_t, b::META_BIG_ENDIAN> array_t;
+        array_t all = mapped.array<uint64_t, b::META_BIG_ENDIAN>(
+            sizeof(snapshot_header), 10);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(9), all[9]);
+
+        CPPUNIT_ASSERT_THROW((mapped.array<uint64_t, b::META_BIG_ENDIAN>(
+            sizeof(snapshot_header), 11)), std::out_of_range);
+        CPPUNIT_ASSERT_THROW((mapped.array<uint64_t, b::META_BIG_ENDIAN>(
+            mapped.size() + 1, 0)), std::out_of_range);
+        CPPUNIT_ASSERT_THROW(mapped.overlay<snapshot_header>(mapped.size() - 4),
+            std::out_of_range);
+    }
+
+
+
+    void testErrors()
+    {
+        CPPUNIT_ASSERT_THROW(meta::mapped_file("/nonexistent/meta-test"),
+            std::system_error);
+
+        // Empty files can be mapped, but contain nothing.
+        temp_snapshot file(0);
+        ::truncate(file.path.c_str(), 0);
+        meta::mapped_file mapped(file.path);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), mapped.size());
+        CPPUNIT_ASSERT_THROW(mapped.overlay<snapshot_header>(0), std::out_of_range);
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MappedFileTest);
@@ -21,6 +21,10 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
 #include <meta/math.h>
 
 
@@ -34,6 +38,12 @@ public:
       CPPUNIT_TEST(testRatio);
       CPPUNIT_TEST(testMultiplyRatio);
       CPPUNIT_TEST(testDivideRatio);
+      CPPUNIT_TEST(testConvert);
+      CPPUNIT_TEST(testConvertSigned);
+      CPPUNIT_TEST(testConvertWide);
+      CPPUNIT_TEST(testFastDivider);
+      CPPUNIT_TEST(testFastDividerSigned);
+      CPPUNIT_TEST(testFastDividerBulk);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -186,6 +196,274 @@ private:
       testDivideRatioImpl<int64_t, int8_t>();
       testDivideRatioImpl<uint8_t, uint64_t>();
     }
+
+
+
+    void testConvert()
+    {
+      namespace m = meta::math;
+      namespace d = meta::math::detail;
+
+      typedef m::ratio<uint64_t, 1> seconds;
+      typedef m::ratio<uint64_t, 1, 1000> milliseconds;
+      typedef m::ratio<uint64_t, 1, 1000000000> nanoseconds;
+      typedef m::ratio<uint64_t, 1, 24000000> ticks;
+      typedef m::ratio<uint64_t, 1, 1024> kibi;
+      typedef m::ratio<uint64_t, 8> bytes;
+
+      // The factor is cancelled down, and determines the arithmetic.
+      typedef d::conversion_factor<ticks, nanoseconds> tick_factor;
+      CPPUNIT_ASSERT_EQUAL(uint64_t(125), uint64_t(tick_factor::DIVIDEND));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(3), uint64_t(tick_factor::DIVISOR));
+      CPPUNIT_ASSERT(d::CONVERT_FRACTION == (d::select_conversion<125, 3>::KIND));
+      CPPUNIT_ASSERT(d::CONVERT_MULTIPLY == (d::select_conversion<1000, 1>::KIND));
+      CPPUNIT_ASSERT(d::CONVERT_SHIFT_LEFT == (d::select_conversion<8, 1>::KIND));
+      CPPUNIT_ASSERT(d::CONVERT_SHIFT_LEFT == (d::select_conversion<1, 1>::KIND));
+      CPPUNIT_ASSERT(d::CONVERT_SHIFT_RIGHT == (d::select_conversion<1, 1024>::KIND));
+      CPPUNIT_ASSERT(d::CONVERT_FRACTION == (d::select_conversion<3, 1024>::KIND));
+
+      CPPUNIT_ASSERT_EQUAL(uint64_t(1000000000), (m::convert<ticks, nanoseconds>(uint64_t(24000000))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(41), (m::convert<ticks, nanoseconds>(uint64_t(1))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(5000), (m::convert<seconds, milliseconds>(uint64_t(5))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(5), (m::convert<milliseconds, seconds>(uint64_t(5999))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(3), (m::convert<kibi, seconds>(uint64_t(4000))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(24), (m::convert<bytes, seconds>(uint64_t(3))));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(7), (m::convert<seconds, seconds>(uint64_t(7))));
+
+      // No overflow in intermediate results: the result fits, but the value
+      // times the dividend does not.
+      uint64_t large = (uint64_t(1) << 62) / 125 * 3 + 2;
+      CPPUNIT_ASSERT_EQUAL((large / 3) * 125 + (large % 3) * 125 / 3,
+          (m::convert<ticks, nanoseconds>(large)));
+
+      // 32 bit values, and bulk conversion in place
+      uint32_t values[5] = { 0, 1, 999, 1000, 123456 };
+      m::convert<milliseconds, seconds>(values, values, 5);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), values[0]);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), values[1]);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), values[2]);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(1), values[3]);
+      CPPUNIT_ASSERT_EQUAL(uint32_t(123), values[4]);
+    }
+
+
+
+    void testConvertSigned()
+    {
+      namespace m = meta::math;
+
+      typedef m::ratio<int64_t, 1> seconds;
+      typedef m::ratio<int64_t, 1, 1000> milliseconds;
+      typedef m::ratio<int64_t, 1, 4> quarters;
+      typedef m::ratio<int8_t, 1, 2> halves;
+
+      // Truncation towards zero, as with integer division
+      CPPUNIT_ASSERT_EQUAL(int64_t(-1), (m::convert<milliseconds, seconds>(int64_t(-1999))));
+      CPPUNIT_ASSERT_EQUAL(int64_t(1), (m::convert<milliseconds, seconds>(int64_t(1999))));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-1), (m::convert<quarters, seconds>(int64_t(-7))));
+      CPPUNIT_ASSERT_EQUAL(int64_t(-7000), (m::convert<seconds, milliseconds>(int64_t(-7))));
+
+      CPPUNIT_ASSERT_EQUAL(int8_t(-10), (m::convert<m::ratio<int8_t, 1>, halves>(int8_t(-5))));
+      CPPUNIT_ASSERT_EQUAL(int8_t(-64), (m::convert<halves, m::ratio<int8_t, 1> >(int8_t(-128))));
+    }
+
+
+
+    void testConvertWide()
+    {
+      namespace m = meta::math;
+      namespace d = meta::math::detail;
+
+      // The remainder times the dividend exceeds 64 bits.
+      uint64_t const big = (uint64_t(1) << 40) + 1;
+      CPPUNIT_ASSERT_EQUAL(big - 1, d::wide_mul_div(big - 1, big + 1, big));
+      uint64_t const top = uint64_t(1) << 63;
+      CPPUNIT_ASSERT_EQUAL(top, d::wide_mul_div(top, top + 2, top + 1));
+
+      typedef m::ratio<uint64_t, (uint64_t(1) << 40) + 1, (uint64_t(1) << 30) + 3> from;
+      typedef m::ratio<uint64_t, 1> to;
+      typedef d::conversion_factor<from, to> factor;
+      CPPUNIT_ASSERT(d::CONVERT_WIDE_FRACTION
+          == (d::select_conversion<factor::DIVIDEND, factor::DIVISOR>::KIND));
+
+      // Whole multiples of the divisor convert exactly.
+      uint64_t const divisor = (uint64_t(1) << 30) + 3;
+      CPPUNIT_ASSERT_EQUAL(uint64_t(5) * big, (m::convert<from, to>(5 * divisor)));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(5) * big + big / divisor * (divisor - 1)
+          + big % divisor * (divisor - 1) / divisor,
+          (m::convert<from, to>(5 * divisor + divisor - 1)));
+    }
+
+
+
+    // Divisors and values around powers of two, the extremes, and a few
+    // pseudo-random ones.
+    template <typename intT>
+    std::vector<intT> interestingValues()
+    {
+      typedef std::numeric_limits<intT> limits;
+
+      std::vector<intT> values;
+      for (int bit = 0 ; bit < limits::digits ; ++bit) {
+        intT power = intT(intT(1) << bit);
+        values.push_back(power);
+        values.push_back(intT(power - 1));
+        values.push_back(intT(power + 1));
+      }
+      values.push_back(limits::max());
+      values.push_back(intT(limits::max() - 1));
+      values.push_back(intT(limits::max() / 3));
+      values.push_back(7);
+      values.push_back(10);
+      values.push_back(1000);
+
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (int i = 0 ; i < 64 ; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        values.push_back(intT(state >> (i % 64)));
+      }
+
+      if (limits::is_signed) {
+        std::size_t size = values.size();
+        for (std::size_t i = 0 ; i < size ; ++i) {
+          values.push_back(intT(-values[i]));
+        }
+        values.push_back(limits::min());
+        values.push_back(intT(limits::min() + 1));
+      }
+      return values;
+    }
+
+    template <typename intT, bool BRANCH_FREE>
+    void testFastDividerImpl()
+    {
+      namespace m = meta::math;
+
+      std::vector<intT> values = interestingValues<intT>();
+      values.push_back(0);
+      for (std::size_t i = 0 ; i < values.size() ; ++i) {
+        intT divisor = values[i];
+        if (!divisor) {
+          continue;
+        }
+        m::fast_divider<intT, BRANCH_FREE> divider(divisor);
+        CPPUNIT_ASSERT_EQUAL(divisor, divider.divisor());
+
+        for (std::size_t j = 0 ; j < values.size() ; ++j) {
+          intT value = values[j];
+          if (std::numeric_limits<intT>::is_signed && divisor == intT(-1)
+              && value == std::numeric_limits<intT>::min())
+          {
+            continue;
+          }
+          CPPUNIT_ASSERT_EQUAL(intT(value / divisor), value / divider);
+          CPPUNIT_ASSERT_EQUAL(intT(value % divisor), value % divider);
+        }
+      }
+    }
+
+    void testFastDivider()
+    {
+      namespace m = meta::math;
+
+      testFastDividerImpl<uint32_t, false>();
+      testFastDividerImpl<uint32_t, true>();
+      testFastDividerImpl<uint64_t, false>();
+      testFastDividerImpl<uint64_t, true>();
+
+      // Powers of two are shifts, unless the divider is branch free.
+      CPPUNIT_ASSERT(m::detail::DIVIDE_SHIFT
+          == m::detail::make_divider_params(uint32_t(64), false).algorithm);
+      CPPUNIT_ASSERT(m::detail::DIVIDE_MULTIPLY_ADD
+          == m::detail::make_divider_params(uint32_t(64), true).algorithm);
+      CPPUNIT_ASSERT(m::detail::DIVIDE_MULTIPLY
+          == m::detail::make_divider_params(uint32_t(3), false).algorithm);
+      CPPUNIT_ASSERT(m::detail::DIVIDE_MULTIPLY_ADD
+          == m::detail::make_divider_params(uint32_t(7), false).algorithm);
+
+      CPPUNIT_ASSERT_THROW(m::fast_divider<uint32_t>(0), std::invalid_argument);
+    }
+
+
+
+    void testFastDividerSigned()
+    {
+      namespace m = meta::math;
+
+      testFastDividerImpl<int32_t, false>();
+      testFastDividerImpl<int32_t, true>();
+      testFastDividerImpl<int64_t, false>();
+      testFastDividerImpl<int64_t, true>();
+
+      // Truncation towards zero; the remainder has the sign of the value.
+      m::fast_divider<int32_t> divider(-3);
+      CPPUNIT_ASSERT_EQUAL(int32_t(-2), int32_t(7) / divider);
+      CPPUNIT_ASSERT_EQUAL(int32_t(1), int32_t(7) % divider);
+      CPPUNIT_ASSERT_EQUAL(int32_t(2), int32_t(-7) / divider);
+      CPPUNIT_ASSERT_EQUAL(int32_t(-1), int32_t(-7) % divider);
+
+      CPPUNIT_ASSERT_THROW(m::fast_divider<int64_t>(0), std::invalid_argument);
+    }
+
+
+
+    template <typename intT, bool BRANCH_FREE>
+    void testFastDividerBulkImpl()
+    {
+      namespace m = meta::math;
+
+      // Not a multiple of the vector width.
+      std::vector<intT> values = interestingValues<intT>();
+      values.resize(values.size() - values.size() % 8 + 5);
+      std::vector<intT> divisors = interestingValues<intT>();
+      std::vector<intT> out(values.size());
+      std::vector<intT> scalar(values.size());
+
+      for (std::size_t i = 0 ; i < divisors.size() ; ++i) {
+        if (!divisors[i]
+            || (std::numeric_limits<intT>::is_signed && divisors[i] == intT(-1)))
+        {
+          continue;
+        }
+        m::fast_divider<intT, BRANCH_FREE> divider(divisors[i]);
+
+        divider.divide(&values[0], &out[0], values.size());
+        for (std::size_t j = 0 ; j < values.size() ; ++j) {
+          CPPUNIT_ASSERT_EQUAL(intT(values[j] / divisors[i]), out[j]);
+        }
+        divider.modulo(&values[0], &out[0], values.size());
+        for (std::size_t j = 0 ; j < values.size() ; ++j) {
+          CPPUNIT_ASSERT_EQUAL(intT(values[j] % divisors[i]), out[j]);
+        }
+
+        // The scalar kernel, in place.
+        typedef typename m::detail::unsigned_type<intT>::type unsigned_t;
+        unsigned_t magnitude = unsigned_t(divisors[i]);
+        if (divisors[i] < 0) {
+          magnitude = unsigned_t(0) - magnitude;
+        }
+        scalar = values;
+        m::detail::scalar_divide(m::detail::make_divider_params(magnitude,
+              BRANCH_FREE), divisors[i], &scalar[0], &scalar[0], scalar.size(),
+            false);
+        divider.divide(&values[0], &out[0], values.size());
+        for (std::size_t j = 0 ; j < values.size() ; ++j) {
+          CPPUNIT_ASSERT_EQUAL(out[j], scalar[j]);
+        }
+      }
+    }
+
+    void testFastDividerBulk()
+    {
+      testFastDividerBulkImpl<uint32_t, false>();
+      testFastDividerBulkImpl<uint32_t, true>();
+      testFastDividerBulkImpl<int32_t, false>();
+      testFastDividerBulkImpl<int32_t, true>();
+      testFastDividerBulkImpl<uint64_t, false>();
+      testFastDividerBulkImpl<int64_t, true>();
+    }
 };
 
 
@@ -0,0 +1,98 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstring>
+#include <string>
+
+#include <meta/perfect_hash.h>
+
+namespace {
+
+namespace h = meta::hash;
+
+constexpr h::perfect_entry<int> opcode_entries[] = {
+  { "ADD", 1 }, { "SUB", 2 }, { "MUL", 3 }, { "DIV", 4 }, { "MOD", 5 },
+  { "AND", 6 }, { "OR", 7 }, { "XOR", 8 }, { "NOT", 9 }, { "SHL", 10 },
+  { "SHR", 11 }, { "JMP", 12 }, { "JZ", 13 }, { "JNZ", 14 }, { "CALL", 15 },
+  { "RET", 16 }, { "PUSH", 17 }, { "POP", 18 }, { "LOAD", 19 },
+  { "STORE", 20 }, { "NOP", 21 }, { "HALT", 22 }, { "", 23 },
+};
+
+constexpr auto opcodes = h::make_perfect_map(opcode_entries);
+
+static_assert(*opcodes.find("JMP", 3) == 12, "perfect_map lookups are constexpr");
+static_assert(!opcodes.contains("JMPX", 4), "perfect_map lookups are constexpr");
+
+constexpr h::perfect_entry<char> single_entry[] = { { "single", 'x' } };
+
+constexpr auto single = h::make_perfect_map(single_entry);
+
+} // anonymous namespace
+
+
+class PerfectHashTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(PerfectHashTest);
+
+      CPPUNIT_TEST(testFind);
+      CPPUNIT_TEST(testMissing);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testFind()
+    {
+      CPPUNIT_ASSERT_EQUAL(std::size_t(23), opcodes.size());
+      CPPUNIT_ASSERT(opcodes.SLOTS >= opcodes.size());
+
+      for (auto const & entry : opcode_entries) {
+        std::string key(entry.key, entry.size);
+        CPPUNIT_ASSERT(opcodes.contains(key));
+        CPPUNIT_ASSERT_EQUAL(entry.value, *opcodes.find(key));
+        CPPUNIT_ASSERT_EQUAL(entry.value, *opcodes.find(entry.key, entry.size));
+      }
+
+      CPPUNIT_ASSERT_EQUAL('x', *single.find(std::string("single")));
+    }
+
+
+
+    void testMissing()
+    {
+      char const * missing[] = { "add", "ADDX", "AD", "JM", "JMPS", "HALT ",
+        " ", "single" };
+      for (char const * key : missing) {
+        CPPUNIT_ASSERT(!opcodes.contains(std::string(key)));
+        CPPUNIT_ASSERT(opcodes.find(key, std::strlen(key)) == nullptr);
+      }
+
+      CPPUNIT_ASSERT(!single.contains(std::string("")));
+      CPPUNIT_ASSERT(!single.contains(std::string("singles")));
+      CPPUNIT_ASSERT(!single.contains(std::string("singlE")));
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PerfectHashTest);
@@ -0,0 +1,244 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2009-2012 Jens Finkhaeuser.
+ * Copyright (c) 2013-2015 Unwesen Ltd.
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <meta/record_swap.h>
+
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+
+namespace {
+
+struct record
+{
+  uint32_t  id;
+  char      name[6];
+  uint16_t  flags;
+  double    value;
+  uint8_t   tag;
+  int64_t   stamp;
+};
+
+typedef meta::types::typelist<
+  META_RECORD_FIELD(record, id),
+  META_RECORD_FIELD(record, flags),
+  META_RECORD_FIELD(record, value),
+  META_RECORD_FIELD(record, tag),
+  META_RECORD_FIELD(record, stamp)
+> record_layout;
+
+
+// Small records that pack evenly into vectors.
+struct pair
+{
+  uint16_t  a;
+  uint16_t  b;
+  uint32_t  c;
+};
+
+typedef meta::types::typelist<
+  META_RECORD_FIELD(pair, a),
+  META_RECORD_FIELD(pair, c)
+> pair_layout;
+
+} // anonymous namespace
+
+
+class RecordSwapTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(RecordSwapTest);
+
+        CPPUNIT_TEST(testRecords);
+        CPPUNIT_TEST(testPackedRecords);
+        CPPUNIT_TEST(testRuntimeStride);
+        CPPUNIT_TEST(testToHost);
+
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+    record make_record(std::size_t i)
+    {
+        record r;
+        std::memset(&r, 0xaa, sizeof(r));
+        r.id = static_cast<uint32_t>(i * 0x01020304);
+        std::memcpy(r.name, "hello", 6);
+        r.flags = static_cast<uint16_t>(i * 3 + 1);
+        r.value = i * 0.5;
+        r.tag = static_cast<uint8_t>(i);
+        r.stamp = static_cast<int64_t>(i) * -1000000007LL;
+        return r;
+    }
+
+    void testRecords()
+    {
+        namespace b = meta::byte_order;
+
+        std::vector<record> records;
+        for (std::size_t i = 0 ; i < 100 ; ++i) {
+            records.push_back(make_record(i));
+        }
+
+        b::swap_records<record_layout>(&records[0], records.size());
+
+        for (std::size_t i = 0 ; i < records.size() ; ++i) {
+            record expected = make_record(i);
+            CPPUNIT_ASSERT_EQUAL(b::swap(expected.id), records[i].id);
+            CPPUNIT_ASSERT_EQUAL(b::swap(expected.flags), records[i].flags);
+            CPPUNIT_ASSERT_EQUAL(b::swap(expected.stamp), records[i].stamp);
+            CPPUNIT_ASSERT_EQUAL(expected.tag, records[i].tag);
+            CPPUNIT_ASSERT_EQUAL(std::string("hello"), std::string(records[i].name));
+
+            double value = b::swap(records[i].value);
+            CPPUNIT_ASSERT_EQUAL(expected.value, value);
+        }
+
+        // Swapping twice restores the original.
+        b::swap_records<record_layout>(&records[0], records.size());
+        for (std::size_t i = 0 ; i < records.size() ; ++i) {
+            record expected = make_record(i);
+            CPPUNIT_ASSERT(0 == std::memcmp(&expected, &records[i], sizeof(record)));
+        }
+    }
+
+
+
+    void testPackedRecords()
+    {
+        namespace b = meta::byte_order;
+
+        // Exercises the vector kernels, including the scalar remainder, for a
+        // range of record counts.
+        for (std::size_t count = 0 ; count < 70 ; ++count) {
+            std::vector<pair> pairs(count);
+            for (std::size_t i = 0 ; i < count ; ++i) {
+                pairs[i].a = static_cast<uint16_t>(i * 0x0101 + 1);
+                pairs[i].b = static_cast<uint16_t>(i * 0x0102 + 2);
+                pairs[i].c = static_cast<uint32_t>(i * 0x01020304 + 3);
+            }
+            std::vector<pair> swapped(pairs);
+            if (count) {
+                b::swap_records<pair_layout>(&swapped[0], count);
+            }
+
+            for (std::size_t i = 0 ; i < count ; ++i) {
+                CPPUNIT_ASSERT_EQUAL(b::swap(pairs[i].a), swapped[i].a);
+                CPPUNIT_ASSERT_EQUAL(pairs[i].b, swapped[i].b);
+                CPPUNIT_ASSERT_EQUAL(b::swap(pairs[i].c), swapped[i].c);
+            }
+        }
+    }
+
+
+
+    void testRuntimeStride()
+    {
+        namespace b = meta::byte_order;
+
+        // Records of 12 bytes with fields straddling 16 byte boundaries, and
+        // records of 6 bytes, laid out in raw buffers.
+        typedef meta::types::typelist<
+          b::field<uint32_t, 0>,
+          b::field<uint64_t, 4>
+        > layout12;
+        typedef meta::types::typelist<
+          b::field<uint16_t, 4>
+        > layout6;
+
+        std::vector<unsigned char> orig(12 * 50);
+        for (std::size_t i = 0 ; i < orig.size() ; ++i) {
+            orig[i] = static_cast<unsigned char>(i * 13);
+        }
+
+        std::vector<unsigned char> buf(orig);
+        b::swap_records<layout12>(&buf[0], 50, 12);
+        for (std::size_t r = 0 ; r < 50 ; ++r) {
+            unsigned char const * o = &orig[r * 12];
+            unsigned char const * s = &buf[r * 12];
+            for (std::size_t i = 0 ; i < 4 ; ++i) {
+                CPPUNIT_ASSERT_EQUAL(int(o[3 - i]), int(s[i]));
+            }
+            for (std::size_t i = 0 ; i < 8 ; ++i) {
+                CPPUNIT_ASSERT_EQUAL(int(o[11 - i]), int(s[4 + i]));
+            }
+        }
+
+        buf = orig;
+        b::swap_records<layout6>(&buf[0], 100, 6);
+        for (std::size_t r = 0 ; r < 100 ; ++r) {
+            unsigned char const * o = &orig[r * 6];
+            unsigned char const * s = &buf[r * 6];
+            CPPUNIT_ASSERT_EQUAL(int(o[0]), int(s[0]));
+            CPPUNIT_ASSERT_EQUAL(int(o[3]), int(s[3]));
+            CPPUNIT_ASSERT_EQUAL(int(o[5]), int(s[4]));
+            CPPUNIT_ASSERT_EQUAL(int(o[4]), int(s[5]));
+        }
+
+        // Strides that are zero or too small for the layout are rejected
+        // before anything is swapped.
+        static_assert(b::detail::layout_helper<layout12>::extent == 12,
+            "layout extent");
+        static_assert(b::detail::layout_helper<layout6>::extent == 6,
+            "layout extent");
+        buf = orig;
+        CPPUNIT_ASSERT_THROW(b::swap_records<layout12>(&buf[0], 50, 0),
+            std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(b::swap_records<layout12>(&buf[0], 50, 11),
+            std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(b::swap_records<meta::types::typelist<>>(
+              &buf[0], 50, 0), std::invalid_argument);
+        CPPUNIT_ASSERT(buf == orig);
+        b::swap_records<layout6>(&buf[0], 1, 6);
+        CPPUNIT_ASSERT(buf != orig);
+    }
+
+
+
+    void testToHost()
+    {
+        namespace b = meta::byte_order;
+
+        std::vector<pair> pairs(40);
+        for (std::size_t i = 0 ; i < pairs.size() ; ++i) {
+            pairs[i].a = static_cast<uint16_t>(i);
+            pairs[i].b = static_cast<uint16_t>(i);
+            pairs[i].c = static_cast<uint32_t>(i);
+        }
+
+        std::vector<pair> converted(pairs);
+        b::from_host_records<pair_layout>(&converted[0], converted.size(), b::META_BIG_ENDIAN);
+        for (std::size_t i = 0 ; i < pairs.size() ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(b::from_host(pairs[i].a, b::META_BIG_ENDIAN), converted[i].a);
+            CPPUNIT_ASSERT_EQUAL(b::from_host(pairs[i].c, b::META_BIG_ENDIAN), converted[i].c);
+        }
+
+        b::to_host_records<pair_layout>(&converted[0], converted.size(), b::META_BIG_ENDIAN);
+        CPPUNIT_ASSERT(0 == std::memcmp(&pairs[0], &converted[0], sizeof(pair) * pairs.size()));
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RecordSwapTest);
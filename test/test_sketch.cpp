@@ -0,0 +1,172 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <meta/sketch.h>
+
+
+class SketchTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(SketchTest);
+
+      CPPUNIT_TEST(testBloomFilter);
+      CPPUNIT_TEST(testBloomKernels);
+      CPPUNIT_TEST(testCountMinSketch);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testBloomFilter()
+    {
+      namespace h = meta::hash;
+
+      h::bloom_filter filter(10000);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(7), filter.probes());
+      CPPUNIT_ASSERT(!filter.contains(std::string("foo")));
+
+      for (uint64_t i = 0 ; i < 10000 ; ++i) {
+        filter.insert(i * 2);
+      }
+      filter.insert(std::string("foo"));
+
+      // No false negatives
+      for (uint64_t i = 0 ; i < 10000 ; ++i) {
+        CPPUNIT_ASSERT(filter.contains(i * 2));
+      }
+      CPPUNIT_ASSERT(filter.contains(std::string("foo")));
+
+      // About 1% false positives
+      std::size_t false_positives = 0;
+      for (uint64_t i = 0 ; i < 10000 ; ++i) {
+        false_positives += filter.contains(i * 2 + 1);
+      }
+      CPPUNIT_ASSERT(false_positives < 200);
+
+      // Copies may place their blocks at another offset into their storage;
+      // allocating in between varies that.
+      std::vector<h::bloom_filter> copies;
+      std::vector<std::vector<char> > padding;
+      for (std::size_t i = 0 ; i < 16 ; ++i) {
+        padding.push_back(std::vector<char>(i * 4 + 1));
+        copies.push_back(filter);
+      }
+      h::bloom_filter assigned(1);
+      assigned = copies.back();
+      copies.push_back(assigned);
+      copies.push_back(std::move(assigned));
+      for (h::bloom_filter const & copy : copies) {
+        CPPUNIT_ASSERT_EQUAL(filter.probes(), copy.probes());
+        CPPUNIT_ASSERT_EQUAL(filter.size_in_bytes(), copy.size_in_bytes());
+        for (uint64_t i = 0 ; i < 10000 ; ++i) {
+          CPPUNIT_ASSERT(copy.contains(i * 2));
+        }
+        CPPUNIT_ASSERT(copy.contains(std::string("foo")));
+      }
+
+      filter.clear();
+      CPPUNIT_ASSERT(!filter.contains(uint64_t(0)));
+    }
+
+
+
+    void testBloomKernels()
+    {
+      namespace h = meta::hash;
+      namespace d = meta::hash::detail;
+
+      // The kernels agree on half full blocks, for any number of probes.
+      uint32_t block[d::BLOOM_BLOCK_WORDS];
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (std::size_t i = 0 ; i < d::BLOOM_BLOCK_WORDS ; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        block[i] = static_cast<uint32_t>(state >> 32);
+      }
+
+      std::size_t hits = 0;
+      for (std::size_t i = 0 ; i < 10000 ; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        std::size_t probes = 1 + i % d::BLOOM_MAX_PROBES;
+        bool expected = d::scalar_bloom_test(block, state, probes);
+        hits += expected;
+        CPPUNIT_ASSERT_EQUAL(expected, d::bloom_test(block, state, probes));
+#if defined(META_X86_SIMD)
+        if (__builtin_cpu_supports("avx2")) {
+          CPPUNIT_ASSERT_EQUAL(expected,
+              d::avx2_bloom_test(block, state, probes));
+        }
+#endif
+      }
+      CPPUNIT_ASSERT(hits > 0);
+    }
+
+
+
+    void testCountMinSketch()
+    {
+      namespace h = meta::hash;
+
+      h::count_min_sketch<> sketch(1000, 4);
+      CPPUNIT_ASSERT_EQUAL(std::size_t(1024), sketch.width());
+      CPPUNIT_ASSERT_EQUAL(std::size_t(4), sketch.depth());
+
+      // A few heavy hitters in many rare values.
+      std::unordered_map<uint64_t, uint32_t> counts;
+      uint64_t state = 0x2545f4914f6cdd1dULL;
+      for (std::size_t i = 0 ; i < 100000 ; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t value = (i % 10 == 0) ? i % 50 : (state >> 20) % 100000;
+        ++counts[value];
+        uint32_t estimate = sketch.add(value);
+        CPPUNIT_ASSERT(estimate >= counts[value]);
+      }
+      CPPUNIT_ASSERT_EQUAL(uint64_t(100000), sketch.total());
+
+      // Estimates are never too low, and rarely much too high.
+      std::size_t bad = 0;
+      for (auto const & entry : counts) {
+        uint32_t estimate = sketch.estimate(entry.first);
+        CPPUNIT_ASSERT(estimate >= entry.second);
+        bad += (estimate - entry.second > 2 * 100000 / 1024);
+      }
+      CPPUNIT_ASSERT(bad < counts.size() / 16);
+
+      for (uint64_t i = 0 ; i < 50 ; i += 10) {
+        CPPUNIT_ASSERT(sketch.estimate(i) >= 2000);
+      }
+
+      // Counters saturate.
+      h::count_min_sketch<uint8_t> small(16, 2);
+      small.add(std::string("foo"), 200);
+      CPPUNIT_ASSERT_EQUAL(uint8_t(255), small.add(std::string("foo"), 100));
+      CPPUNIT_ASSERT_THROW(h::count_min_sketch<>(16, 0), std::invalid_argument);
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SketchTest);
@@ -0,0 +1,351 @@
+/**
+ * This file is part of meta.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2016-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <meta/varint.h>
+
+#include <algorithm>
+#include <vector>
+
+
+namespace {
+
+// Values with encodings of every length from 1 to 10 bytes, mixed with runs
+// of single byte values.
+template <typename intT>
+std::vector<intT> make_values(std::size_t count)
+{
+  std::vector<intT> values(count);
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (std::size_t i = 0 ; i < count ; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if ((i / 20) % 2) {
+      values[i] = static_cast<intT>(state % 100);
+    } else {
+      values[i] = static_cast<intT>(state >> (state % 64));
+    }
+  }
+  return values;
+}
+
+} // anonymous namespace
+
+
+class VarintTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(VarintTest);
+
+        CPPUNIT_TEST(testZigzag);
+        CPPUNIT_TEST(testEncode);
+        CPPUNIT_TEST(testDecodeErrors);
+        CPPUNIT_TEST(testBulk);
+        CPPUNIT_TEST(testBulkSigned);
+        CPPUNIT_TEST(testBulkErrors);
+        CPPUNIT_TEST(testDecodeKernel);
+
+    CPPUNIT_TEST_SUITE_END();
+private:
+
+    void testZigzag()
+    {
+        namespace v = meta::varint;
+
+        static_assert(v::zigzag_encode(int32_t(0)) == 0, "zigzag");
+        static_assert(v::zigzag_encode(int32_t(-1)) == 1, "zigzag");
+        static_assert(v::zigzag_encode(int32_t(1)) == 2, "zigzag");
+        static_assert(v::zigzag_encode(int64_t(-2)) == 3, "zigzag");
+
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0xfffffffe),
+            v::zigzag_encode(std::numeric_limits<int32_t>::max()));
+        CPPUNIT_ASSERT_EQUAL(uint32_t(0xffffffff),
+            v::zigzag_encode(std::numeric_limits<int32_t>::min()));
+        CPPUNIT_ASSERT_EQUAL(std::numeric_limits<int64_t>::min(),
+            v::zigzag_decode(uint64_t(0xffffffffffffffffULL)));
+
+        for (int64_t i = -1000 ; i < 1000 ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(i, v::zigzag_decode(v::zigzag_encode(i)));
+        }
+
+        // Narrow types
+        static_assert(v::zigzag_encode(int8_t(-1)) == 1, "zigzag");
+        static_assert(v::zigzag_encode(int16_t(-2)) == 3, "zigzag");
+        CPPUNIT_ASSERT_EQUAL(uint8_t(0xff),
+            v::zigzag_encode(std::numeric_limits<int8_t>::min()));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0xfffe),
+            v::zigzag_encode(std::numeric_limits<int16_t>::max()));
+        for (int32_t i = std::numeric_limits<int16_t>::min() ;
+            i <= std::numeric_limits<int16_t>::max() ; ++i)
+        {
+            CPPUNIT_ASSERT_EQUAL(int16_t(i),
+                v::zigzag_decode(v::zigzag_encode(int16_t(i))));
+            CPPUNIT_ASSERT_EQUAL(int32_t(v::zigzag_encode(i)),
+                int32_t(v::zigzag_encode(int16_t(i))));
+        }
+        for (int32_t i = -128 ; i < 128 ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(int8_t(i),
+                v::zigzag_decode(v::zigzag_encode(int8_t(i))));
+        }
+    }
+
+
+
+    void testEncode()
+    {
+        namespace v = meta::varint;
+
+        unsigned char buf[v::max_size<uint64_t>::value];
+
+        CPPUNIT_ASSERT_EQUAL(std::size_t(1), v::encode(uint32_t(0), buf));
+        CPPUNIT_ASSERT_EQUAL(0x00, int(buf[0]));
+
+        CPPUNIT_ASSERT_EQUAL(std::size_t(2), v::encode(uint32_t(300), buf));
+        CPPUNIT_ASSERT_EQUAL(0xac, int(buf[0]));
+        CPPUNIT_ASSERT_EQUAL(0x02, int(buf[1]));
+
+        // Signed values are zigzag encoded.
+        CPPUNIT_ASSERT_EQUAL(std::size_t(1), v::encode(int32_t(-1), buf));
+        CPPUNIT_ASSERT_EQUAL(0x01, int(buf[0]));
+
+        CPPUNIT_ASSERT_EQUAL(std::size_t(10),
+            v::encode(std::numeric_limits<uint64_t>::max(), buf));
+        CPPUNIT_ASSERT_EQUAL(0x01, int(buf[9]));
+        CPPUNIT_ASSERT_EQUAL(std::size_t(10),
+            v::encoded_size(std::numeric_limits<uint64_t>::max()));
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5),
+            v::encoded_size(std::numeric_limits<int32_t>::min()));
+
+        uint64_t u = 0;
+        CPPUNIT_ASSERT_EQUAL(std::size_t(10), v::decode(buf, sizeof(buf), u));
+        CPPUNIT_ASSERT_EQUAL(std::numeric_limits<uint64_t>::max(), u);
+
+        int64_t s = 0;
+        std::size_t size = v::encode(int64_t(-123456789), buf);
+        CPPUNIT_ASSERT_EQUAL(size, v::decode(buf, size, s));
+        CPPUNIT_ASSERT_EQUAL(int64_t(-123456789), s);
+
+        // Narrow types
+        int16_t s16 = 0;
+        size = v::encode(std::numeric_limits<int16_t>::min(), buf);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(3), size);
+        CPPUNIT_ASSERT_EQUAL(size, v::decode(buf, size, s16));
+        CPPUNIT_ASSERT_EQUAL(std::numeric_limits<int16_t>::min(), s16);
+
+        uint16_t u16 = 0;
+        size = v::encode(uint16_t(300), buf);
+        CPPUNIT_ASSERT_EQUAL(size, v::decode(buf, size, u16));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(300), u16);
+
+        int8_t s8 = 0;
+        size = v::encode(int8_t(-100), buf);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(2), size);
+        CPPUNIT_ASSERT_EQUAL(size, v::decode(buf, size, s8));
+        CPPUNIT_ASSERT_EQUAL(int8_t(-100), s8);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(1), v::encoded_size(int8_t(-64)));
+
+        // 2^16 does not fit into 16 bits.
+        v::encode(uint32_t(65536), buf);
+        CPPUNIT_ASSERT_THROW(v::decode(buf, sizeof(buf), u16), v::decode_error);
+    }
+
+
+
+    void testDecodeErrors()
+    {
+        namespace v = meta::varint;
+
+        uint32_t value = 0;
+
+        unsigned char truncated[] = { 0x80, 0x80 };
+        CPPUNIT_ASSERT_THROW(v::decode(truncated, sizeof(truncated), value),
+            v::decode_error);
+
+        // 2^32 does not fit into 32 bits...
+        unsigned char too_large[] = { 0x80, 0x80, 0x80, 0x80, 0x10 };
+        CPPUNIT_ASSERT_THROW(v::decode(too_large, sizeof(too_large), value),
+            v::decode_error);
+
+        // ... but does into 64 bits.
+        uint64_t value64 = 0;
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5),
+            v::decode(too_large, sizeof(too_large), value64));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1) << 32, value64);
+
+        unsigned char too_long[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+        CPPUNIT_ASSERT_THROW(v::decode(too_long, sizeof(too_long), value),
+            v::decode_error);
+    }
+
+
+
+    void testBulk()
+    {
+        namespace v = meta::varint;
+
+        std::vector<uint64_t> values = make_values<uint64_t>(1000);
+        std::vector<unsigned char> buf(values.size() * v::max_size<uint64_t>::value);
+        std::size_t size = v::encode_n(&values[0], values.size(), &buf[0]);
+
+        std::vector<uint64_t> decoded(values.size());
+        CPPUNIT_ASSERT_EQUAL(size,
+            v::decode_n(&buf[0], size, &decoded[0], decoded.size()));
+        CPPUNIT_ASSERT(values == decoded);
+
+        std::vector<uint32_t> values32 = make_values<uint32_t>(1000);
+        size = v::encode_n(&values32[0], values32.size(), &buf[0]);
+
+        std::vector<uint32_t> decoded32(values32.size());
+        CPPUNIT_ASSERT_EQUAL(size,
+            v::decode_n(&buf[0], size, &decoded32[0], decoded32.size()));
+        CPPUNIT_ASSERT(values32 == decoded32);
+
+        // Decoding fewer values than the buffer holds stops at the right place.
+        CPPUNIT_ASSERT_EQUAL(v::encoded_size(values32[0]) + v::encoded_size(values32[1]),
+            v::decode_n(&buf[0], size, &decoded32[0], 2));
+    }
+
+
+
+    void testBulkSigned()
+    {
+        namespace v = meta::varint;
+
+        std::vector<int64_t> values = make_values<int64_t>(500);
+        for (std::size_t i = 0 ; i < values.size() ; i += 3) {
+            values[i] = -values[i];
+        }
+
+        std::vector<unsigned char> buf(values.size() * v::max_size<int64_t>::value);
+        std::size_t size = v::encode_n(&values[0], values.size(), &buf[0]);
+
+        std::vector<int64_t> decoded(values.size());
+        CPPUNIT_ASSERT_EQUAL(size,
+            v::decode_n(&buf[0], size, &decoded[0], decoded.size()));
+        CPPUNIT_ASSERT(values == decoded);
+
+        std::vector<int32_t> small(100);
+        for (std::size_t i = 0 ; i < small.size() ; ++i) {
+            small[i] = int32_t(i % 2 ? i : -i) / 4;
+        }
+        size = v::encode_n(&small[0], small.size(), &buf[0]);
+        CPPUNIT_ASSERT_EQUAL(small.size(), size);
+
+        std::vector<int32_t> decoded32(small.size());
+        v::decode_n(&buf[0], size, &decoded32[0], decoded32.size());
+        CPPUNIT_ASSERT(small == decoded32);
+    }
+
+
+
+    void testBulkErrors()
+    {
+        namespace v = meta::varint;
+
+        std::vector<uint32_t> values = make_values<uint32_t>(100);
+        std::vector<unsigned char> buf(values.size() * v::max_size<uint32_t>::value);
+        std::size_t size = v::encode_n(&values[0], values.size(), &buf[0]);
+
+        std::vector<uint32_t> decoded(values.size() + 1);
+        CPPUNIT_ASSERT_THROW(v::decode_n(&buf[0], size, &decoded[0], decoded.size()),
+            v::decode_error);
+
+        // A value too large for 32 bits in the middle of the buffer.
+        std::vector<uint64_t> large(100, 1);
+        large[50] = uint64_t(1) << 40;
+        size = v::encode_n(&large[0], large.size(), &buf[0]);
+        CPPUNIT_ASSERT_THROW(v::decode_n(&buf[0], size, &decoded[0], large.size()),
+            v::decode_error);
+
+        // A run of continuation bytes longer than any valid encoding.
+        std::vector<unsigned char> garbage(64, 0x80);
+        CPPUNIT_ASSERT_THROW(v::decode_n(&garbage[0], garbage.size(), &decoded[0], 1),
+            v::decode_error);
+    }
+
+
+
+    void testDecodeKernel()
+    {
+#if defined(META_X86_SIMD)
+        namespace v = meta::varint;
+
+        if (!__builtin_cpu_supports("sse4.1")) {
+            return;
+        }
+
+        std::vector<uint64_t> values = make_values<uint64_t>(333);
+        std::vector<unsigned char> buf(values.size() * v::max_size<uint64_t>::value);
+        std::size_t size = v::encode_n(&values[0], values.size(), &buf[0]);
+
+        // The kernel must leave a tail for the scalar decoder, and agree with
+        // it on everything it does decode.
+        std::vector<uint64_t> decoded(values.size());
+        std::size_t count = 0;
+        std::size_t consumed = v::detail::sse41_decode(&buf[0], size,
+            &decoded[0], decoded.size(), count);
+        CPPUNIT_ASSERT(count > 0);
+        CPPUNIT_ASSERT(count < values.size());
+        CPPUNIT_ASSERT(size - consumed < v::detail::WINDOW_SLACK);
+
+        std::size_t offset = 0;
+        for (std::size_t i = 0 ; i < count ; ++i) {
+            CPPUNIT_ASSERT_EQUAL(values[i], decoded[i]);
+            offset += v::encoded_size(values[i]);
+        }
+        CPPUNIT_ASSERT_EQUAL(offset, consumed);
+
+        // Encodings longer than max_size are errors, even if the value fits,
+        // on either path; shorter overlong encodings are accepted by both.
+        std::vector<unsigned char> padded(v::detail::WINDOW_SLACK + 6, 0);
+        unsigned char const six[] = { 0x81, 0x80, 0x80, 0x80, 0x80, 0x00 };
+        std::copy(six, six + sizeof(six), padded.begin());
+        uint32_t value32 = 0;
+        CPPUNIT_ASSERT_THROW(v::decode(&padded[0], padded.size(), value32),
+            v::decode_error);
+        CPPUNIT_ASSERT_THROW(v::detail::sse41_decode(&padded[0], padded.size(),
+              &value32, 1, count), v::decode_error);
+        CPPUNIT_ASSERT_THROW(v::decode_n(&padded[0], padded.size(), &value32, 1),
+            v::decode_error);
+
+        uint64_t value64 = 0;
+        CPPUNIT_ASSERT_EQUAL(std::size_t(6),
+            v::detail::sse41_decode(&padded[0], padded.size(), &value64, 1,
+              count));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), value64);
+
+        padded[4] = 0x00;
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5),
+            v::detail::sse41_decode(&padded[0], padded.size(), &value32, 1,
+              count));
+        CPPUNIT_ASSERT_EQUAL(uint32_t(1), value32);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(5),
+            v::decode(&padded[0], padded.size(), value32));
+        CPPUNIT_ASSERT_EQUAL(uint32_t(1), value32);
+#endif
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VarintTest);